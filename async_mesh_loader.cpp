@@ -0,0 +1,38 @@
+#include "async_mesh_loader.h"
+#include "scratch_arena.h"
+
+AsyncMeshLoader::~AsyncMeshLoader() {
+    cancel();
+}
+
+void AsyncMeshLoader::start(const std::vector<const char*>& paths, bool needEdges, bool quantize, bool paged) {
+    cancel();
+    assets_ = std::vector<MeshAsset>(paths.size());
+    loaded_ = 0;
+    finished_ = false;
+    cancelled_ = false;
+    failedMesh_ = -1;
+    thread_ = std::thread(&AsyncMeshLoader::run, this, paths, needEdges, quantize, paged);
+}
+
+void AsyncMeshLoader::cancel() {
+    cancelled_ = true;
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void AsyncMeshLoader::run(std::vector<const char*> paths, bool needEdges, bool quantize, bool paged) {
+    // Shared by the meshes in turn, so only the first ones grow it
+    ScratchArena scratch;
+    for (size_t i = 0; i < paths.size() && !cancelled_; i++) {
+        bool loaded = paged ? loadPagedMeshAsset(paths[i], needEdges, assets_[i], &scratch)
+                            : loadMeshAsset(paths[i], needEdges, quantize, assets_[i], &scratch);
+        scratch.reset();
+        if (!loaded) {
+            failedMesh_ = static_cast<long>(i);
+            break;
+        }
+        loaded_.store(i + 1, std::memory_order_release);
+    }
+    finished_.store(true, std::memory_order_release);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "mesh_asset.h"
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Runs loadMeshAsset for a list of files, in order, on a background thread
+// so the window keeps presenting frames while they are mapped or parsed.
+// The render thread only polls; it never waits on file I/O.
+class AsyncMeshLoader {
+public:
+    AsyncMeshLoader() = default;
+    ~AsyncMeshLoader();
+
+    AsyncMeshLoader(const AsyncMeshLoader&) = delete;
+    AsyncMeshLoader& operator=(const AsyncMeshLoader&) = delete;
+
+    // paged loads each mesh's page file with loadPagedMeshAsset instead,
+    // which keeps float positions whatever quantize says.
+    void start(const std::vector<const char*>& paths, bool needEdges, bool quantize, bool paged = false);
+    // Stops after the mesh being loaded and waits for the thread.
+    void cancel();
+
+    size_t meshCount() const { return assets_.size(); }
+    size_t loadedCount() const { return loaded_.load(std::memory_order_acquire); }
+    bool finished() const { return finished_.load(std::memory_order_acquire); }
+
+    // Valid once finished(): the first mesh that failed to load, or -1.
+    long failedMesh() const { return failedMesh_; }
+    // Only touch once finished(). Assets keep their addresses for the
+    // lifetime of the loader.
+    std::vector<MeshAsset>& assets() { return assets_; }
+
+private:
+    void run(std::vector<const char*> paths, bool needEdges, bool quantize, bool paged);
+
+    std::vector<MeshAsset> assets_;
+    std::thread thread_;
+    std::atomic<size_t> loaded_{ 0 };
+    std::atomic<bool> finished_{ false };
+    std::atomic<bool> cancelled_{ false };
+    long failedMesh_ = -1;
+};
@@ -0,0 +1,208 @@
+#include "batch_pipeline.h"
+#include "image_writer.h"
+#include "scratch_arena.h"
+#include <fstream>
+#include <iostream>
+#include <map>
+
+bool readBatchList(const char* path, std::vector<std::string>& inputs) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open batch list: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        // Trailing carriage returns and whitespace from lists written on Windows
+        size_t end = line.find_last_not_of(" \t\r");
+        size_t begin = line.find_first_not_of(" \t");
+        if (end == std::string::npos || line[begin] == '#')
+            continue;
+        inputs.push_back(line.substr(begin, end + 1 - begin));
+    }
+    if (inputs.empty()) {
+        std::cerr << "Batch list names no meshes: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> batchOutputPaths(const std::vector<std::string>& inputs, const char* outputDir) {
+    std::vector<std::string> outputs;
+    std::map<std::string, size_t> firstInput;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const std::string& input = inputs[i];
+        size_t nameStart = input.find_last_of("/\\");
+        nameStart = nameStart == std::string::npos ? 0 : nameStart + 1;
+        size_t extension = input.find_last_of('.');
+        if (extension == std::string::npos || extension < nameStart)
+            extension = input.size();
+
+        std::string output;
+        if (outputDir) {
+            output = outputDir;
+            if (!output.empty() && output.back() != '/' && output.back() != '\\')
+                output += '/';
+            output += input.substr(nameStart, extension - nameStart);
+        }
+        else {
+            output = input.substr(0, extension);
+        }
+        output += ".png";
+
+        auto inserted = firstInput.insert({ output, i });
+        if (!inserted.second)
+            std::cerr << inputs[inserted.first->second] << " and " << input << " both write " << output
+                      << "; the later one wins" << std::endl;
+        outputs.push_back(output);
+    }
+    return outputs;
+}
+
+BatchLoader::~BatchLoader() {
+    cancel();
+}
+
+void BatchLoader::start(const std::vector<std::string>& inputs, bool needEdges, bool quantize, size_t queueDepth) {
+    cancel();
+    queue_.clear();
+    queueDepth_ = queueDepth > 0 ? queueDepth : 1;
+    finished_ = false;
+    cancelled_ = false;
+    thread_ = std::thread(&BatchLoader::run, this, inputs, needEdges, quantize);
+}
+
+void BatchLoader::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+bool BatchLoader::pop(BatchItem& item, bool wait) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (wait)
+        changed_.wait(lock, [this] { return !queue_.empty() || finished_; });
+    if (queue_.empty())
+        return false;
+    item = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    changed_.notify_all();
+    return true;
+}
+
+void BatchLoader::run(std::vector<std::string> inputs, bool needEdges, bool quantize) {
+    // Shared by the meshes in turn, so a long batch reaches a steady state
+    // without touching the heap for scratch
+    ScratchArena scratch;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] { return queue_.size() < queueDepth_ || cancelled_; });
+            if (cancelled_)
+                break;
+        }
+        BatchItem item;
+        item.input = i;
+        item.asset.reset(new MeshAsset());
+        if (!loadMeshAsset(inputs[i].c_str(), needEdges, quantize, *item.asset, &scratch)) {
+            std::cerr << "Failed to load mesh: " << inputs[i] << std::endl;
+            item.asset.reset();
+        }
+        scratch.reset();
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(item));
+        changed_.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    changed_.notify_all();
+}
+
+BatchWriter::~BatchWriter() {
+    finish();
+}
+
+void BatchWriter::start(const std::vector<std::string>& outputs, int width, int height, size_t bufferCount) {
+    finish();
+    outputs_ = &outputs;
+    width_ = width;
+    height_ = height;
+    free_.assign(bufferCount > 0 ? bufferCount : 1, std::vector<uint32_t>());
+    finishing_ = false;
+    written_ = 0;
+    failed_ = 0;
+    thread_ = std::thread(&BatchWriter::run, this);
+}
+
+void BatchWriter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+std::vector<uint32_t> BatchWriter::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return !free_.empty(); });
+    std::vector<uint32_t> pixels = std::move(free_.back());
+    free_.pop_back();
+    lock.unlock();
+    // Buffers are sized on first use and keep their storage afterwards
+    pixels.resize(static_cast<size_t>(width_) * height_);
+    return pixels;
+}
+
+void BatchWriter::submit(size_t input, std::vector<uint32_t> pixels) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back({ input, std::move(pixels) });
+    }
+    changed_.notify_all();
+}
+
+void BatchWriter::run() {
+    for (;;) {
+        Image image;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] { return !queue_.empty() || finishing_; });
+            if (queue_.empty())
+                break;
+            image = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        const std::string& output = (*outputs_)[image.input];
+        bool ok = writePng(output.c_str(), width_, height_, image.pixels.data(), width_);
+        if (!ok)
+            std::cerr << "Failed to write " << output << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            (ok ? written_ : failed_)++;
+            free_.push_back(std::move(image.pixels));
+        }
+        changed_.notify_all();
+    }
+}
+
+int printBatchReport(const BatchReport& report) {
+    double seconds = report.totalMs / 1000.0;
+    std::cout << "Batch: " << report.rendered << "/" << report.inputs << " meshes rendered in " << seconds << " s ("
+              << (seconds > 0.0 ? report.rendered / seconds : 0.0) << " per second)";
+    if (report.loadFailures || report.writeFailures)
+        std::cout << ", " << report.loadFailures << " failed to load, " << report.writeFailures
+                  << " failed to write";
+    std::cout << std::endl;
+    // Whichever wait dominates is the stage holding the batch back; with
+    // none of them large the render stage itself is the bottleneck.
+    std::cout << "Render stage waited " << report.loadWaitMs << " ms for loads, " << report.readbackWaitMs
+              << " ms for readbacks, " << report.writeWaitMs << " ms for writes" << std::endl;
+    return report.loadFailures || report.writeFailures ? -1 : 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "mesh_asset.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads a batch list: one mesh path per line, ignoring blank lines and
+// lines starting with #. Returns false if the file cannot be read or
+// names no meshes.
+bool readBatchList(const char* path, std::vector<std::string>& inputs);
+
+// PNG path for each input: its file name with a .png extension, in
+// outputDir, or next to the input when outputDir is null. Warns about
+// inputs that would overwrite each other's image.
+std::vector<std::string> batchOutputPaths(const std::vector<std::string>& inputs, const char* outputDir);
+
+// Meshes loaded ahead of the render stage, and image buffers shared by
+// the render and write stages: enough to ride out one slow file without
+// holding many meshes or images in memory.
+const size_t batchLoadAhead = 4;
+const size_t batchImageBuffers = 4;
+
+struct BatchItem {
+    size_t input = 0;
+    // Null when the mesh failed to load.
+    std::unique_ptr<MeshAsset> asset;
+};
+
+// First stage of a batch: loads the inputs in order on a background
+// thread, at most queueDepth ahead of the renderer, so memory stays
+// bounded however long the list is.
+class BatchLoader {
+public:
+    BatchLoader() = default;
+    ~BatchLoader();
+
+    BatchLoader(const BatchLoader&) = delete;
+    BatchLoader& operator=(const BatchLoader&) = delete;
+
+    void start(const std::vector<std::string>& inputs, bool needEdges, bool quantize, size_t queueDepth);
+    // Stops after the mesh being loaded and waits for the thread.
+    void cancel();
+
+    // Takes the next input in order. Without wait, returns false when it
+    // has not finished loading yet; with it, only once every input has
+    // been taken.
+    bool pop(BatchItem& item, bool wait);
+
+private:
+    void run(std::vector<std::string> inputs, bool needEdges, bool quantize);
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<BatchItem> queue_;
+    size_t queueDepth_ = 1;
+    bool finished_ = false;
+    bool cancelled_ = false;
+};
+
+// Last stage of a batch: encodes and writes images on a background
+// thread. Pixel buffers (width x height RGBA8, bottom row first) cycle
+// between the renderer and the writer, so once bufferCount are in use the
+// renderer waits for the disk instead of allocating more.
+class BatchWriter {
+public:
+    BatchWriter() = default;
+    ~BatchWriter();
+
+    BatchWriter(const BatchWriter&) = delete;
+    BatchWriter& operator=(const BatchWriter&) = delete;
+
+    // outputs must stay valid until finish().
+    void start(const std::vector<std::string>& outputs, int width, int height, size_t bufferCount);
+    // Writes everything submitted and waits for the thread.
+    void finish();
+
+    // Waits for a free buffer.
+    std::vector<uint32_t> acquire();
+    // Queues pixels, from acquire(), to be written to outputs[input].
+    void submit(size_t input, std::vector<uint32_t> pixels);
+
+    // Valid after finish().
+    size_t written() const { return written_; }
+    size_t failed() const { return failed_; }
+
+private:
+    void run();
+
+    struct Image {
+        size_t input;
+        std::vector<uint32_t> pixels;
+    };
+
+    const std::vector<std::string>* outputs_ = nullptr;
+    int width_ = 0;
+    int height_ = 0;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Image> queue_;
+    std::vector<std::vector<uint32_t>> free_;
+    bool finishing_ = false;
+    size_t written_ = 0;
+    size_t failed_ = 0;
+};
+
+// Where a batch's render stage spent its time, to tell which stage bounds
+// the throughput.
+struct BatchReport {
+    size_t inputs = 0;
+    size_t rendered = 0;
+    size_t loadFailures = 0;
+    size_t writeFailures = 0;
+    double totalMs = 0.0;
+    // Render stage waiting for the loader, for finished readbacks and for
+    // a free image buffer.
+    double loadWaitMs = 0.0;
+    double readbackWaitMs = 0.0;
+    double writeWaitMs = 0.0;
+};
+
+// Prints the report; returns the process exit code, non-zero when any
+// input failed.
+int printBatchReport(const BatchReport& report);
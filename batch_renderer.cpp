@@ -0,0 +1,177 @@
+#include "batch_renderer.h"
+#include "batch_pipeline.h"
+#include "camera.h"
+#include "offscreen_target.h"
+#include "readback_ring.h"
+#include "scene.h"
+#include "uniform_ring.h"
+#include <glad/glad.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Uploads the mesh into a scene of its own, framed from the (1, 1, 1)
+// diagonal, and queues its passes into the bound framebuffer. The scene
+// is destroyed right away; GL keeps its buffers until the draws are done.
+void renderMesh(const MeshView& view, const AppOptions& options, const ScenePrograms& programs, Camera& camera,
+                UniformRing& uniformRing) {
+    Scene scene;
+    scene.pool.create(view.vertexCount, view.indexCount, view.edgeIndexCount, view.vertexCount < maxShortIndexVertices,
+                      view.quantizedVertices != nullptr);
+    scene.meshes.resize(1);
+    scene.pool.add(view, scene.meshes[0]);
+    addInstanceGrid(scene, 1);
+    uploadSceneInstances(scene, options.indirect);
+    if (options.outlineMode == OutlineMode::SinglePass)
+        scene.pool.uploadEdgeMask(scene.meshes[0], view);
+
+    glm::vec3 boundsMin, boundsMax;
+    sceneBounds(scene, boundsMin, boundsMax);
+    SceneFraming framing = frameBounds(boundsMin, boundsMax);
+    camera.setPerspective(framing.fovY, framing.nearPlane, framing.farPlane);
+    camera.lookAt(framing.eye, framing.target, glm::vec3(0, 1, 0));
+    camera.update();
+
+    // The whole mesh is in view, so only LOD selection is worth a draw list
+    if (options.lodError > 0.0f) {
+        DrawListView drawView;
+        drawView.viewProjection = camera.viewProjection();
+        drawView.frustumCull = false;
+        drawView.eye = camera.eye();
+        drawView.pixelsPerUnit = camera.projection()[1][1] * camera.viewportHeight() * 0.5f;
+        drawView.maxPixelError = options.lodError;
+        DrawListStats stats;
+        buildDrawList(scene, drawView, stats);
+    }
+
+    if (uniformRing.beginFrame()) {
+        FrameUniforms& frameUniforms = uniformRing.frame();
+        frameUniforms.viewProjection = camera.viewProjection();
+        frameUniforms.viewport = glm::vec4(camera.viewportWidth(), camera.viewportHeight(),
+                                           camera.viewportWidth() * 0.5f, camera.viewportHeight() * 0.5f);
+        ObjectUniforms& objectUniforms = uniformRing.object(0);
+        objectUniforms.model = glm::mat4(1.0f);
+        objectUniforms.color = glm::vec4(1.0f);
+    }
+    uniformRing.finishWrites();
+    uniformRing.bindObject(0);
+
+    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (options.outlineMode == OutlineMode::SinglePass) {
+        drawScenePipeline<sceneShaderWireframe>(scene, programs, options.lineWidth);
+    }
+    else {
+        drawScenePipeline<0>(scene, programs, options.lineWidth);
+        if (options.outlineMode == OutlineMode::TwoPass)
+            drawScenePipeline<sceneShaderOutline>(scene, programs, options.lineWidth);
+    }
+    uniformRing.endFrame();
+    destroyScene(scene);
+}
+
+}
+
+int runBatchRenderer(const AppOptions& options, const ScenePrograms& programs) {
+    std::vector<std::string> inputs;
+    if (!readBatchList(options.batchList, inputs))
+        return -1;
+    std::vector<std::string> outputs = batchOutputPaths(inputs, options.batchOutputDir);
+    if (options.residencyBytes > 0)
+        std::cerr << "Batch meshes are uploaded whole; --residency ignored" << std::endl;
+    bool needEdges = options.outlineMode != OutlineMode::Off;
+    int width = options.benchmarkWidth, height = options.benchmarkHeight;
+
+    OffscreenTarget offscreen;
+    if (!offscreen.create(width, height))
+        return -1;
+    UniformRing uniformRing;
+    if (!uniformRing.create(1))
+        return -1;
+    ReadbackRing readback;
+    readback.create(width, height);
+    std::cout << "Batch: " << inputs.size() << " meshes at " << width << "x" << height << ", "
+              << ReadbackRing::slotCount << " readbacks in flight" << std::endl;
+
+    // Meshes load ahead and images are written behind on their own
+    // threads. This one only records frames and collects the readbacks
+    // the GPU has finished, so the GPU always has the next frames queued
+    // while the pixels of earlier ones are copied out. It waits on the GPU
+    // only when every readback buffer is busy or there is nothing loaded
+    // to draw meanwhile.
+    auto batchStart = Clock::now();
+    BatchLoader loader;
+    loader.start(inputs, needEdges, options.quantizePositions, batchLoadAhead);
+    BatchWriter writer;
+    writer.start(outputs, width, height, batchImageBuffers);
+    BatchReport report;
+    report.inputs = inputs.size();
+
+    auto collect = [&]() {
+        auto waitStart = Clock::now();
+        std::vector<uint32_t> pixels = writer.acquire();
+        report.writeWaitMs += millisecondsSince(waitStart);
+        size_t input = readback.oldestTag();
+        waitStart = Clock::now();
+        bool mapped = readback.takeOldest(pixels.data());
+        report.readbackWaitMs += millisecondsSince(waitStart);
+        if (mapped) {
+            writer.submit(input, std::move(pixels));
+            report.rendered++;
+        }
+        else {
+            report.writeFailures++;
+        }
+    };
+
+    Camera camera;
+    camera.setViewport(width, height);
+    glEnable(GL_DEPTH_TEST);
+    offscreen.bind();
+    for (;;) {
+        while (!readback.empty() && readback.oldestReady())
+            collect();
+
+        BatchItem item;
+        if (!loader.pop(item, false)) {
+            if (!readback.empty()) {
+                collect();
+                continue;
+            }
+            auto waitStart = Clock::now();
+            bool more = loader.pop(item, true);
+            report.loadWaitMs += millisecondsSince(waitStart);
+            if (!more)
+                break;
+        }
+        if (!item.asset) {
+            report.loadFailures++;
+            continue;
+        }
+
+        if (readback.full())
+            collect();
+        renderMesh(item.asset->view, options, programs, camera, uniformRing);
+        readback.read(item.input);
+    }
+    while (!readback.empty())
+        collect();
+    writer.finish();
+    report.writeFailures += writer.failed();
+    report.totalMs = millisecondsSince(batchStart);
+
+    readback.destroy();
+    uniformRing.destroy();
+    offscreen.destroy();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return printBatchReport(report);
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "options.h"
+#include "scene_shaders.h"
+
+// Renders every mesh of options.batchList with OpenGL, framed alone from
+// a fixed direction, to its own PNG. Needs a current context; draws into
+// an offscreen target and never presents. Returns the process exit code.
+int runBatchRenderer(const AppOptions& options, const ScenePrograms& programs);
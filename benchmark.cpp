@@ -0,0 +1,94 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+const float twoPi = 6.28318530718f;
+
+// Nearest-rank percentile of sorted values.
+double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+void printDistribution(const char* name, std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    double total = 0.0;
+    for (double value : values)
+        total += value;
+    double mean = values.empty() ? 0.0 : total / values.size();
+    std::cout << name << ": mean " << mean << " p50 " << percentile(values, 0.5) << " p90 "
+              << percentile(values, 0.9) << " p95 " << percentile(values, 0.95) << " p99 "
+              << percentile(values, 0.99) << " max " << (values.empty() ? 0.0 : values.back()) << std::endl;
+}
+
+}
+
+CameraPose cameraPathPose(CameraPath path, size_t frame, size_t frameCount, const glm::vec3& eye,
+                          const glm::vec3& target) {
+    float t = frameCount > 0 ? static_cast<float>(frame) / frameCount : 0.0f;
+    CameraPose pose;
+    pose.eye = eye;
+    switch (path) {
+    case CameraPath::Spin:
+        pose.angleY = twoPi * t;
+        break;
+    case CameraPath::Tumble:
+        pose.angleY = twoPi * t;
+        pose.angleZ = 2.0f * twoPi * t;
+        break;
+    case CameraPath::Orbit: {
+        glm::vec3 offset = eye - target;
+        float angle = twoPi * t;
+        float distance = 0.8f + 0.2f * std::cos(angle);
+        glm::vec3 rotated(offset.x * std::cos(angle) - offset.z * std::sin(angle), offset.y,
+                          offset.x * std::sin(angle) + offset.z * std::cos(angle));
+        pose.eye = target + rotated * distance;
+        break;
+    }
+    }
+    return pose;
+}
+
+void printBenchmarkReport(const BenchmarkResults& results, const std::vector<FrameTimings>& profile,
+                          uint64_t firstFrame) {
+    std::vector<double> gpuMs;
+    size_t dropped = 0;
+    for (const FrameTimings& timings : profile) {
+        if (timings.frame < firstFrame)
+            continue;
+        double total = 0.0;
+        bool measured = false;
+        for (double ms : timings.gpuMs) {
+            if (ms >= 0.0) {
+                total += ms;
+                measured = true;
+            }
+        }
+        if (measured)
+            gpuMs.push_back(total);
+        else
+            dropped++;
+    }
+
+    double seconds = 0.0;
+    for (double ms : results.frameMs)
+        seconds += ms / 1000.0;
+    size_t frames = results.frameMs.size();
+
+    std::cout << "benchmark: " << frames << " frames at " << results.width << "x" << results.height << ", "
+              << cameraPathName(results.path) << " path" << std::endl;
+    std::cout << "load ms: " << results.loadMs << std::endl;
+    printDistribution("frame ms", results.frameMs);
+    if (!profile.empty())
+        printDistribution("gpu ms", gpuMs);
+    if (dropped > 0)
+        std::cout << "gpu frames without timings: " << dropped << std::endl;
+    std::cout << "fps: " << (seconds > 0.0 ? frames / seconds : 0.0) << std::endl;
+    std::cout << "triangles per second: " << (seconds > 0.0 ? results.triangles / seconds : 0.0)
+              << (results.trianglesCulled ? "" : " (before GPU culling)") << std::endl;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "frame_profiler.h"
+#include "options.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct CameraPose {
+    float angleY = 0.0f;
+    float angleZ = 0.0f;
+    glm::vec3 eye = glm::vec3(0.0f);
+};
+
+// Pose for frame of frameCount along path, from the interactive starting
+// view. Depends only on the frame number, so every run renders the same
+// frames regardless of how fast they draw.
+CameraPose cameraPathPose(CameraPath path, size_t frame, size_t frameCount, const glm::vec3& eye,
+                          const glm::vec3& target);
+
+struct BenchmarkResults {
+    int width = 0;
+    int height = 0;
+    CameraPath path = CameraPath::Tumble;
+    double loadMs = 0.0;
+    // Wall time of each measured frame, start to start.
+    std::vector<double> frameMs;
+    // Triangles submitted over the measured frames.
+    double triangles = 0.0;
+    // False when triangles is the scene total because culling ran on
+    // the GPU and the visible count never reaches the CPU.
+    bool trianglesCulled = true;
+};
+
+// Prints percentiles of frameMs and of the GPU time the profiler recorded
+// for frames from firstFrame on, frame rate, triangle rate and load time,
+// one "name: values" line each so scripts can pick them out. The GPU line
+// is left out when profile is empty.
+void printBenchmarkReport(const BenchmarkResults& results, const std::vector<FrameTimings>& profile,
+                          uint64_t firstFrame);
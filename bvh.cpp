@@ -0,0 +1,205 @@
+#include "bvh.h"
+#include <algorithm>
+#include <limits>
+
+Frustum frustumFromMatrix(const glm::mat4& m) {
+    // Rows of the matrix; glm stores columns.
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];  // Left
+    frustum.planes[1] = rows[3] - rows[0];  // Right
+    frustum.planes[2] = rows[3] + rows[1];  // Bottom
+    frustum.planes[3] = rows[3] - rows[1];  // Top
+    frustum.planes[4] = rows[3] + rows[2];  // Near
+    frustum.planes[5] = rows[3] - rows[2];  // Far
+    return frustum;
+}
+
+// Tests a box against the planes still set in planeMask. Clears the bits
+// of planes the box is entirely inside; returns false if it is entirely
+// outside any of them.
+static bool boxInFrustum(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                         unsigned int& planeMask) {
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+    for (int plane = 0; plane < 6; plane++) {
+        if (!(planeMask & (1u << plane)))
+            continue;
+        glm::vec3 normal(frustum.planes[plane]);
+        float distance = glm::dot(normal, center) + frustum.planes[plane].w;
+        float radius = glm::dot(glm::abs(normal), halfExtent);
+        if (distance < -radius)
+            return false;
+        if (distance >= radius)
+            planeMask &= ~(1u << plane);
+    }
+    return true;
+}
+
+bool boxIntersectsFrustum(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    unsigned int planeMask = 0x3f;
+    return boxInFrustum(frustum, boundsMin, boundsMax, planeMask);
+}
+
+void Bvh::build(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax) {
+    nodes_.clear();
+    itemMin_ = boundsMin;
+    itemMax_ = boundsMax;
+    items_.resize(boundsMin.size());
+    if (items_.empty())
+        return;
+
+    std::vector<glm::vec3> centroids(boundsMin.size());
+    for (size_t i = 0; i < boundsMin.size(); i++) {
+        items_[i] = static_cast<unsigned int>(i);
+        centroids[i] = (boundsMin[i] + boundsMax[i]) * 0.5f;
+    }
+    nodes_.reserve(2 * items_.size() / leafSize + 1);
+    nodes_.emplace_back();
+    buildNode(0, centroids, boundsMin, boundsMax, 0, static_cast<unsigned int>(items_.size()));
+
+    parents_.assign(nodes_.size(), 0);
+    itemLeaves_.resize(items_.size());
+    for (unsigned int index = 0; index < nodes_.size(); index++) {
+        const Node& node = nodes_[index];
+        if (node.count == 0) {
+            parents_[node.first] = index;
+            parents_[node.first + 1] = index;
+            continue;
+        }
+        for (unsigned int i = node.first; i < node.first + node.count; i++)
+            itemLeaves_[items_[i]] = index;
+    }
+}
+
+void Bvh::buildNode(unsigned int index, const std::vector<glm::vec3>& centroids, const std::vector<glm::vec3>& boundsMin,
+                    const std::vector<glm::vec3>& boundsMax, unsigned int first, unsigned int count) {
+    glm::vec3 nodeMin(std::numeric_limits<float>::max());
+    glm::vec3 nodeMax(-std::numeric_limits<float>::max());
+    glm::vec3 centroidMin = nodeMin;
+    glm::vec3 centroidMax = nodeMax;
+    for (unsigned int i = first; i < first + count; i++) {
+        unsigned int item = items_[i];
+        nodeMin = glm::min(nodeMin, boundsMin[item]);
+        nodeMax = glm::max(nodeMax, boundsMax[item]);
+        centroidMin = glm::min(centroidMin, centroids[item]);
+        centroidMax = glm::max(centroidMax, centroids[item]);
+    }
+    nodes_[index].boundsMin = nodeMin;
+    nodes_[index].boundsMax = nodeMax;
+
+    if (count <= leafSize) {
+        nodes_[index].first = first;
+        nodes_[index].count = count;
+        return;
+    }
+
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    unsigned int half = count / 2;
+    std::nth_element(items_.begin() + first, items_.begin() + first + half, items_.begin() + first + count,
+                     [&](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    // Siblings are allocated together so the right child is always left + 1.
+    unsigned int left = static_cast<unsigned int>(nodes_.size());
+    nodes_[index].first = left;
+    nodes_[index].count = 0;
+    nodes_.emplace_back();
+    nodes_.emplace_back();
+    buildNode(left, centroids, boundsMin, boundsMax, first, half);
+    buildNode(left + 1, centroids, boundsMin, boundsMax, first + half, count - half);
+}
+
+void Bvh::refit(const std::vector<unsigned int>& items, const std::vector<glm::vec3>& boundsMin,
+                const std::vector<glm::vec3>& boundsMax) {
+    if (items.empty() || nodes_.empty())
+        return;
+    std::vector<unsigned int> leaves;
+    leaves.reserve(items.size());
+    for (unsigned int item : items) {
+        itemMin_[item] = boundsMin[item];
+        itemMax_[item] = boundsMax[item];
+        leaves.push_back(itemLeaves_[item]);
+    }
+    std::sort(leaves.begin(), leaves.end());
+    leaves.erase(std::unique(leaves.begin(), leaves.end()), leaves.end());
+
+    // Each leaf is refitted from its items, then its ancestors from their
+    // children until one comes out unchanged; every node on a path above
+    // that was already current, or is reached from another changed leaf
+    for (unsigned int index : leaves) {
+        Node& leaf = nodes_[index];
+        glm::vec3 nodeMin(std::numeric_limits<float>::max());
+        glm::vec3 nodeMax(-std::numeric_limits<float>::max());
+        for (unsigned int i = leaf.first; i < leaf.first + leaf.count; i++) {
+            nodeMin = glm::min(nodeMin, itemMin_[items_[i]]);
+            nodeMax = glm::max(nodeMax, itemMax_[items_[i]]);
+        }
+        if (nodeMin == leaf.boundsMin && nodeMax == leaf.boundsMax)
+            continue;
+        leaf.boundsMin = nodeMin;
+        leaf.boundsMax = nodeMax;
+
+        while (index != 0) {
+            index = parents_[index];
+            Node& node = nodes_[index];
+            const Node& left = nodes_[node.first];
+            const Node& right = nodes_[node.first + 1];
+            nodeMin = glm::min(left.boundsMin, right.boundsMin);
+            nodeMax = glm::max(left.boundsMax, right.boundsMax);
+            if (nodeMin == node.boundsMin && nodeMax == node.boundsMax)
+                break;
+            node.boundsMin = nodeMin;
+            node.boundsMax = nodeMax;
+        }
+    }
+}
+
+void Bvh::cull(const Frustum& frustum, std::vector<unsigned int>& visible, CullStats& stats) const {
+    if (nodes_.empty())
+        return;
+
+    // Each entry carries the planes its subtree still has to be tested
+    // against; a box fully inside a plane clears that plane's bit, so
+    // subtrees entirely inside the frustum are walked without tests. The
+    // median split keeps the tree balanced, well within the fixed stack.
+    struct Entry {
+        unsigned int node;
+        unsigned int planeMask;
+    };
+    Entry stack[64];
+    int depth = 0;
+    stack[depth++] = { 0, 0x3f };
+    size_t before = visible.size();
+
+    while (depth > 0) {
+        Entry entry = stack[--depth];
+        const Node& node = nodes_[entry.node];
+        unsigned int planeMask = entry.planeMask;
+        if (planeMask) {
+            stats.nodesTested++;
+            if (!boxInFrustum(frustum, node.boundsMin, node.boundsMax, planeMask))
+                continue;
+        }
+
+        if (node.count == 0) {
+            stack[depth++] = { node.first, planeMask };
+            stack[depth++] = { node.first + 1, planeMask };
+            continue;
+        }
+        for (unsigned int i = node.first; i < node.first + node.count; i++) {
+            unsigned int item = items_[i];
+            unsigned int itemMask = planeMask;
+            if (itemMask && !boxInFrustum(frustum, itemMin_[item], itemMax_[item], itemMask))
+                continue;
+            visible.push_back(item);
+        }
+    }
+
+    size_t added = visible.size() - before;
+    stats.visible += added;
+    stats.culled += items_.size() - added;
+}
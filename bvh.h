@@ -0,0 +1,67 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// The six clip planes of a view-projection matrix, normals pointing
+// inwards (ax + by + cz + d >= 0 is inside).
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+Frustum frustumFromMatrix(const glm::mat4& viewProjection);
+
+// True unless the box lies entirely outside one of the planes.
+bool boxIntersectsFrustum(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+struct CullStats {
+    size_t visible = 0;
+    size_t culled = 0;
+    // BVH nodes whose box was tested against the frustum.
+    size_t nodesTested = 0;
+};
+
+// Bounding volume hierarchy over axis-aligned boxes, built top-down by
+// splitting at the median centroid of the longest axis. Nodes are stored
+// in one array with siblings adjacent.
+class Bvh {
+public:
+    void build(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+    // Takes the new bounds of the listed items and grows or shrinks the
+    // nodes to fit, keeping the tree's shape. Only the leaves holding the
+    // items and the ancestors whose bounds change are visited, so the cost
+    // follows the moved items rather than the scene; culling stays exact,
+    // but items that moved far make their nodes loose.
+    void refit(const std::vector<unsigned int>& items, const std::vector<glm::vec3>& boundsMin,
+               const std::vector<glm::vec3>& boundsMax);
+
+    size_t itemCount() const { return items_.size(); }
+    size_t nodeCount() const { return nodes_.size(); }
+
+    // Appends the indices of boxes that intersect the frustum to visible.
+    // Subtrees entirely inside a plane skip that plane from then on.
+    void cull(const Frustum& frustum, std::vector<unsigned int>& visible, CullStats& stats) const;
+
+private:
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // Leaves: range in items_. Interior nodes: count is 0 and first is
+        // the left child, with the right child at first + 1.
+        unsigned int first;
+        unsigned int count;
+    };
+    static const unsigned int leafSize = 4;
+
+    void buildNode(unsigned int index, const std::vector<glm::vec3>& centroids, const std::vector<glm::vec3>& boundsMin,
+                   const std::vector<glm::vec3>& boundsMax, unsigned int first, unsigned int count);
+
+    std::vector<Node> nodes_;
+    std::vector<unsigned int> items_;
+    std::vector<glm::vec3> itemMin_;
+    std::vector<glm::vec3> itemMax_;
+    // For refit: the parent of each node (the root's is itself) and the
+    // leaf holding each item.
+    std::vector<unsigned int> parents_;
+    std::vector<unsigned int> itemLeaves_;
+};
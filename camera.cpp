@@ -0,0 +1,42 @@
+#include "camera.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+void Camera::setViewport(int width, int height) {
+    // A minimized window reports 0x0; keep the last usable aspect ratio.
+    if (width <= 0 || height <= 0 || (width == width_ && height == height_))
+        return;
+    width_ = width;
+    height_ = height;
+    projectionDirty_ = true;
+}
+
+void Camera::setPerspective(float fovY, float nearPlane, float farPlane) {
+    fovY_ = fovY;
+    nearPlane_ = nearPlane;
+    farPlane_ = farPlane;
+    projectionDirty_ = true;
+}
+
+void Camera::lookAt(const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up) {
+    if (eye == eye_ && target == target_ && up == up_)
+        return;
+    eye_ = eye;
+    target_ = target;
+    up_ = up;
+    viewDirty_ = true;
+}
+
+bool Camera::update() {
+    if (!projectionDirty_ && !viewDirty_)
+        return false;
+
+    if (projectionDirty_)
+        projection_ = glm::perspective(fovY_, static_cast<float>(width_) / height_, nearPlane_, farPlane_);
+    if (viewDirty_)
+        view_ = glm::lookAt(eye_, target_, up_);
+
+    viewProjection_ = projection_ * view_;
+    projectionDirty_ = false;
+    viewDirty_ = false;
+    return true;
+}
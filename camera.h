@@ -0,0 +1,38 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// View and projection state. Setters only mark the matrices stale; they are
+// rebuilt by update(), so an unchanged camera costs nothing per frame.
+class Camera {
+public:
+    void setViewport(int width, int height);
+    void setPerspective(float fovY, float nearPlane, float farPlane);
+    void lookAt(const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up);
+
+    // Rebuilds stale matrices. Returns true if anything changed since the
+    // last call.
+    bool update();
+
+    int viewportWidth() const { return width_; }
+    int viewportHeight() const { return height_; }
+    const glm::vec3& eye() const { return eye_; }
+    const glm::mat4& view() const { return view_; }
+    const glm::mat4& projection() const { return projection_; }
+    const glm::mat4& viewProjection() const { return viewProjection_; }
+
+private:
+    int width_ = 1;
+    int height_ = 1;
+    float fovY_ = glm::radians(45.0f);
+    float nearPlane_ = 0.1f;
+    float farPlane_ = 100.0f;
+    glm::vec3 eye_ = glm::vec3(0.0f, 0.0f, 1.0f);
+    glm::vec3 target_ = glm::vec3(0.0f);
+    glm::vec3 up_ = glm::vec3(0.0f, 1.0f, 0.0f);
+
+    bool projectionDirty_ = true;
+    bool viewDirty_ = true;
+    glm::mat4 view_ = glm::mat4(1.0f);
+    glm::mat4 projection_ = glm::mat4(1.0f);
+    glm::mat4 viewProjection_ = glm::mat4(1.0f);
+};
@@ -0,0 +1,76 @@
+#include "edge_builder.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <iterator>
+
+void sortUniqueEdges(ScratchVector<uint64_t>& keys) {
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+static ScratchVector<uint64_t> mergeUnique(const ScratchVector<uint64_t>& a, const ScratchVector<uint64_t>& b) {
+    ScratchVector<uint64_t> merged(a.get_allocator());
+    merged.reserve(a.size() + b.size());
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(merged));
+    return merged;
+}
+
+ScratchVector<uint64_t> mergeEdgeRuns(std::vector<ScratchVector<uint64_t>>& runs, ThreadPool& pool) {
+    if (runs.empty())
+        return {};
+
+    while (runs.size() > 1) {
+        size_t pairs = runs.size() / 2;
+        std::vector<ScratchVector<uint64_t>> next((runs.size() + 1) / 2,
+                                                  ScratchVector<uint64_t>(runs[0].get_allocator()));
+        pool.parallelFor(pairs, [&](size_t i) {
+            next[i] = mergeUnique(runs[2 * i], runs[2 * i + 1]);
+            runs[2 * i].clear();
+            runs[2 * i].shrink_to_fit();
+            runs[2 * i + 1].clear();
+            runs[2 * i + 1].shrink_to_fit();
+        });
+        if (runs.size() % 2)
+            next.back() = std::move(runs.back());
+        runs = std::move(next);
+    }
+    return std::move(runs.front());
+}
+
+std::vector<unsigned int> edgeIndicesFromKeys(const ScratchVector<uint64_t>& keys) {
+    std::vector<unsigned int> indices(keys.size() * 2);
+    for (size_t i = 0; i < keys.size(); i++) {
+        indices[2 * i] = static_cast<unsigned int>(keys[i] >> 32);
+        indices[2 * i + 1] = static_cast<unsigned int>(keys[i]);
+    }
+    return indices;
+}
+
+std::vector<unsigned int> buildTriangleEdges(const std::vector<unsigned int>& indices, ScratchArena* scratch) {
+    ScratchVector<uint64_t> keys(scratch);
+    keys.reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        appendFaceEdges(&indices[i], 3, keys);
+    sortUniqueEdges(keys);
+    return edgeIndicesFromKeys(keys);
+}
+
+std::vector<unsigned char> buildTriangleEdgeMask(const unsigned int* indices, size_t indexCount,
+                                                 const unsigned int* edgeIndices, size_t edgeIndexCount) {
+    ScratchVector<uint64_t> keys;
+    keys.reserve(edgeIndexCount / 2);
+    for (size_t i = 0; i + 1 < edgeIndexCount; i += 2)
+        keys.push_back(packEdge(edgeIndices[i], edgeIndices[i + 1]));
+    sortUniqueEdges(keys);
+
+    std::vector<unsigned char> masks(indexCount / 3, 0);
+    for (size_t t = 0; t < masks.size(); t++) {
+        const unsigned int* corner = indices + t * 3;
+        for (int k = 0; k < 3; k++) {
+            uint64_t key = packEdge(corner[(k + 1) % 3], corner[(k + 2) % 3]);
+            if (std::binary_search(keys.begin(), keys.end(), key))
+                masks[t] |= static_cast<unsigned char>(1u << k);
+        }
+    }
+    return masks;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "scratch_arena.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+// Undirected edge packed into one sortable key, smaller index in the high half.
+inline uint64_t packEdge(unsigned int a, unsigned int b) {
+    if (a > b) std::swap(a, b);
+    return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+// Appends the boundary edges of one polygon (closing edge included).
+inline void appendFaceEdges(const unsigned int* face, unsigned int size, ScratchVector<uint64_t>& keys) {
+    for (unsigned int i = 0; i < size; i++)
+        keys.push_back(packEdge(face[i], face[(i + 1) % size]));
+}
+
+// Sorts and deduplicates keys in place.
+void sortUniqueEdges(ScratchVector<uint64_t>& keys);
+
+// Merges several individually sorted and deduplicated key runs into one
+// sorted, duplicate-free list, merging pairs of runs in parallel. The
+// merged runs are allocated like the first.
+ScratchVector<uint64_t> mergeEdgeRuns(std::vector<ScratchVector<uint64_t>>& runs, ThreadPool& pool);
+
+// Expands sorted keys into GL_LINES index pairs.
+std::vector<unsigned int> edgeIndicesFromKeys(const ScratchVector<uint64_t>& keys);
+
+// Unique edges of a triangle list, for meshes whose polygon outlines are
+// no longer available (e.g. simplified or cached geometry). Safe to run on
+// a worker thread. Keys are sorted in scratch when given.
+std::vector<unsigned int> buildTriangleEdges(const std::vector<unsigned int>& indices, ScratchArena* scratch = nullptr);
+
+// Bit k of a triangle's mask is set when the edge opposite its k-th corner
+// is one of the outline edges, so a single-pass wireframe can skip the
+// interior diagonals that triangulation added.
+std::vector<unsigned char> buildTriangleEdgeMask(const unsigned int* indices, size_t indexCount,
+                                                 const unsigned int* edgeIndices, size_t edgeIndexCount);
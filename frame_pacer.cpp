@@ -0,0 +1,55 @@
+#include "frame_pacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void FramePacer::create(PacingMode mode, double frameRate) {
+    mode_ = mode;
+    period_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameRate));
+    started_ = false;
+}
+
+void FramePacer::wait() {
+    if (mode_ != PacingMode::Capped || !started_)
+        return;
+    sleepUntil(nextFrame_);
+}
+
+double FramePacer::beginFrame() {
+    Clock::time_point now = Clock::now();
+    double delta = started_ ? std::chrono::duration<double>(now - lastFrame_).count() : 0.0;
+    // Frames are due a period apart from the schedule, not from when the
+    // last one happened to start. One more than a period late starts the
+    // schedule again instead of being followed by a burst of catch-up
+    // frames.
+    if (!started_ || mode_ != PacingMode::Capped || now - nextFrame_ > period_)
+        nextFrame_ = now;
+    nextFrame_ += period_;
+    lastFrame_ = now;
+    started_ = true;
+    return std::min(delta, maxFrameDelta);
+}
+
+void FramePacer::resume() {
+    lastFrame_ = Clock::now();
+    nextFrame_ = lastFrame_;
+}
+
+void FramePacer::sleepUntil(Clock::time_point deadline) {
+    const auto step = std::chrono::milliseconds(1);
+    for (;;) {
+        Clock::time_point start = Clock::now();
+        double remaining = std::chrono::duration<double>(deadline - start).count();
+        if (remaining <= stepEstimate_)
+            break;
+        std::this_thread::sleep_for(step);
+        double slept = std::chrono::duration<double>(Clock::now() - start).count();
+        stepCount_++;
+        double difference = slept - stepMean_;
+        stepMean_ += difference / static_cast<double>(stepCount_);
+        stepM2_ += difference * (slept - stepMean_);
+        stepEstimate_ = stepMean_ + std::sqrt(stepM2_ / static_cast<double>(stepCount_ - 1));
+    }
+    while (Clock::now() < deadline)
+        std::this_thread::yield();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "options.h"
+#include <chrono>
+
+// Decides when the main loop starts a frame and how much time it stands
+// for. Vsync and uncapped frames start as soon as the last one is
+// submitted. Capped frames start on a fixed schedule. The wait for the
+// schedule comes before input is read, so the frame is built from the
+// freshest input instead of sitting ready while the loop sleeps.
+class FramePacer {
+public:
+    // Longest step the animation takes in one frame, so a stall, or the
+    // first frame after idling on demand, does not jump the model.
+    static constexpr double maxFrameDelta = 0.1;
+
+    void create(PacingMode mode, double frameRate);
+
+    // Sleeps until the next capped frame is due; returns at once in the
+    // other modes.
+    void wait();
+    // Starts a frame. Returns the seconds since the previous one started,
+    // at most maxFrameDelta.
+    double beginFrame();
+    // Forgets the time spent idle, so the next frame moves nothing for it
+    // and the capped schedule restarts from now.
+    void resume();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Sleeps in short steps while the remaining time is above the longest
+    // a step is expected to take, then spins for the rest. The estimate
+    // follows the measured step lengths, so the wake-up is precise
+    // whatever the timer resolution of the OS.
+    void sleepUntil(Clock::time_point deadline);
+
+    PacingMode mode_ = PacingMode::Vsync;
+    Clock::duration period_ = Clock::duration::zero();
+    Clock::time_point nextFrame_;
+    Clock::time_point lastFrame_;
+    bool started_ = false;
+    // Running mean and variance (Welford) of the sleep step in seconds.
+    double stepEstimate_ = 0.005;
+    double stepMean_ = 0.005;
+    double stepM2_ = 0.0;
+    long long stepCount_ = 1;
+};
@@ -0,0 +1,382 @@
+#include "frame_profiler.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char* overlayVertexShader = R"glsl(
+#version 330 core
+layout (location = 0) in vec2 aPixel;
+layout (location = 1) in vec4 aColor;
+layout (std140) uniform Frame { mat4 viewProjection; vec4 viewport; } frame;
+out vec4 color;
+void main() {
+    gl_Position = vec4(aPixel.x / frame.viewport.z - 1.0, 1.0 - aPixel.y / frame.viewport.w, 0.0, 1.0);
+    color = aColor;
+}
+)glsl";
+
+static const char* overlayFragmentShader = R"glsl(
+#version 330 core
+in vec4 color;
+out vec4 FragColor;
+void main() {
+    FragColor = color;
+}
+)glsl";
+
+namespace {
+
+// Graph layout in pixels from the top-left corner; bars are scaled so a
+// 30 Hz frame fills the graph and a line marks 60 Hz.
+const float overlayMargin = 10.0f;
+const float overlayBarWidth = 2.0f;
+const float overlayGraphHeight = 100.0f;
+const float overlayFullScaleMs = 1000.0f / 30.0f;
+const float overlayTargetMs = 1000.0f / 60.0f;
+
+const float cpuPhaseColors[cpuPhaseCount][3] = {
+    { 0.9f, 0.8f, 0.2f },
+    { 0.3f, 0.7f, 0.9f },
+    { 0.4f, 0.9f, 0.4f },
+    { 0.5f, 0.5f, 0.5f },
+};
+const float gpuPassColors[gpuPassCount][3] = {
+    { 0.8f, 0.4f, 0.9f },
+    { 0.9f, 0.5f, 0.2f },
+    { 0.9f, 0.2f, 0.3f },
+};
+
+void addQuad(std::vector<float>& vertices, float x0, float y0, float x1, float y1, const float* rgb, float alpha) {
+    const float corners[6][2] = { { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y0 }, { x1, y1 }, { x0, y1 } };
+    for (const auto& corner : corners) {
+        vertices.insert(vertices.end(), { corner[0], corner[1], rgb[0], rgb[1], rgb[2], alpha });
+    }
+}
+
+// One column per frame: segments stacked upwards from the graph's baseline.
+void addBar(std::vector<float>& vertices, float x, float baseline, const double* ms, size_t count,
+            const float (*colors)[3]) {
+    float top = baseline;
+    for (size_t i = 0; i < count; i++) {
+        if (ms[i] <= 0.0)
+            continue;
+        float height = static_cast<float>(ms[i]) * overlayGraphHeight / overlayFullScaleMs;
+        float next = std::max(top - height, baseline - overlayGraphHeight);
+        if (next < top)
+            addQuad(vertices, x, next, x + overlayBarWidth, top, colors[i], 1.0f);
+        top = next;
+    }
+}
+
+const char* csvField(double ms, char* buffer, size_t size) {
+    if (ms < 0.0)
+        return "";
+    std::snprintf(buffer, size, "%.4f", ms);
+    return buffer;
+}
+
+}
+
+const char* cpuPhaseName(CpuPhase phase) {
+    switch (phase) {
+    case CpuPhase::Input: return "input";
+    case CpuPhase::Update: return "update";
+    case CpuPhase::Submit: return "submit";
+    case CpuPhase::Swap: return "swap";
+    case CpuPhase::Count: break;
+    }
+    return "unknown";
+}
+
+const char* gpuPassName(GpuPass pass) {
+    switch (pass) {
+    case GpuPass::Cull: return "cull";
+    case GpuPass::Fill: return "fill";
+    case GpuPass::Outline: return "outline";
+    case GpuPass::Count: break;
+    }
+    return "unknown";
+}
+
+bool FrameProfiler::create(bool record) {
+    destroy();
+    record_ = record;
+    for (Slot& slot : slots_)
+        glGenQueries(static_cast<int>(gpuPassCount), slot.queries);
+
+    overlayShader_ = linkShaderProgram(overlayVertexShader, overlayFragmentShader);
+    glGenVertexArrays(1, &overlayVao_);
+    glGenBuffers(1, &overlayBuffer_);
+    glBindVertexArray(overlayVao_);
+    glBindBuffer(GL_ARRAY_BUFFER, overlayBuffer_);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    return overlayShader_.id != 0;
+}
+
+void FrameProfiler::destroy() {
+    for (Slot& slot : slots_) {
+        if (slot.queries[0])
+            glDeleteQueries(static_cast<int>(gpuPassCount), slot.queries);
+        slot = Slot();
+    }
+    if (overlayShader_.id)
+        destroyShaderProgram(overlayShader_);
+    if (overlayVao_)
+        glDeleteVertexArrays(1, &overlayVao_);
+    if (overlayBuffer_)
+        glDeleteBuffers(1, &overlayBuffer_);
+    overlayVao_ = 0;
+    overlayBuffer_ = 0;
+    frame_ = 0;
+    activePass_ = -1;
+    phase_ = -1;
+    dropped_ = 0;
+    sum_ = FrameTimings();
+    sumFrames_ = 0;
+    recent_.clear();
+    recentHead_ = 0;
+    history_.clear();
+}
+
+void FrameProfiler::beginFrame() {
+    // Resolve older frames in submission order, stopping at the first
+    // whose results are not in yet.
+    for (int age = latency - 1; age >= 0; age--) {
+        if (frame_ < static_cast<uint64_t>(age))
+            continue;
+        Slot& slot = slots_[(frame_ - age) % latency];
+        if (slot.pending && !resolve(slot, false))
+            break;
+    }
+
+    if (metrics_) {
+        Clock::time_point now = Clock::now();
+        if (frame_ > 0)
+            metrics_->recordFrameTime(std::chrono::duration<double, std::milli>(now - frameStart_).count());
+        frameStart_ = now;
+    }
+
+    frame_++;
+    Slot& slot = slots_[frame_ % latency];
+    // The slot's frame is latency frames old; rather than wait for it,
+    // its GPU times are dropped.
+    if (slot.pending)
+        resolve(slot, true);
+    slot.timings = FrameTimings();
+    slot.timings.frame = frame_;
+    std::fill(std::begin(slot.issued), std::end(slot.issued), false);
+    beginPhase(CpuPhase::Input);
+}
+
+void FrameProfiler::beginPhase(CpuPhase phase) {
+    Clock::time_point now = Clock::now();
+    Slot& slot = slots_[frame_ % latency];
+    if (phase_ >= 0)
+        slot.timings.cpuMs[phase_] += std::chrono::duration<double, std::milli>(now - phaseStart_).count();
+    phase_ = static_cast<int>(phase);
+    phaseStart_ = now;
+}
+
+void FrameProfiler::endFrame() {
+    Clock::time_point now = Clock::now();
+    Slot& slot = slots_[frame_ % latency];
+    if (phase_ >= 0)
+        slot.timings.cpuMs[phase_] += std::chrono::duration<double, std::milli>(now - phaseStart_).count();
+    phase_ = -1;
+    slot.pending = true;
+}
+
+void FrameProfiler::finish() {
+    glFinish();
+    for (int age = latency - 1; age >= 0; age--) {
+        if (frame_ < static_cast<uint64_t>(age))
+            continue;
+        Slot& slot = slots_[(frame_ - age) % latency];
+        if (slot.pending)
+            resolve(slot, true);
+    }
+}
+
+void FrameProfiler::beginPass(GpuPass pass) {
+    Slot& slot = slots_[frame_ % latency];
+    activePass_ = static_cast<int>(pass);
+    glBeginQuery(GL_TIME_ELAPSED, slot.queries[activePass_]);
+    slot.issued[activePass_] = true;
+}
+
+void FrameProfiler::endPass() {
+    if (activePass_ < 0)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    activePass_ = -1;
+}
+
+bool FrameProfiler::resolve(Slot& slot, bool force) {
+    for (size_t pass = 0; pass < gpuPassCount; pass++) {
+        if (!slot.issued[pass])
+            continue;
+        int available = 0;
+        glGetQueryObjectiv(slot.queries[pass], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !force)
+            return false;
+        if (!available) {
+            std::fill(std::begin(slot.timings.gpuMs), std::end(slot.timings.gpuMs), -1.0);
+            dropped_++;
+            break;
+        }
+    }
+    for (size_t pass = 0; pass < gpuPassCount; pass++) {
+        if (!slot.issued[pass]) {
+            slot.timings.gpuMs[pass] = -1.0;
+        }
+        else if (slot.timings.gpuMs[pass] >= 0.0) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(slot.queries[pass], GL_QUERY_RESULT, &elapsed);
+            slot.timings.gpuMs[pass] = elapsed / 1.0e6;
+        }
+    }
+    slot.pending = false;
+    complete(slot.timings);
+    return true;
+}
+
+void FrameProfiler::complete(const FrameTimings& timings) {
+    for (size_t phase = 0; phase < cpuPhaseCount; phase++)
+        sum_.cpuMs[phase] += timings.cpuMs[phase];
+    for (size_t pass = 0; pass < gpuPassCount; pass++)
+        sum_.gpuMs[pass] += std::max(timings.gpuMs[pass], 0.0);
+    sumFrames_++;
+    if (metrics_) {
+        double cpuMs = 0.0, gpuMs = 0.0;
+        for (size_t phase = 0; phase < cpuPhaseCount; phase++)
+            cpuMs += timings.cpuMs[phase];
+        for (size_t pass = 0; pass < gpuPassCount; pass++)
+            gpuMs += std::max(timings.gpuMs[pass], 0.0);
+        metrics_->recordTimings(cpuMs, gpuMs);
+    }
+
+    if (recent_.size() < overlayFrames) {
+        recent_.push_back(timings);
+    }
+    else {
+        recent_[recentHead_] = timings;
+        recentHead_ = (recentHead_ + 1) % overlayFrames;
+    }
+    if (record_)
+        history_.push_back(timings);
+}
+
+FrameTimings FrameProfiler::takeAverage(size_t& frames) {
+    FrameTimings average = sum_;
+    frames = sumFrames_;
+    if (frames > 0) {
+        for (double& ms : average.cpuMs)
+            ms /= frames;
+        for (double& ms : average.gpuMs)
+            ms /= frames;
+    }
+    average.frame = frame_;
+    sum_ = FrameTimings();
+    sumFrames_ = 0;
+    return average;
+}
+
+void FrameProfiler::drawOverlay() {
+    const float background[3] = { 0.0f, 0.0f, 0.0f };
+    const float target[3] = { 1.0f, 1.0f, 1.0f };
+    float width = overlayFrames * overlayBarWidth;
+    float cpuBaseline = overlayMargin + overlayGraphHeight;
+    float gpuBaseline = cpuBaseline + overlayMargin + overlayGraphHeight;
+    float targetHeight = overlayTargetMs * overlayGraphHeight / overlayFullScaleMs;
+
+    overlayVertices_.clear();
+    for (float baseline : { cpuBaseline, gpuBaseline }) {
+        addQuad(overlayVertices_, overlayMargin, baseline - overlayGraphHeight, overlayMargin + width, baseline,
+                background, 0.6f);
+    }
+    for (size_t i = 0; i < recent_.size(); i++) {
+        const FrameTimings& timings = recent_[(recentHead_ + i) % recent_.size()];
+        float x = overlayMargin + i * overlayBarWidth;
+        addBar(overlayVertices_, x, cpuBaseline, timings.cpuMs, cpuPhaseCount, cpuPhaseColors);
+        addBar(overlayVertices_, x, gpuBaseline, timings.gpuMs, gpuPassCount, gpuPassColors);
+    }
+    for (float baseline : { cpuBaseline, gpuBaseline }) {
+        addQuad(overlayVertices_, overlayMargin, baseline - targetHeight - 1.0f, overlayMargin + width,
+                baseline - targetHeight, target, 0.8f);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, overlayBuffer_);
+    glBufferData(GL_ARRAY_BUFFER, overlayVertices_.size() * sizeof(float), overlayVertices_.data(), GL_STREAM_DRAW);
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(overlayShader_.id);
+    glBindVertexArray(overlayVao_);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<int>(overlayVertices_.size() / 6));
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
+
+bool FrameProfiler::writeFile(const char* path) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to write profile " << path << std::endl;
+        return false;
+    }
+
+    size_t length = std::strlen(path);
+    bool json = length >= 5 && std::strcmp(path + length - 5, ".json") == 0;
+    char buffer[32];
+    if (json) {
+        out << "{\n  \"droppedFrames\": " << dropped_ << ",\n  \"frames\": [";
+        for (size_t i = 0; i < history_.size(); i++) {
+            const FrameTimings& timings = history_[i];
+            out << (i ? ",\n" : "\n") << "    { \"frame\": " << timings.frame << ", \"cpuMs\": {";
+            for (size_t phase = 0; phase < cpuPhaseCount; phase++) {
+                out << (phase ? ", \"" : " \"") << cpuPhaseName(static_cast<CpuPhase>(phase)) << "\": "
+                    << csvField(timings.cpuMs[phase], buffer, sizeof(buffer));
+            }
+            out << " }, \"gpuMs\": {";
+            for (size_t pass = 0; pass < gpuPassCount; pass++) {
+                double ms = timings.gpuMs[pass];
+                out << (pass ? ", \"" : " \"") << gpuPassName(static_cast<GpuPass>(pass)) << "\": "
+                    << (ms < 0.0 ? "null" : csvField(ms, buffer, sizeof(buffer)));
+            }
+            out << " } }";
+        }
+        out << "\n  ]\n}\n";
+    }
+    else {
+        // Empty GPU fields mark passes that did not run or were dropped.
+        out << "frame";
+        for (size_t phase = 0; phase < cpuPhaseCount; phase++)
+            out << ",cpu_" << cpuPhaseName(static_cast<CpuPhase>(phase)) << "_ms";
+        for (size_t pass = 0; pass < gpuPassCount; pass++)
+            out << ",gpu_" << gpuPassName(static_cast<GpuPass>(pass)) << "_ms";
+        out << "\n";
+        for (const FrameTimings& timings : history_) {
+            out << timings.frame;
+            for (double ms : timings.cpuMs)
+                out << "," << csvField(ms, buffer, sizeof(buffer));
+            for (double ms : timings.gpuMs)
+                out << "," << csvField(ms, buffer, sizeof(buffer));
+            out << "\n";
+        }
+    }
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write profile " << path << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << history_.size() << " frames of timings to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "metrics.h"
+#include "shader_program.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Parts of the main loop timed on the CPU, in loop order.
+enum class CpuPhase {
+    // Event polling and key handling.
+    Input,
+    // Streaming, matrices, uniforms and culling.
+    Update,
+    // Draw calls and the per-second report.
+    Submit,
+    // Buffer swap, including any wait for vsync.
+    Swap,
+    Count
+};
+
+// GPU work timed with GL_TIME_ELAPSED queries. Queries cannot nest, so
+// passes run one after another.
+enum class GpuPass {
+    // GPU culling, with the occluder pass and Hi-Z build when enabled.
+    Cull,
+    // Filled triangles; in single-pass mode this includes the outline.
+    Fill,
+    // Two-pass outline lines.
+    Outline,
+    Count
+};
+
+const size_t cpuPhaseCount = static_cast<size_t>(CpuPhase::Count);
+const size_t gpuPassCount = static_cast<size_t>(GpuPass::Count);
+
+const char* cpuPhaseName(CpuPhase phase);
+const char* gpuPassName(GpuPass pass);
+
+struct FrameTimings {
+    uint64_t frame = 0;
+    double cpuMs[cpuPhaseCount] = {};
+    // Negative when the pass did not run, or when its result was dropped
+    // because the GPU fell more than FrameProfiler::latency frames behind.
+    double gpuMs[gpuPassCount] = {};
+};
+
+// Per-frame CPU phase and GPU pass times. GPU queries go into a ring
+// latency frames deep and are only read once available, so profiling
+// never stalls the pipeline; a frame's record completes when its GPU
+// results arrive, a few frames after it was submitted.
+class FrameProfiler {
+public:
+    static const int latency = 4;
+    // Frames shown in the overlay graph.
+    static const size_t overlayFrames = 240;
+
+    // record keeps every completed frame for writeFile.
+    bool create(bool record);
+    void destroy();
+
+    // Frame times and completed frames are also reported to metrics.
+    void setMetrics(Metrics* metrics) { metrics_ = metrics; }
+
+    // Collects finished GPU results, then starts the frame in CpuPhase::Input.
+    void beginFrame();
+    // Ends the current phase and starts the next one.
+    void beginPhase(CpuPhase phase);
+    // Ends the last phase.
+    void endFrame();
+    // Waits for the GPU and completes every pending frame.
+    void finish();
+    uint64_t frameNumber() const { return frame_; }
+
+    void beginPass(GpuPass pass);
+    void endPass();
+
+    // Average of the frames completed since the last call; passes that did
+    // not run count as zero. frames is how many were averaged.
+    FrameTimings takeAverage(size_t& frames);
+    size_t droppedFrames() const { return dropped_; }
+
+    // Stacked bars of the recent frames, CPU phases above GPU passes, in
+    // the top-left corner. Uses the Frame uniform block, so draw it while
+    // this frame's is bound.
+    void drawOverlay();
+
+    // Writes every recorded frame as CSV, or as JSON when path ends in
+    // .json. Returns false if the file cannot be written.
+    bool writeFile(const char* path) const;
+    // Every completed frame, oldest first, when created with record.
+    const std::vector<FrameTimings>& history() const { return history_; }
+
+private:
+    struct Slot {
+        FrameTimings timings;
+        unsigned int queries[gpuPassCount] = {};
+        bool issued[gpuPassCount] = {};
+        bool pending = false;
+    };
+    using Clock = std::chrono::steady_clock;
+
+    bool resolve(Slot& slot, bool force);
+    void complete(const FrameTimings& timings);
+
+    Slot slots_[latency];
+    uint64_t frame_ = 0;
+    int activePass_ = -1;
+    int phase_ = -1;
+    Clock::time_point phaseStart_;
+    Clock::time_point frameStart_;
+    Metrics* metrics_ = nullptr;
+    size_t dropped_ = 0;
+
+    FrameTimings sum_;
+    size_t sumFrames_ = 0;
+
+    // Ring of the last overlayFrames completed frames, oldest at recentHead_
+    // once full.
+    std::vector<FrameTimings> recent_;
+    size_t recentHead_ = 0;
+    bool record_ = false;
+    std::vector<FrameTimings> history_;
+
+    ShaderProgram overlayShader_;
+    unsigned int overlayVao_ = 0;
+    unsigned int overlayBuffer_ = 0;
+    std::vector<float> overlayVertices_;
+};
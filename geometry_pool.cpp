@@ -0,0 +1,258 @@
+#include "geometry_pool.h"
+#include "edge_builder.h"
+#include "staging_ring.h"
+#include "vertex_quantization.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+void GeometryPool::create(size_t vertexCapacity, size_t indexCapacity, size_t edgeIndexCapacity, bool shortIndices,
+                          bool quantized) {
+    destroy();
+    shortIndices_ = shortIndices;
+    quantized_ = quantized;
+
+    // reserve() attaches each new buffer to the VAO and edge mask texture.
+    glGenVertexArrays(1, &vao_);
+    reserve(vertices_, vertexSize(), vertexCapacity);
+    reserve(indices_, indexSize(), indexCapacity);
+    reserve(edgeIndices_, indexSize(), edgeIndexCapacity);
+    reserve(edgeMasks_, 1, indexCapacity / 3);
+
+    glBindVertexArray(vao_);
+    glEnableVertexAttribArray(positionAttribute);
+    glBindVertexArray(0);
+}
+
+void GeometryPool::destroy() {
+    if (vao_)
+        glDeleteVertexArrays(1, &vao_);
+    if (edgeMaskTexture_)
+        glDeleteTextures(1, &edgeMaskTexture_);
+    for (Region* region : { &vertices_, &indices_, &edgeIndices_, &edgeMasks_ }) {
+        if (region->buffer)
+            glDeleteBuffers(1, &region->buffer);
+        *region = Region();
+    }
+    pending_.clear();
+    vao_ = 0;
+    ebo_ = 0;
+    edgeEbo_ = 0;
+    edgeMaskTexture_ = 0;
+}
+
+void GeometryPool::reserve(Region& region, size_t elementSize, size_t count) {
+    size_t needed = region.used + count;
+    if (region.buffer && needed <= region.capacity)
+        return;
+
+    size_t capacity = std::max<size_t>(region.capacity, 1024);
+    while (capacity < needed)
+        capacity *= 2;
+
+    // Allocated through the copy targets so no VAO or texture binding
+    // changes until the new buffer is attached below.
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity * elementSize, nullptr, GL_STATIC_DRAW);
+
+    if (region.buffer) {
+        glBindBuffer(GL_COPY_READ_BUFFER, region.buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, region.used * elementSize);
+        glDeleteBuffers(1, &region.buffer);
+    }
+    region.buffer = buffer;
+    region.capacity = capacity;
+
+    // Re-attach the new storage wherever the old buffer was referenced.
+    if (&region == &vertices_ && vao_) {
+        glBindVertexArray(vao_);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (quantized_)
+            glVertexAttribPointer(positionAttribute, 3, GL_UNSIGNED_SHORT, GL_TRUE, 3 * sizeof(uint16_t), (void*)0);
+        else
+            glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+    }
+    else if (&region == &indices_) {
+        ebo_ = buffer;
+        if (vao_) {
+            glBindVertexArray(vao_);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+            glBindVertexArray(0);
+        }
+    }
+    else if (&region == &edgeIndices_) {
+        edgeEbo_ = buffer;
+    }
+    else if (&region == &edgeMasks_) {
+        if (!edgeMaskTexture_)
+            glGenTextures(1, &edgeMaskTexture_);
+        glBindTexture(GL_TEXTURE_BUFFER, edgeMaskTexture_);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, buffer);
+    }
+}
+
+void GeometryPool::upload(Region GeometryPool::*region, const void* data, size_t bytes, bool streamed) {
+    Region& target = this->*region;
+    size_t offset = target.used * (region == &GeometryPool::vertices_ ? vertexSize() : indexSize());
+    if (bytes == 0)
+        return;
+    if (streamed) {
+        pending_.push_back({ region, offset, bytes, 0, data, false });
+        return;
+    }
+    // Element buffers are written outside the VAO so its binding is not disturbed.
+    glBindVertexArray(0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+}
+
+void GeometryPool::uploadIndices(Region GeometryPool::*region, const unsigned int* indices, size_t count, bool streamed) {
+    if (shortIndices_ && streamed && count > 0) {
+        // Narrowed chunk by chunk while staging, so no 16-bit copy is kept.
+        size_t offset = (this->*region).used * sizeof(unsigned short);
+        pending_.push_back({ region, offset, count * sizeof(unsigned short), 0, indices, true });
+    }
+    else if (shortIndices_) {
+        std::vector<unsigned short> shortIndices(indices, indices + count);
+        upload(region, shortIndices.data(), count * sizeof(unsigned short), false);
+    }
+    else {
+        upload(region, indices, count * sizeof(unsigned int), streamed);
+    }
+    (this->*region).used += count;
+}
+
+bool GeometryPool::add(const MeshView& view, GpuMesh& mesh) {
+    return place(view, mesh, false);
+}
+
+bool GeometryPool::addStreamed(const MeshView& view, GpuMesh& mesh) {
+    return place(view, mesh, true);
+}
+
+bool GeometryPool::place(const MeshView& view, GpuMesh& mesh, bool streamed) {
+    if (shortIndices_ && view.vertexCount >= maxShortIndexVertices)
+        return false;
+    if (view.vertexCount > 0 && quantized_ != (view.quantizedVertices != nullptr))
+        return false;
+
+    reserve(vertices_, vertexSize(), view.vertexCount);
+    reserve(indices_, indexSize(), view.indexCount);
+    reserve(edgeIndices_, indexSize(), view.edgeIndexCount);
+    reserve(edgeMasks_, 1, view.indexCount / 3);
+
+    GpuMesh added;
+    added.baseVertex = vertices_.used;
+    added.vertexCount = view.vertexCount;
+    added.firstIndex = indices_.used;
+    added.indexCount = view.indexCount;
+    added.firstEdgeIndex = edgeIndices_.used;
+    added.edgeIndexCount = view.edgeIndexCount;
+    added.firstTriangle = edgeMasks_.used;
+    added.lodCount = std::min(lodCountOf(view), maxLodCount);
+    for (size_t lod = 0; lod < added.lodCount; lod++)
+        added.lods[lod] = lodOf(view, lod);
+    added.color = view.color;
+    added.boundsMin = view.boundsMin;
+    added.boundsMax = view.boundsMax;
+    if (quantized_)
+        added.positionTransform = dequantizeTransform(view.boundsMin, view.boundsMax);
+
+    const void* vertices = quantized_ ? static_cast<const void*>(view.quantizedVertices) : view.vertices;
+    upload(&GeometryPool::vertices_, vertices, view.vertexCount * vertexSize(), streamed);
+    vertices_.used += view.vertexCount;
+
+    uploadIndices(&GeometryPool::indices_, view.indices, view.indexCount, streamed);
+    uploadIndices(&GeometryPool::edgeIndices_, view.edgeIndices, view.edgeIndexCount, streamed);
+    edgeMasks_.used += view.indexCount / 3;
+
+    mesh = added;
+    return true;
+}
+
+size_t GeometryPool::streamUploads(StagingRing& ring) {
+    if (pending_.empty())
+        return 0;
+    unsigned char* staging = ring.beginSegment();
+    if (!staging)
+        return 0;
+
+    size_t used = 0;
+    while (!pending_.empty() && used < ring.segmentSize()) {
+        PendingUpload& next = pending_.front();
+        // Chunks other than an upload's last stay 4-byte aligned, which
+        // keeps narrowed indices whole; everything else is copied as bytes.
+        size_t bytes = std::min(next.bytes - next.done, ring.segmentSize() - used);
+        if (next.done + bytes < next.bytes)
+            bytes &= ~size_t(3);
+        if (bytes == 0)
+            break;
+
+        if (next.narrowIndices) {
+            const unsigned int* source = static_cast<const unsigned int*>(next.source) + next.done / sizeof(unsigned short);
+            unsigned short* target = reinterpret_cast<unsigned short*>(staging + used);
+            for (size_t i = 0; i < bytes / sizeof(unsigned short); i++)
+                target[i] = static_cast<unsigned short>(source[i]);
+        }
+        else {
+            std::memcpy(staging + used, static_cast<const unsigned char*>(next.source) + next.done, bytes);
+        }
+        ring.copy(used, (this->*next.region).buffer, next.offset + next.done, bytes);
+
+        used += bytes;
+        next.done += bytes;
+        if (next.done == next.bytes)
+            pending_.pop_front();
+    }
+    ring.endSegment();
+    return used;
+}
+
+size_t GeometryPool::pendingBytes() const {
+    size_t bytes = 0;
+    for (const PendingUpload& upload : pending_)
+        bytes += upload.bytes - upload.done;
+    return bytes;
+}
+
+void GeometryPool::uploadEdgeMask(GpuMesh& mesh, const MeshView& view) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, edgeMasks_.buffer);
+    for (size_t lod = 0; lod < mesh.lodCount; lod++) {
+        const MeshLod& range = mesh.lods[lod];
+        std::vector<unsigned char> masks = buildTriangleEdgeMask(view.indices + range.firstIndex, range.indexCount,
+                                                                 view.edgeIndices + range.firstEdgeIndex,
+                                                                 range.edgeIndexCount);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.firstTriangle + range.firstIndex / 3, masks.size(), masks.data());
+    }
+    mesh.edgeMaskReady = true;
+}
+
+size_t GeometryPool::memoryBytes() const {
+    return vertices_.capacity * vertexSize()
+        + (indices_.capacity + edgeIndices_.capacity) * indexSize()
+        + edgeMasks_.capacity;
+}
+
+void bindInstanceAttributes(unsigned int vao, unsigned int buffer, size_t firstInstance) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    size_t base = firstInstance * sizeof(InstanceData);
+    for (unsigned int column = 0; column < 4; column++) {
+        unsigned int location = instanceTransformAttribute + column;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(base + offsetof(InstanceData, transform) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+    glVertexAttribPointer(instanceColorAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                          (void*)(base + offsetof(InstanceData, color)));
+    glVertexAttribDivisor(instanceColorAttribute, 1);
+    glEnableVertexAttribArray(instanceColorAttribute);
+    glVertexAttribIPointer(instanceEdgeMaskAttribute, 1, GL_UNSIGNED_INT, sizeof(InstanceData),
+                           (void*)(base + offsetof(InstanceData, edgeMaskBase)));
+    glVertexAttribDivisor(instanceEdgeMaskAttribute, 1);
+    glEnableVertexAttribArray(instanceEdgeMaskAttribute);
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "mesh.h"
+#include "mesh_optimizer.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <deque>
+
+class StagingRing;
+
+// Vertex attribute locations of the pool VAO. The instance transform is a
+// mat4 and therefore takes four consecutive locations.
+const unsigned int positionAttribute = 0;
+const unsigned int instanceTransformAttribute = 1;
+const unsigned int instanceColorAttribute = 5;
+const unsigned int instanceEdgeMaskAttribute = 6;
+
+// Per-instance vertex attributes, read with divisor 1.
+struct InstanceData {
+    glm::mat4 transform;
+    glm::vec4 color;
+    // First entry of the instance's mesh in the pool's edge mask buffer.
+    unsigned int edgeMaskBase;
+    unsigned int padding[3];
+};
+
+// Points the instance attributes of vao at buffer, starting at
+// firstInstance. Shared by every VAO that draws scene instances.
+void bindInstanceAttributes(unsigned int vao, unsigned int buffer, size_t firstInstance);
+
+// Where one mesh lives inside the pool, plus what draws and culling need.
+// Indices are stored relative to baseVertex.
+struct GpuMesh {
+    size_t baseVertex = 0;
+    size_t vertexCount = 0;
+    size_t firstIndex = 0;
+    size_t indexCount = 0;
+    size_t firstEdgeIndex = 0;
+    size_t edgeIndexCount = 0;
+    size_t firstTriangle = 0;
+    bool edgeMaskReady = false;
+    // Maps stored positions to mesh space, ahead of each instance
+    // transform: identity for floats, the bounds box for quantized ones.
+    glm::mat4 positionTransform = glm::mat4(1.0f);
+    // Ranges relative to firstIndex and firstEdgeIndex; at least one.
+    MeshLod lods[maxLodCount] = {};
+    size_t lodCount = 0;
+
+    glm::vec3 color = glm::vec3(0.0f);
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// Shared vertex, triangle index and edge index buffers that many meshes
+// are suballocated from, drawn through one VAO. Allocation is a bump
+// pointer per buffer; when one fills up it is reallocated at double size
+// and its contents copied on the GPU. Meshes are either uploaded when
+// added or queued and streamed in over several frames.
+class GeometryPool {
+public:
+    // shortIndices selects GL_UNSIGNED_SHORT storage; every mesh added must
+    // then have fewer than maxShortIndexVertices vertices. quantized
+    // stores positions as three normalized GL_UNSIGNED_SHORT, half the
+    // size of floats; every mesh added must then be quantized, and only
+    // such meshes can be added otherwise.
+    void create(size_t vertexCapacity, size_t indexCapacity, size_t edgeIndexCapacity, bool shortIndices,
+                bool quantized = false);
+    void destroy();
+
+    // Uploads the mesh into free space. Returns false (and leaves mesh
+    // untouched) if it cannot be stored with this pool's index type or
+    // position format.
+    bool add(const MeshView& view, GpuMesh& mesh);
+    // Like add, but only allocates the space; the data is copied in by
+    // later streamUploads calls. view's arrays must stay alive until
+    // uploadsPending() is false.
+    bool addStreamed(const MeshView& view, GpuMesh& mesh);
+
+    // Copies queued mesh data through one segment of ring, at most its
+    // segment size. Returns the bytes uploaded; 0 when nothing is queued or
+    // the ring has no free segment this frame.
+    size_t streamUploads(StagingRing& ring);
+    bool uploadsPending() const { return !pending_.empty(); }
+    size_t pendingBytes() const;
+
+    // Fills the outline masks of all the mesh's LODs for the single-pass
+    // wireframe; each LOD's masks start at firstTriangle + firstIndex / 3.
+    void uploadEdgeMask(GpuMesh& mesh, const MeshView& view);
+
+    unsigned int vao() const { return vao_; }
+    unsigned int indexBuffer() const { return ebo_; }
+    unsigned int edgeIndexBuffer() const { return edgeEbo_; }
+    unsigned int edgeMaskTexture() const { return edgeMaskTexture_; }
+    GLenum indexType() const { return shortIndices_ ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT; }
+    size_t indexSize() const { return shortIndices_ ? sizeof(unsigned short) : sizeof(unsigned int); }
+    size_t vertexSize() const { return quantized_ ? 3 * sizeof(uint16_t) : 3 * sizeof(float); }
+
+    // Bytes of GPU memory held by the pool's buffers.
+    size_t memoryBytes() const;
+
+    // Points the instance attributes at buffer, starting at firstInstance.
+    void bindInstanceAttributes(unsigned int buffer, size_t firstInstance) const {
+        ::bindInstanceAttributes(vao_, buffer, firstInstance);
+    }
+
+private:
+    struct Region {
+        unsigned int buffer = 0;
+        size_t capacity = 0;
+        size_t used = 0;
+    };
+    // Part of a region still to be written by streamUploads. Regions are
+    // named by member so growing one in the meantime is harmless.
+    struct PendingUpload {
+        Region GeometryPool::*region;
+        size_t offset;
+        size_t bytes;
+        size_t done;
+        const void* source;
+        // The source holds 32-bit indices to be stored as 16-bit.
+        bool narrowIndices;
+    };
+    bool place(const MeshView& view, GpuMesh& mesh, bool streamed);
+    void reserve(Region& region, size_t elementSize, size_t count);
+    void upload(Region GeometryPool::*region, const void* data, size_t bytes, bool streamed);
+    void uploadIndices(Region GeometryPool::*region, const unsigned int* indices, size_t count, bool streamed);
+
+    unsigned int vao_ = 0;
+    unsigned int ebo_ = 0;
+    unsigned int edgeEbo_ = 0;
+    unsigned int edgeMaskTexture_ = 0;
+    Region vertices_;
+    Region indices_;
+    Region edgeIndices_;
+    Region edgeMasks_;
+    bool shortIndices_ = false;
+    bool quantized_ = false;
+    std::deque<PendingUpload> pending_;
+};
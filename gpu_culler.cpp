@@ -0,0 +1,271 @@
+#include "gpu_culler.h"
+#include "bvh.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Instance mirrors InstanceData and Command DrawElementsIndirectCommand;
+// both have the same layout under std430. Commands come in groups of
+// maxLodCount per scene batch, triangle commands first, and each
+// (batch, LOD) pair owns batch.instanceCount slots of the output.
+static const char* cullShaderSource = R"glsl(
+#version 430 core
+#define MAX_LODS 4
+layout (local_size_x = 64) in;
+struct Instance { mat4 transform; vec4 color; uint edgeMaskBase; uint padding0, padding1, padding2; };
+struct Bounds { vec3 boundsMin; uint batch; vec3 boundsMax; float scale; };
+struct Command { uint count; uint instanceCount; uint firstIndex; uint baseVertex; uint baseInstance; };
+struct BatchLods { vec4 errors; uvec4 edgeMaskBases; uint lodCount; uint padding0, padding1, padding2; };
+layout (std430, binding = 0) readonly buffer SourceInstances { Instance sourceInstances[]; };
+layout (std430, binding = 1) readonly buffer InstanceBounds { Bounds bounds[]; };
+layout (std430, binding = 2) writeonly buffer VisibleInstances { Instance visibleInstances[]; };
+layout (std430, binding = 3) buffer Commands { Command commands[]; };
+layout (std430, binding = 4) readonly buffer Lods { BatchLods batchLods[]; };
+uniform uint instanceCount;
+uniform uint batchCount;
+uniform vec4 frustumPlanes[6];
+uniform bool frustumCull;
+uniform vec3 lodEye;
+uniform float pixelsPerUnit;
+uniform float maxPixelError;
+uniform bool occlusionCull;
+uniform sampler2D hiZ;
+uniform vec2 hiZSize;
+uniform mat4 viewProjection;
+
+// True when the box is entirely behind the Hi-Z depth over its screen
+// rectangle. The mip level is picked so the rectangle spans at most 2x2
+// texels, which the four samples cover.
+bool occluded(vec3 boundsMin, vec3 boundsMax) {
+    vec3 ndcMin = vec3(1e30);
+    vec3 ndcMax = vec3(-1e30);
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 select = vec3(float(corner & 1), float((corner >> 1) & 1), float((corner >> 2) & 1));
+        vec4 clip = viewProjection * vec4(mix(boundsMin, boundsMax, select), 1.0);
+        // Boxes crossing the eye plane are never rejected.
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+
+    vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 size = (uvMax - uvMin) * hiZSize;
+    float level = ceil(log2(max(max(size.x, size.y), 1.0)));
+    float depth = max(max(textureLod(hiZ, uvMin, level).r, textureLod(hiZ, vec2(uvMax.x, uvMin.y), level).r),
+                      max(textureLod(hiZ, vec2(uvMin.x, uvMax.y), level).r, textureLod(hiZ, uvMax, level).r));
+    return ndcMin.z * 0.5 + 0.5 > depth;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= instanceCount)
+        return;
+
+    Bounds box = bounds[index];
+    vec3 center = (box.boundsMin + box.boundsMax) * 0.5;
+    vec3 halfExtent = (box.boundsMax - box.boundsMin) * 0.5;
+    for (int plane = 0; frustumCull && plane < 6; plane++) {
+        float distance = dot(frustumPlanes[plane].xyz, center) + frustumPlanes[plane].w;
+        if (distance < -dot(abs(frustumPlanes[plane].xyz), halfExtent))
+            return;
+    }
+    if (occlusionCull && occluded(box.boundsMin, box.boundsMax))
+        return;
+
+    // Same rule as selectLod in scene.cpp.
+    BatchLods lods = batchLods[box.batch];
+    uint lod = 0u;
+    float distance = length(lodEye - center) - length(halfExtent);
+    if (maxPixelError > 0.0 && distance > 0.0) {
+        float pixelsPerError = box.scale * pixelsPerUnit / distance;
+        while (lod + 1u < lods.lodCount && lods.errors[lod + 1u] * pixelsPerError <= maxPixelError)
+            lod++;
+    }
+
+    // Triangle and edge commands of a batch count the same instances.
+    uint command = box.batch * MAX_LODS + lod;
+    uint slot = atomicAdd(commands[command].instanceCount, 1u);
+    atomicAdd(commands[batchCount * MAX_LODS + command].instanceCount, 1u);
+    Instance instance = sourceInstances[index];
+    instance.edgeMaskBase = lods.edgeMaskBases[lod];
+    visibleInstances[commands[command].baseInstance + slot] = instance;
+}
+)glsl";
+
+// std430 layouts of the shader's Bounds and BatchLods.
+struct CullBounds {
+    glm::vec3 boundsMin;
+    unsigned int batch;
+    glm::vec3 boundsMax;
+    float scale;
+};
+
+struct CullBatchLods {
+    float errors[maxLodCount];
+    unsigned int edgeMaskBases[maxLodCount];
+    unsigned int lodCount;
+    unsigned int padding[3];
+};
+static_assert(maxLodCount == 4, "MAX_LODS in the cull shader must match maxLodCount");
+
+static const unsigned int cullGroupSize = 64;
+// Unit 0 holds the edge mask buffer texture.
+static const unsigned int hiZTextureUnit = 1;
+
+bool GpuCuller::supported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+bool GpuCuller::create(Scene& scene) {
+    destroy();
+    if (!supported() || !scene.indirect) {
+        std::cerr << "GPU culling needs OpenGL 4.3 and multi-draw indirect" << std::endl;
+        return false;
+    }
+
+    program_ = linkComputeProgram(cullShaderSource);
+    glUseProgram(program_.id);
+    glUniform1i(program_.location(Uniform::HiZ), hiZTextureUnit);
+
+    // Every (batch, LOD) pair gets a command and room for all of the
+    // batch's instances, so compaction never needs more than one pass.
+    std::vector<CullBounds> bounds(scene.instanceData.size());
+    std::vector<CullBatchLods> batchLods(scene.batches.size());
+    std::vector<InstanceBatch> drawBatches;
+    size_t slots = 0;
+    for (unsigned int batch = 0; batch < scene.batches.size(); batch++) {
+        const InstanceBatch& range = scene.batches[batch];
+        const GpuMesh& mesh = scene.meshes[range.mesh];
+        for (size_t i = range.firstInstance; i < range.firstInstance + range.instanceCount; i++) {
+            bounds[i] = { scene.instanceBoundsMin[i], batch, scene.instanceBoundsMax[i], scene.instanceScale[i] };
+        }
+
+        CullBatchLods& lods = batchLods[batch];
+        lods = CullBatchLods();
+        lods.lodCount = static_cast<unsigned int>(mesh.lodCount);
+        for (unsigned int lod = 0; lod < maxLodCount; lod++) {
+            unsigned int used = std::min<unsigned int>(lod, lods.lodCount - 1);
+            lods.errors[lod] = mesh.lods[used].error;
+            lods.edgeMaskBases[lod] = static_cast<unsigned int>(mesh.firstTriangle + mesh.lods[used].firstIndex / 3);
+            drawBatches.push_back({ range.mesh, used, slots, range.instanceCount });
+            slots += range.instanceCount;
+        }
+    }
+
+    std::vector<DrawElementsIndirectCommand> commands = buildDrawCommands(scene, drawBatches);
+    for (DrawElementsIndirectCommand& command : commands)
+        command.instanceCount = 0;
+    commandBytes_ = commands.size() * sizeof(DrawElementsIndirectCommand);
+
+    glGenBuffers(1, &sourceInstances_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, sourceInstances_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, scene.instanceData.size() * sizeof(InstanceData),
+                 scene.instanceData.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &bounds_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bounds_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(CullBounds), bounds.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &batchLods_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, batchLods_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, batchLods.size() * sizeof(CullBatchLods), batchLods.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &clearedCommands_);
+    glBindBuffer(GL_COPY_READ_BUFFER, clearedCommands_);
+    glBufferData(GL_COPY_READ_BUFFER, commandBytes_, commands.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // The GPU writes the instance buffer in place, so the draw list always
+    // covers every (batch, LOD) pair and the buffer has a slot for each.
+    scene.drawBatches = drawBatches;
+    scene.instanceCapacity = slots;
+    scene.uploadedInstances.clear();
+    scene.instanceBufferHoldsAll = false;
+    glBindBuffer(GL_ARRAY_BUFFER, scene.instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, slots * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes_, commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return true;
+}
+
+void GpuCuller::updateInstances(const Scene& scene) {
+    const std::vector<unsigned int>& slots = scene.changedSlots;
+    size_t i = 0;
+    while (i < slots.size()) {
+        size_t count = 1;
+        while (i + count < slots.size() && slots[i + count] == slots[i] + count)
+            count++;
+        unsigned int first = slots[i];
+        std::vector<CullBounds> bounds(count);
+        for (size_t j = 0; j < count; j++) {
+            unsigned int slot = first + static_cast<unsigned int>(j);
+            // Last batch starting at or before the slot
+            auto batch = std::upper_bound(scene.batches.begin(), scene.batches.end(), slot,
+                                          [](unsigned int value, const InstanceBatch& range) {
+                                              return value < range.firstInstance;
+                                          }) - 1;
+            bounds[j] = { scene.instanceBoundsMin[slot], static_cast<unsigned int>(batch - scene.batches.begin()),
+                          scene.instanceBoundsMax[slot], scene.instanceScale[slot] };
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, sourceInstances_);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(InstanceData), count * sizeof(InstanceData),
+                        &scene.instanceData[first]);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bounds_);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(CullBounds), count * sizeof(CullBounds),
+                        bounds.data());
+        i += count;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCuller::destroy() {
+    if (program_.id)
+        destroyShaderProgram(program_);
+    for (unsigned int* buffer : { &sourceInstances_, &bounds_, &batchLods_, &clearedCommands_ }) {
+        if (*buffer)
+            glDeleteBuffers(1, buffer);
+        *buffer = 0;
+    }
+    commandBytes_ = 0;
+}
+
+void GpuCuller::cull(Scene& scene, const DrawListView& view, const HiZBuffer* hiZ) {
+    unsigned int instanceCount = static_cast<unsigned int>(scene.instanceData.size());
+    if (instanceCount == 0)
+        return;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, clearedCommands_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, scene.commandBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commandBytes_);
+
+    Frustum frustum = frustumFromMatrix(view.viewProjection);
+    glUseProgram(program_.id);
+    glUniform1ui(program_.location(Uniform::InstanceCount), instanceCount);
+    glUniform1ui(program_.location(Uniform::BatchCount), static_cast<unsigned int>(scene.batches.size()));
+    glUniform4fv(program_.location(Uniform::FrustumPlanes), 6, &frustum.planes[0].x);
+    glUniform1i(program_.location(Uniform::FrustumCull), view.frustumCull ? 1 : 0);
+    glUniform3fv(program_.location(Uniform::LodEye), 1, &view.eye.x);
+    glUniform1f(program_.location(Uniform::PixelsPerUnit), view.pixelsPerUnit);
+    glUniform1f(program_.location(Uniform::MaxPixelError), view.maxPixelError);
+    glUniform1i(program_.location(Uniform::OcclusionCull), hiZ ? 1 : 0);
+    if (hiZ) {
+        glUniform2f(program_.location(Uniform::HiZSize), static_cast<float>(hiZ->width()),
+                    static_cast<float>(hiZ->height()));
+        glUniformMatrix4fv(program_.location(Uniform::ViewProjection), 1, GL_FALSE, &view.viewProjection[0][0]);
+        glActiveTexture(GL_TEXTURE0 + hiZTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, hiZ->texture());
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, sourceInstances_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, bounds_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scene.instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, scene.commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, batchLods_);
+    glDispatchCompute((instanceCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+
+    // The draws read the results as commands and instance attributes.
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "hiz_buffer.h"
+#include "scene.h"
+#include "shader_program.h"
+#include <glm/glm.hpp>
+
+// Frustum culling and LOD selection on the GPU. A compute shader tests
+// every instance's world bounds, picks its LOD with the same rule as
+// selectLod, and appends it to the range of the scene's instance buffer
+// reserved for its (batch, LOD) pair, bumping the instance counts of that
+// pair's indirect commands as it goes. Nothing is read back, so the CPU cost of
+// a cull does not depend on the instance count. Needs GL 4.3 and a scene
+// uploaded with indirect drawing.
+class GpuCuller {
+public:
+    static bool supported();
+
+    bool create(Scene& scene);
+    void destroy();
+
+    // Overwrites the scene's instanceBuffer and commandBuffer with the
+    // instances visible in view. With hiZ, instances hidden behind the
+    // occluder depth it holds for this view are dropped as well.
+    void cull(Scene& scene, const DrawListView& view, const HiZBuffer* hiZ = nullptr);
+
+    // Copies the instances flushInstanceTransforms listed in the scene's
+    // changedSlots into the culler's own instance and bounds buffers.
+    void updateInstances(const Scene& scene);
+
+private:
+    ShaderProgram program_;
+    // Every instance in batch order, and its bounds with the batch index.
+    unsigned int sourceInstances_ = 0;
+    unsigned int bounds_ = 0;
+    // Per batch: LOD errors and edge mask offsets.
+    unsigned int batchLods_ = 0;
+    // The scene's commands with zero instance counts, copied over the
+    // command buffer before each cull.
+    unsigned int clearedCommands_ = 0;
+    size_t commandBytes_ = 0;
+};
@@ -0,0 +1,122 @@
+#include "hiz_buffer.h"
+#include <glad/glad.h>
+#include <algorithm>
+
+static const char* fullscreenVertexShader = R"glsl(
+#version 330 core
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)glsl";
+
+// Reads the level below through GL_TEXTURE_BASE_LEVEL, so the level being
+// written is never sampled. Non-square pyramids bottom out at one texel
+// along the short side, hence the clamp.
+static const char* downsampleFragmentShader = R"glsl(
+#version 330 core
+uniform sampler2D depthLevel;
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 last = textureSize(depthLevel, 0) - 1;
+    float top = max(texelFetch(depthLevel, min(texel, last), 0).r,
+                    texelFetch(depthLevel, min(texel + ivec2(1, 0), last), 0).r);
+    float bottom = max(texelFetch(depthLevel, min(texel + ivec2(0, 1), last), 0).r,
+                       texelFetch(depthLevel, min(texel + ivec2(1, 1), last), 0).r);
+    gl_FragDepth = max(top, bottom);
+}
+)glsl";
+
+static int floorPowerOfTwo(int value) {
+    int power = 1;
+    while (power * 2 <= value)
+        power *= 2;
+    return power;
+}
+
+bool HiZBuffer::create() {
+    destroy();
+    downsample_ = linkShaderProgram(fullscreenVertexShader, downsampleFragmentShader);
+    glUseProgram(downsample_.id);
+    glUniform1i(downsample_.location(Uniform::DepthLevel), 0);
+    glGenFramebuffers(1, &framebuffer_);
+    glGenVertexArrays(1, &emptyVao_);
+    return downsample_.id != 0;
+}
+
+void HiZBuffer::destroy() {
+    if (downsample_.id)
+        destroyShaderProgram(downsample_);
+    if (texture_)
+        glDeleteTextures(1, &texture_);
+    if (framebuffer_)
+        glDeleteFramebuffers(1, &framebuffer_);
+    if (emptyVao_)
+        glDeleteVertexArrays(1, &emptyVao_);
+    texture_ = 0;
+    framebuffer_ = 0;
+    emptyVao_ = 0;
+    width_ = height_ = levels_ = 0;
+}
+
+void HiZBuffer::allocate(int width, int height) {
+    if (texture_)
+        glDeleteTextures(1, &texture_);
+    width_ = width;
+    height_ = height;
+    levels_ = 1;
+    while ((std::max(width, height) >> levels_) > 0)
+        levels_++;
+
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    for (int level = 0; level < levels_; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_DEPTH_COMPONENT32F, std::max(width >> level, 1),
+                     std::max(height >> level, 1), 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+}
+
+void HiZBuffer::beginOccluderPass(int framebufferWidth, int framebufferHeight) {
+    int width = floorPowerOfTwo(std::max(framebufferWidth, 1));
+    int height = floorPowerOfTwo(std::max(framebufferHeight, 1));
+    if (width != width_ || height != height_)
+        allocate(width, height);
+
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels_ - 1);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture_, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glViewport(0, 0, width_, height_);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void HiZBuffer::buildPyramid(int framebufferWidth, int framebufferHeight, unsigned int framebuffer) {
+    glUseProgram(downsample_.id);
+    glBindVertexArray(emptyVao_);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glDepthFunc(GL_ALWAYS);
+
+    for (int level = 1; level < levels_; level++) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture_, level);
+        glViewport(0, 0, std::max(width_ >> level, 1), std::max(height_ >> level, 1));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels_ - 1);
+    glDepthFunc(GL_LESS);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, framebufferWidth, framebufferHeight);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "shader_program.h"
+
+// Hierarchical depth buffer: occluder depth rendered into a power-of-two
+// depth texture, then reduced level by level so each texel holds the
+// farthest depth of the four below it. A box whose nearest depth is
+// behind the farthest depth over its screen rectangle is hidden.
+class HiZBuffer {
+public:
+    bool create();
+    void destroy();
+
+    // Sizes the pyramid to the largest power of two not above the
+    // framebuffer, binds its FBO for the occluder pass and clears it.
+    void beginOccluderPass(int framebufferWidth, int framebufferHeight);
+    // Builds the coarser levels from level 0 and restores the given
+    // framebuffer (the default one unless rendering offscreen) and viewport.
+    void buildPyramid(int framebufferWidth, int framebufferHeight, unsigned int framebuffer = 0);
+
+    unsigned int texture() const { return texture_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    void allocate(int width, int height);
+
+    ShaderProgram downsample_;
+    unsigned int texture_ = 0;
+    unsigned int framebuffer_ = 0;
+    // Core profile needs a bound VAO even for an attribute-less triangle.
+    unsigned int emptyVao_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    int levels_ = 0;
+};
@@ -0,0 +1,108 @@
+#include "image_writer.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+uint32_t crcTable[256];
+
+void buildCrcTable() {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crcTable[n] = c;
+    }
+}
+
+uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size) {
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void appendBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+void writeChunk(std::ofstream& out, const char* type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> chunk;
+    chunk.reserve(data.size() + 12);
+    appendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    appendBigEndian(chunk, crc32(0, chunk.data() + 4, data.size() + 4));
+    out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+}
+
+bool writePng(const char* path, int width, int height, const uint32_t* pixels, size_t stride) {
+    if (crcTable[1] == 0)
+        buildCrcTable();
+
+    // Filter byte 0 per row, then RGB, top row first.
+    size_t rowBytes = static_cast<size_t>(width) * 3 + 1;
+    std::vector<unsigned char> raw(rowBytes * height);
+    for (int y = 0; y < height; y++) {
+        const uint32_t* row = pixels + static_cast<size_t>(height - 1 - y) * stride;
+        unsigned char* out = &raw[y * rowBytes];
+        *out++ = 0;
+        for (int x = 0; x < width; x++) {
+            *out++ = static_cast<unsigned char>(row[x]);
+            *out++ = static_cast<unsigned char>(row[x] >> 8);
+            *out++ = static_cast<unsigned char>(row[x] >> 16);
+        }
+    }
+
+    // zlib stream of stored deflate blocks, at most 65535 bytes each.
+    std::vector<unsigned char> zlib = { 0x78, 0x01 };
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    uint32_t adlerA = 1, adlerB = 0;
+    for (size_t offset = 0; offset < raw.size() || offset == 0; ) {
+        size_t size = std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<unsigned char>(size));
+        zlib.push_back(static_cast<unsigned char>(size >> 8));
+        zlib.push_back(static_cast<unsigned char>(~size));
+        zlib.push_back(static_cast<unsigned char>(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        for (size_t i = offset; i < offset + size; i++) {
+            adlerA = (adlerA + raw[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        offset += size;
+        if (last)
+            break;
+    }
+    appendBigEndian(zlib, (adlerB << 16) | adlerA);
+
+    std::vector<unsigned char> header;
+    appendBigEndian(header, static_cast<uint32_t>(width));
+    appendBigEndian(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), { 8, 2, 0, 0, 0 });
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to write image " << path << std::endl;
+        return false;
+    }
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+    writeChunk(out, "IHDR", header);
+    writeChunk(out, "IDAT", zlib);
+    writeChunk(out, "IEND", {});
+    if (!out) {
+        std::cerr << "Failed to write image " << path << std::endl;
+        return false;
+    }
+    return true;
+}
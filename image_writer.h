@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Writes RGBA8 pixels (r in the low byte) as an 8-bit RGB PNG. Rows are
+// stride pixels apart and stored bottom row first, as glReadPixels and
+// SoftwareRasterizer leave them, so the file comes out upright. The image
+// data is stored uncompressed: large, but cheap to write and exact.
+bool writePng(const char* path, int width, int height, const uint32_t* pixels, size_t stride);
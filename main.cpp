@@ -3,179 +3,319 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <fstream>
+#include <string>
 #include <vector>
-#include <set>
-#include <sstream>
-
-// Shader sources
-const char* vertexShaderSource = R"glsl(
-#version 330 core
-layout (location = 0) in vec3 aPos;
-uniform mat4 mvp;
-void main() {
-    gl_Position = mvp * vec4(aPos, 1.0);
-}
-)glsl";
-
-const char* fragmentShaderSource = R"glsl(
-#version 330 core
-out vec4 FragColor;
-uniform vec3 color;
-void main() {
-    FragColor = vec4(color, 1.0);
-}
-)glsl";
+#include "async_mesh_loader.h"
+#include "batch_renderer.h"
+#include "benchmark.h"
+#include "camera.h"
+#include "frame_pacer.h"
+#include "frame_profiler.h"
+#include "gpu_culler.h"
+#include "metrics.h"
+#include "mesh_asset.h"
+#include "options.h"
+#include "offscreen_target.h"
+#include "page_residency.h"
+#include "program_cache.h"
+#include "scene.h"
+#include "scene_shaders.h"
+#include "shader_program.h"
+#include "software_renderer.h"
+#include "staging_ring.h"
+#include "uniform_ring.h"
+
+// What the window callbacks reach through the window's user pointer.
+struct WindowState {
+    Camera* camera = nullptr;
+    // Set by any event that needs a frame drawn; on-demand rendering
+    // sleeps until it is.
+    bool redraw = true;
+};
 
-const char* outlineFragmentShader = R"glsl(
-#version 330 core
-out vec4 FragColor;
-void main() {
-    FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+void onFramebufferResize(GLFWwindow* window, int width, int height) {
+    glViewport(0, 0, width, height);
+    WindowState* state = static_cast<WindowState*>(glfwGetWindowUserPointer(window));
+    state->camera->setViewport(width, height);
+    state->redraw = true;
 }
-)glsl";
 
-struct Mesh {
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<unsigned int> edgeIndices;
-    glm::vec3 color;
-};
-
-Mesh loadOBJ(const char* path) {
-    Mesh mesh;
-    std::ifstream file(path);
-    std::string line;
-    std::set<std::pair<unsigned int, unsigned int>> edges;
-
-    while (std::getline(file, line)) {
-        if (line.substr(0, 2) == "v ") {
-            std::istringstream ss(line.substr(2));
-            float x, y, z;
-            ss >> x >> y >> z;
-            mesh.vertices.insert(mesh.vertices.end(), { x, y, z });
-        }
-        else if (line.substr(0, 2) == "f ") {
-            std::istringstream ss(line.substr(2));
-            std::string token;
-            std::vector<unsigned int> face;
-
-            while (ss >> token) {
-                size_t pos = token.find('/');
-                if (pos != std::string::npos) {
-                    token = token.substr(0, pos);
-                }
-                face.push_back(std::stoul(token) - 1);
-            }
+void onKey(GLFWwindow* window, int, int, int, int) {
+    static_cast<WindowState*>(glfwGetWindowUserPointer(window))->redraw = true;
+}
 
-            if (face.size() >= 3) {
-                mesh.indices.insert(mesh.indices.end(), { face[0], face[1], face[2] });
-            }
+void onWindowRefresh(GLFWwindow* window) {
+    static_cast<WindowState*>(glfwGetWindowUserPointer(window))->redraw = true;
+}
 
-            for (size_t i = 0; i < face.size(); i++) {
-                unsigned int a = face[i];
-                unsigned int b = face[(i + 1) % face.size()];
-                if (a > b) std::swap(a, b);
-                edges.insert({ a, b });
-            }
-        }
-    }
+int main(int argc, char** argv) {
+    AppOptions options;
+    if (!parseOptions(argc, argv, options))
+        return -1;
 
-    for (auto& edge : edges) {
-        mesh.edgeIndices.push_back(edge.first);
-        mesh.edgeIndices.push_back(edge.second);
+    // The CPU backend needs no window or GL context.
+    if (options.batchList && options.batchSoftware)
+        return runSoftwareBatch(options);
+    if (options.softwareOutput && !options.batchList)
+        return runSoftwareRenderer(options);
+
+    // Out-of-core meshes are culled per page on the CPU and their pages
+    // carry no single-pass edge masks.
+    bool paged = options.residencyBytes > 0;
+    if (paged && (options.cullMode == CullMode::Gpu || options.occlusion)) {
+        std::cerr << "Paged meshes are culled on the CPU; --cull gpu and --occlusion ignored" << std::endl;
+        options.cullMode = CullMode::Cpu;
+        options.occlusion = false;
     }
-
-    mesh.color = glm::vec3(0.0f, 0.0f, 1.0f);
-    return mesh;
-}
-
-unsigned int compileShader(unsigned int type, const char* source) {
-    unsigned int id = glCreateShader(type);
-    glShaderSource(id, 1, &source, nullptr);
-    glCompileShader(id);
-
-    int success;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(id, 512, nullptr, infoLog);
-        std::cerr << "Shader error:\n" << infoLog << std::endl;
+    if (paged && options.outlineMode == OutlineMode::SinglePass) {
+        std::cerr << "Paged meshes have no single-pass outline; using two-pass" << std::endl;
+        options.outlineMode = OutlineMode::TwoPass;
     }
-    return id;
-}
-
-unsigned int createShaderProgram(const char* vertexSource, const char* fragmentSource) {
-    unsigned int program = glCreateProgram();
-    unsigned int vs = compileShader(GL_VERTEX_SHADER, vertexSource);
-    unsigned int fs = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-
-    glAttachShader(program, vs);
-    glAttachShader(program, fs);
-    glLinkProgram(program);
-
-    int success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(program, 512, nullptr, infoLog);
-        std::cerr << "Program linking error:\n" << infoLog << std::endl;
+    if (paged && options.quantizePositions) {
+        std::cerr << "Page files keep float positions; --quantize ignored" << std::endl;
+        options.quantizePositions = false;
     }
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-
-    return program;
-}
+    // Benchmarks and batches render offscreen from a hidden window and
+    // never present, so vsync cannot pace them.
+    bool benchmark = options.benchmarkFrames > 0;
+    bool batch = options.batchList != nullptr;
 
-int main() {
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return -1;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // GPU culling needs compute shaders; ask for 4.3 and settle for 3.3.
+    GLFWwindow* window = nullptr;
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Dual Axis Rotation", nullptr, nullptr);
+    if (benchmark || batch)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    if (options.cullMode == CullMode::Gpu) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(800, 600, "Dual Axis Rotation", nullptr, nullptr);
+    }
+    if (!window) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(800, 600, "Dual Axis Rotation", nullptr, nullptr);
+    }
     if (!window) {
         std::cerr << "Failed to create window" << std::endl;
         glfwTerminate();
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(!benchmark && !batch && options.pacing == PacingMode::Vsync ? 1 : 0);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         std::cerr << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
 
-    Mesh mesh = loadOBJ("prism.obj");
+    ProgramCache programCache;
+    programCache.open(options.shaderCacheDir);
 
-    unsigned int VAO, VBO, EBO, edgeEBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    glGenBuffers(1, &edgeEBO);
+    if (batch) {
+        ScenePrograms programs;
+        linkScenePrograms(options, &programCache, programs);
+        int result = runBatchRenderer(options, programs);
+        destroyScenePrograms(programs);
+        glfwTerminate();
+        return result;
+    }
 
-    glBindVertexArray(VAO);
+    bool needEdges = options.outlineMode != OutlineMode::Off;
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+    // Files are mapped or parsed on a background thread; shaders compile
+    // meanwhile and the window keeps presenting frames until they are in.
+    AsyncMeshLoader loader;
+    loader.start(options.meshPaths, needEdges, options.quantizePositions, paged);
+    double loadStartTime = glfwGetTime();
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+    ScenePrograms programs;
+    linkScenePrograms(options, &programCache, programs);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.edgeIndices.size() * sizeof(unsigned int), mesh.edgeIndices.data(), GL_STATIC_DRAW);
+    size_t titleLoaded = size_t(-1);
+    while (!loader.finished() && !glfwWindowShouldClose(window)) {
+        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+            glfwSetWindowShouldClose(window, true);
+        if (loader.loadedCount() != titleLoaded) {
+            titleLoaded = loader.loadedCount();
+            std::string title = "Dual Axis Rotation - loading " + std::to_string(titleLoaded) + "/"
+                + std::to_string(loader.meshCount());
+            glfwSetWindowTitle(window, title.c_str());
+        }
+        if (!benchmark) {
+            glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glfwSwapBuffers(window);
+        }
+        glfwWaitEventsTimeout(benchmark ? 0.001 : 1.0 / 60.0);
+    }
+    if (!loader.finished() || loader.failedMesh() >= 0) {
+        loader.cancel();
+        if (loader.failedMesh() >= 0)
+            std::cerr << "Failed to load mesh: " << options.meshPaths[loader.failedMesh()] << std::endl;
+        glfwTerminate();
+        return loader.failedMesh() >= 0 ? -1 : 0;
+    }
+    glfwSetWindowTitle(window, "Dual Axis Rotation");
+    double meshLoadMs = (glfwGetTime() - loadStartTime) * 1000.0;
+    std::cout << "Loaded " << loader.meshCount() << " meshes in " << meshLoadMs << " ms while rendering" << std::endl;
+
+    // Load time runs until the geometry is resident on the GPU.
+    BenchmarkResults benchmarkResults;
+    benchmarkResults.width = options.benchmarkWidth;
+    benchmarkResults.height = options.benchmarkHeight;
+    benchmarkResults.path = options.cameraPath;
+    benchmarkResults.loadMs = (glfwGetTime() - loadStartTime) * 1000.0;
+
+    // Assets stay loaded for the lifetime of the window: geometry streams
+    // from them and the single-pass wireframe builds its edge masks from
+    // them on first use. Paged assets hold no view, so their meshes take
+    // no pool space.
+    std::vector<MeshAsset>& assets = loader.assets();
+    size_t vertexTotal = 0, indexTotal = 0, edgeIndexTotal = 0;
+    bool shortIndices = true;
+    for (size_t i = 0; i < assets.size(); i++) {
+        vertexTotal += assets[i].view.vertexCount;
+        indexTotal += assets[i].view.indexCount;
+        edgeIndexTotal += assets[i].view.edgeIndexCount;
+        shortIndices = shortIndices && assets[i].view.vertexCount < maxShortIndexVertices;
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // Every mesh is packed into one pool; indices are relative to each
+    // mesh's base vertex, so 16 bits suffice whenever each mesh fits. The
+    // pool only allocates here: the data is copied in over the first
+    // frames, at most --upload-budget bytes each.
+    Scene scene;
+    scene.pool.create(vertexTotal, indexTotal, edgeIndexTotal, shortIndices, options.quantizePositions);
+    scene.meshes.resize(assets.size());
+    for (size_t i = 0; i < assets.size(); i++) {
+        if (paged)
+            scene.meshes[i] = pagedMeshInfo(assets[i].pages);
+        else
+            scene.pool.addStreamed(assets[i].view, scene.meshes[i]);
+    }
+    addInstanceGrid(scene, options.copies);
+    uploadSceneInstances(scene, options.indirect);
+    std::cout << "Scene: " << scene.meshes.size() << " meshes, " << scene.instances.size() << " instances, "
+              << scene.batches.size() << " batches, " << (scene.pool.memoryBytes() >> 10) << " KB pool, "
+              << (scene.indirect ? "one multi-draw indirect call per pass" : "one instanced draw per batch and pass")
+              << std::endl;
+
+    StagingRing stagingRing;
+    if (!stagingRing.create(options.uploadBudget)) {
+        glfwTerminate();
+        return -1;
+    }
 
-    unsigned int mainShader = createShaderProgram(vertexShaderSource, fragmentShaderSource);
-    unsigned int outlineShader = createShaderProgram(vertexShaderSource, outlineFragmentShader);
+    PageResidency residency;
+    if (paged) {
+        std::vector<const MeshPageFile*> pageFiles;
+        for (const MeshAsset& asset : assets)
+            pageFiles.push_back(&asset.pages);
+        residency.create(pageFiles, options.residencyBytes);
+        std::cout << "Page residency: " << residency.stats().slots << " slots in "
+                  << (residency.stats().memoryBytes >> 20) << " MB" << std::endl;
+    }
+    size_t streamedBytes = 0;
+    int streamFrames = 0;
+    double streamStartTime = glfwGetTime();
+    double streamMs = 0.0;
+
+    SceneFraming framing = frameScene(scene);
+    glm::vec3 eye = framing.eye;
+    glm::vec3 target = framing.target;
+
+    Camera camera;
+    camera.setPerspective(framing.fovY, framing.nearPlane, framing.farPlane);
+    camera.lookAt(
+        eye,                 // Camera position
+        target,              // Look at scene centre
+        glm::vec3(0, 1, 0)   // Up vector
+    );
+
+    // The window may have been resized while loading, before the callback existed
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    glViewport(0, 0, framebufferWidth, framebufferHeight);
+    camera.setViewport(framebufferWidth, framebufferHeight);
+    WindowState windowState;
+    windowState.camera = &camera;
+    glfwSetWindowUserPointer(window, &windowState);
+    glfwSetFramebufferSizeCallback(window, onFramebufferResize);
+    glfwSetKeyCallback(window, onKey);
+    glfwSetWindowRefreshCallback(window, onWindowRefresh);
+
+    OffscreenTarget offscreen;
+    if (benchmark) {
+        if (!offscreen.create(options.benchmarkWidth, options.benchmarkHeight)) {
+            glfwTerminate();
+            return -1;
+        }
+        glfwSetFramebufferSizeCallback(window, nullptr);
+        camera.setViewport(options.benchmarkWidth, options.benchmarkHeight);
+    }
+
+    // Per-frame camera data and the shared assembly rotation, one buffer
+    // write per frame
+    UniformRing uniformRing;
+    if (!uniformRing.create(1)) {
+        glfwTerminate();
+        return -1;
+    }
+
+    CullMode cullMode = options.cullMode;
+    DrawListStats drawStats;
+    drawStats.cull.visible = scene.instances.size();
+    drawStats.lodInstances[0] = scene.instances.size();
+    GpuCuller gpuCuller;
+    if (cullMode == CullMode::Gpu && !gpuCuller.create(scene)) {
+        std::cerr << "Falling back to CPU culling" << std::endl;
+        cullMode = CullMode::Cpu;
+    }
+
+    // Occlusion culling tests on the GPU, so it rides on the GPU culler
+    bool occlusion = options.occlusion;
+    HiZBuffer hiZ;
+    if (occlusion && cullMode != CullMode::Gpu) {
+        std::cerr << "Occlusion culling needs --cull gpu; disabled" << std::endl;
+        occlusion = false;
+    }
+    if (occlusion && hiZ.create()) {
+        selectOccluders(scene, options.occluders);
+        std::cout << "Occlusion culling with " << options.occluders << " largest instances as occluders" << std::endl;
+    }
+    else {
+        occlusion = false;
+    }
+
+    OutlineMode outlineMode = options.outlineMode;
+    bool outlineKeyDown = false;
+
+    // CPU time per loop phase and GPU time per pass, averaged per second
+    // to compare modes and graphed by the overlay.
+    FrameProfiler profiler;
+    profiler.create(options.profilePath != nullptr || benchmark);
+    bool profileOverlay = options.profileOverlay;
+    bool profileKeyDown = false;
+    double passReportTime = glfwGetTime();
+
+    // Live counters for unattended viewers; nothing below gathers them
+    // unless enabled.
+    Metrics metrics;
+    if (options.metricsPath) {
+        metrics.create(options.metricsPath, options.metricsInterval);
+        profiler.setMetrics(&metrics);
+    }
+    size_t fullTriangles = sceneTriangleCount(scene);
+    uint64_t drawListUploadBytes = 0;
 
     glEnable(GL_DEPTH_TEST);
 
@@ -183,17 +323,78 @@ int main() {
     float angleY = 0.0f;  // Y-axis rotation
     float angleZ = 0.0f;  // Z-axis rotation
     float rotationSpeed = 2.0f;
-    float lastFrameTime = 0.0f;
+
+    // Instances spun by --animate, and where they started
+    size_t animatedCount = std::min(options.animatedInstances, scene.instances.size());
+    std::vector<glm::mat4> animationBase(animatedCount);
+    for (size_t i = 0; i < animatedCount; i++)
+        animationBase[i] = scene.instances[i].transform;
+    float animationAngle = 0.0f;
+
+    // Angles the current model matrix was built from; NaN forces the first build.
+    float modelAngleY = std::nanf("");
+    float modelAngleZ = std::nanf("");
+    glm::mat4 model = glm::mat4(1.0f);
+
+    // Benchmark frames are counted from the first with all geometry
+    // resident; the first few hold the starting pose to settle caches and
+    // drivers, the rest follow the path and are timed start to start.
+    const size_t benchmarkWarmupFrames = 10;
+    size_t benchmarkFrame = 0;
+    uint64_t benchmarkFirstProfiled = 0;
+    double benchmarkFrameStart = 0.0;
+
+    // Benchmarks run flat out and draw every frame.
+    PacingMode pacing = benchmark ? PacingMode::Uncapped : options.pacing;
+    FramePacer pacer;
+    pacer.create(pacing, options.frameRate);
+    bool onDemand = options.onDemand && !benchmark;
+    bool animating = true;
+    if (!benchmark) {
+        std::cout << "Frame pacing: " << pacingModeName(pacing);
+        if (pacing == PacingMode::Capped)
+            std::cout << " at " << options.frameRate << " fps";
+        std::cout << (onDemand ? ", on demand" : "") << std::endl;
+    }
 
     while (!glfwWindowShouldClose(window)) {
-        float currentFrame = glfwGetTime();
-        float deltaTime = currentFrame - lastFrameTime;
-        lastFrameTime = currentFrame;
+        // An idle on-demand window sleeps until an event asks for a frame;
+        // events that do not, like mouse motion, go back to sleep.
+        if (onDemand && !animating && !windowState.redraw) {
+            glfwWaitEvents();
+            if (!windowState.redraw)
+                continue;
+            pacer.resume();
+        }
+        windowState.redraw = false;
+        // Capped frames sleep here, before input is read, so what they
+        // draw is as recent as the schedule allows.
+        pacer.wait();
+
+        if (benchmark) {
+            double now = glfwGetTime();
+            if (benchmarkFrame > benchmarkWarmupFrames)
+                benchmarkResults.frameMs.push_back((now - benchmarkFrameStart) * 1000.0);
+            benchmarkFrameStart = now;
+            if (benchmarkResults.frameMs.size() == options.benchmarkFrames)
+                break;
+        }
+
+        profiler.beginFrame();
+        glfwPollEvents();
+
+        double currentFrame = glfwGetTime();
+        float deltaTime = static_cast<float>(pacer.beginFrame());
 
         // Input handling
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(window, true);
 
+        // Held rotation keys keep an on-demand window drawing
+        bool rotating = false;
+        for (int key : { GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_W, GLFW_KEY_S })
+            rotating = rotating || glfwGetKey(window, key) == GLFW_PRESS;
+
         // Y-axis controls (A/D)
         if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
             angleY += rotationSpeed * deltaTime;  // Clockwise
@@ -206,50 +407,306 @@ int main() {
         if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
             angleZ -= rotationSpeed * deltaTime;  // Counter-clockwise
 
+        // Outline mode (O cycles two-pass -> single-pass -> off)
+        bool outlineKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+        if (outlineKey && !outlineKeyDown) {
+            outlineMode = outlineMode == OutlineMode::TwoPass ? (paged ? OutlineMode::Off : OutlineMode::SinglePass)
+                        : outlineMode == OutlineMode::SinglePass ? OutlineMode::Off
+                        : OutlineMode::TwoPass;
+            std::cout << "Outline mode: " << outlineModeName(outlineMode) << std::endl;
+            size_t discarded = 0;
+            profiler.takeAverage(discarded);
+        }
+        outlineKeyDown = outlineKey;
+
+        // Profiler overlay (P toggles)
+        bool profileKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+        if (profileKey && !profileKeyDown)
+            profileOverlay = !profileOverlay;
+        profileKeyDown = profileKey;
+
+        profiler.beginPhase(CpuPhase::Update);
+
+        // Geometry streams in under the upload budget; the scene is drawn
+        // from the first frame it is all resident.
+        bool geometryReady = !scene.pool.uploadsPending();
+        bool geometryArrived = false;
+        if (!geometryReady) {
+            streamedBytes += scene.pool.streamUploads(stagingRing);
+            streamFrames++;
+            geometryReady = geometryArrived = !scene.pool.uploadsPending();
+            if (geometryArrived) {
+                benchmarkResults.loadMs = (glfwGetTime() - loadStartTime) * 1000.0;
+                streamMs = (glfwGetTime() - streamStartTime) * 1000.0;
+                std::cout << "Uploaded " << (streamedBytes >> 10) << " KB of geometry over " << streamFrames
+                          << " frames in " << streamMs << " ms ("
+                          << (stagingRing.persistent() ? "persistent" : "mapped") << " staging)" << std::endl;
+            }
+        }
+
+        if (geometryReady && outlineMode == OutlineMode::SinglePass) {
+            for (size_t i = 0; i < scene.meshes.size(); i++) {
+                if (!scene.meshes[i].edgeMaskReady)
+                    scene.pool.uploadEdgeMask(scene.meshes[i], assets[i].view);
+            }
+        }
+
+        if (benchmark && geometryReady) {
+            size_t pathFrame = benchmarkFrame > benchmarkWarmupFrames ? benchmarkFrame - benchmarkWarmupFrames : 0;
+            if (benchmarkFrame == benchmarkWarmupFrames)
+                benchmarkFirstProfiled = profiler.frameNumber();
+            CameraPose pose = cameraPathPose(options.cameraPath, pathFrame, options.benchmarkFrames, eye, target);
+            angleY = pose.angleY;
+            angleZ = pose.angleZ;
+            camera.lookAt(pose.eye, target, glm::vec3(0, 1, 0));
+            animationAngle = 6.2831853f * static_cast<float>(pathFrame) / static_cast<float>(options.benchmarkFrames);
+        }
+        else {
+            animationAngle += rotationSpeed * deltaTime;
+        }
+
+        // Animated instances turn about the centre of their mesh's box
+        if (geometryReady) {
+            for (size_t i = 0; i < animatedCount; i++) {
+                const GpuMesh& mesh = scene.meshes[scene.instances[i].mesh];
+                glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+                glm::mat4 spin = glm::translate(glm::mat4(1.0f), center);
+                spin = glm::rotate(spin, animationAngle, glm::vec3(0.0f, 1.0f, 0.0f));
+                spin = glm::translate(spin, -center);
+                setInstanceTransform(scene, i, animationBase[i] * spin);
+            }
+        }
+
+        // Instances moved on their own are refreshed in place; a draw list
+        // in use is rebuilt with them below, uploading only what changed.
+        bool instancesMoved = flushInstanceTransforms(scene);
+        if (instancesMoved && cullMode == CullMode::Gpu)
+            gpuCuller.updateInstances(scene);
+
+        if (benchmark)
+            offscreen.bind();
         glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Create transformation matrices
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-        glm::mat4 view = glm::lookAt(
-            glm::vec3(3, 3, 3),  // Camera position
-            glm::vec3(0, 0, 0),  // Look at origin
-            glm::vec3(0, 1, 0)   // Up vector
-        );
-
-        // Create combined rotation matrix
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::rotate(model, angleY, glm::vec3(0.0f, 1.0f, 0.0f));  // Y-axis
-        model = glm::rotate(model, angleZ, glm::vec3(0.0f, 0.0f, 1.0f));  // Z-axis
-
-        glm::mat4 mvp = projection * view * model;
-
-        // Draw main prism
-        glUseProgram(mainShader);
-        glUniformMatrix4fv(glGetUniformLocation(mainShader, "mvp"), 1, GL_FALSE, glm::value_ptr(mvp));
-        glUniform3fv(glGetUniformLocation(mainShader, "color"), 1, &mesh.color[0]);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
-
-        // Draw outline
-        glUseProgram(outlineShader);
-        glUniformMatrix4fv(glGetUniformLocation(outlineShader, "mvp"), 1, GL_FALSE, glm::value_ptr(mvp));
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeEBO);
-        glLineWidth(3.0f);
-        glDrawElements(GL_LINES, mesh.edgeIndices.size(), GL_UNSIGNED_INT, 0);
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // Matrices are only rebuilt when the viewport or rotation changed;
+        // the draw list is also rebuilt once geometry has arrived, as view
+        // changes during streaming were not culled for, and when instances
+        // moved.
+        bool viewChanged = camera.update() || geometryArrived || instancesMoved;
+
+        if (angleY != modelAngleY || angleZ != modelAngleZ) {
+            // Create combined rotation matrix
+            model = glm::mat4(1.0f);
+            model = glm::rotate(model, angleY, glm::vec3(0.0f, 1.0f, 0.0f));  // Y-axis
+            model = glm::rotate(model, angleZ, glm::vec3(0.0f, 0.0f, 1.0f));  // Z-axis
+            modelAngleY = angleY;
+            modelAngleZ = angleZ;
+            viewChanged = true;
+        }
+
+        if (uniformRing.beginFrame()) {
+            FrameUniforms& frameUniforms = uniformRing.frame();
+            frameUniforms.viewProjection = camera.viewProjection();
+            frameUniforms.viewport = glm::vec4(camera.viewportWidth(), camera.viewportHeight(),
+                                               camera.viewportWidth() * 0.5f, camera.viewportHeight() * 0.5f);
+            ObjectUniforms& objectUniforms = uniformRing.object(0);
+            objectUniforms.model = model;
+            objectUniforms.color = glm::vec4(1.0f);
+        }
+        uniformRing.finishWrites();
+        uniformRing.bindObject(0);
+
+        // The visible set and LODs only change with the matrices; they are
+        // rebuilt after the uniforms so occluders draw with this frame's
+        // camera. Culling and LOD selection work in instance space, where
+        // the eye sits at the inverse of the assembly rotation. Paged
+        // meshes also pick the pages to stream from the same view.
+        if (geometryReady && viewChanged && (cullMode != CullMode::Off || options.lodError > 0.0f || paged)) {
+            DrawListView drawView;
+            drawView.viewProjection = camera.viewProjection() * model;
+            drawView.frustumCull = cullMode != CullMode::Off;
+            drawView.eye = glm::vec3(glm::inverse(model) * glm::vec4(camera.eye(), 1.0f));
+            drawView.pixelsPerUnit = camera.projection()[1][1] * camera.viewportHeight() * 0.5f;
+            drawView.maxPixelError = options.lodError;
+            if (cullMode == CullMode::Gpu && occlusion) {
+                // Depth of the largest instances, reduced to a pyramid the
+                // cull shader tests every instance's box against
+                profiler.beginPass(GpuPass::Cull);
+                hiZ.beginOccluderPass(camera.viewportWidth(), camera.viewportHeight());
+                bindScenePipeline<0>(scene, programs, options.lineWidth);
+                drawOccluders(scene);
+                hiZ.buildPyramid(camera.viewportWidth(), camera.viewportHeight(), offscreen.framebuffer());
+                gpuCuller.cull(scene, drawView, &hiZ);
+                profiler.endPass();
+            }
+            else if (cullMode == CullMode::Gpu) {
+                profiler.beginPass(GpuPass::Cull);
+                gpuCuller.cull(scene, drawView);
+                profiler.endPass();
+            }
+            else {
+                buildDrawList(scene, drawView, drawStats);
+                drawListUploadBytes += drawStats.uploadBytes;
+            }
+            if (paged)
+                residency.selectPages(scene, drawView);
+        }
+        if (paged)
+            residency.update(stagingRing);
+
+        profiler.beginPhase(CpuPhase::Submit);
+
+        // All meshes come from the pool, so each pass is one multi-draw
+        // (or one instanced draw per batch without indirect support)
+        size_t drawCalls = 0;
+        if (!geometryReady) {
+            // Nothing to draw until the pool holds every mesh
+        }
+        else if (paged) {
+            // Resident pages only; the rest appear as they stream in
+            profiler.beginPass(GpuPass::Fill);
+            bindScenePipeline<0>(scene, programs, options.lineWidth);
+            drawCalls += residency.draw(scene, ScenePipeline<0>::pass);
+            profiler.endPass();
+            if (outlineMode == OutlineMode::TwoPass) {
+                profiler.beginPass(GpuPass::Outline);
+                bindScenePipeline<sceneShaderOutline>(scene, programs, options.lineWidth);
+                drawCalls += residency.draw(scene, ScenePipeline<sceneShaderOutline>::pass);
+                profiler.endPass();
+            }
+        }
+        else if (outlineMode == OutlineMode::SinglePass) {
+            // Fill and outline in one draw
+            profiler.beginPass(GpuPass::Fill);
+            drawCalls += drawScenePipeline<sceneShaderWireframe>(scene, programs, options.lineWidth);
+            profiler.endPass();
+        }
+        else {
+            // Draw main meshes
+            profiler.beginPass(GpuPass::Fill);
+            drawCalls += drawScenePipeline<0>(scene, programs, options.lineWidth);
+            profiler.endPass();
+
+            // Draw outline
+            if (outlineMode == OutlineMode::TwoPass) {
+                profiler.beginPass(GpuPass::Outline);
+                drawCalls += drawScenePipeline<sceneShaderOutline>(scene, programs, options.lineWidth);
+                profiler.endPass();
+            }
+        }
+
+        // The overlay reads this frame's Frame block, so it draws before
+        // the segment is fenced.
+        if (profileOverlay)
+            profiler.drawOverlay();
+        uniformRing.endFrame();
+
+        if (currentFrame - passReportTime >= 1.0) {
+            size_t profiledFrames = 0;
+            FrameTimings average = profiler.takeAverage(profiledFrames);
+            double gpuMs = 0.0;
+            for (double ms : average.gpuMs)
+                gpuMs += ms;
+            std::cout << outlineModeName(outlineMode) << " outline: " << gpuMs << " ms GPU per frame (";
+            for (size_t pass = 0; pass < gpuPassCount; pass++)
+                std::cout << (pass ? " " : "") << gpuPassName(static_cast<GpuPass>(pass)) << " " << average.gpuMs[pass];
+            std::cout << "), CPU";
+            for (size_t phase = 0; phase < cpuPhaseCount; phase++)
+                std::cout << " " << cpuPhaseName(static_cast<CpuPhase>(phase)) << " " << average.cpuMs[phase];
+            std::cout << " ms, " << drawCalls << " draw calls";
+            if (cullMode == CullMode::Gpu) {
+                std::cout << ", culled on the GPU" << (occlusion ? " with Hi-Z occlusion" : "");
+            }
+            else {
+                std::cout << ", " << drawStats.cull.visible << " visible / " << drawStats.cull.culled << " culled ("
+                          << drawStats.cull.nodesTested << " BVH nodes tested, " << drawStats.milliseconds
+                          << " ms), LOD instances";
+                for (size_t lod = 0; lod < maxLodCount; lod++)
+                    std::cout << (lod ? "/" : " ") << drawStats.lodInstances[lod];
+                std::cout << ", " << drawStats.triangles << " triangles, " << drawStats.uploadBytes
+                          << " bytes uploaded by the last rebuild";
+            }
+            if (paged) {
+                const PageResidencyStats& pages = residency.stats();
+                std::cout << ", pages " << pages.residentNeeded << "/" << pages.neededPages << " resident ("
+                          << pages.loads << " loads, " << pages.evictions << " evictions, "
+                          << (pages.bytesStreamed >> 20) << " MB streamed)";
+            }
+            std::cout << std::endl;
+            passReportTime = currentFrame;
+        }
+
+        // Whether drawStats describes what this frame drew
+        bool cpuDrawList = cullMode != CullMode::Gpu
+            && (cullMode != CullMode::Off || options.lodError > 0.0f || paged);
+        if (benchmark && geometryReady) {
+            if (benchmarkFrame >= benchmarkWarmupFrames) {
+                if (!cpuDrawList)
+                    benchmarkResults.trianglesCulled = false;
+                benchmarkResults.triangles += cpuDrawList ? drawStats.triangles : fullTriangles;
+            }
+            benchmarkFrame++;
+        }
+
+        if (metrics.enabled()) {
+            MetricsCounters counters;
+            counters.drawCalls = drawCalls;
+            if (cullMode != CullMode::Gpu && geometryReady) {
+                size_t submitted = cpuDrawList ? drawStats.triangles : fullTriangles;
+                counters.trianglesSubmitted = static_cast<long long>(submitted);
+                counters.trianglesCulled = static_cast<long long>(fullTriangles - std::min(submitted, fullTriangles));
+                counters.instancesVisible = static_cast<long long>(cpuDrawList ? drawStats.cull.visible
+                                                                                : scene.instances.size());
+                counters.instancesCulled = static_cast<long long>(cpuDrawList ? drawStats.cull.culled : 0);
+            }
+            counters.geometryBytes = scene.pool.memoryBytes();
+            counters.instanceBytes = scene.instanceCapacity * sizeof(InstanceData);
+            counters.stagingBytes = stagingRing.segmentSize() * StagingRing::segmentCount;
+            counters.pageBytes = paged ? residency.stats().memoryBytes : 0;
+            counters.uploadBytes = streamedBytes + drawListUploadBytes + (paged ? residency.stats().bytesStreamed : 0);
+            counters.loadMs = meshLoadMs;
+            counters.uploadMs = streamMs;
+            metrics.endFrame(profiler.frameNumber(), counters);
+        }
+
+        // Frames with nothing left to arrive or turn are the last until
+        // the next event
+        animating = rotating || instancesMoved || !geometryReady
+            || (paged && residency.stats().residentNeeded < residency.stats().neededPages);
+
+        profiler.beginPhase(CpuPhase::Swap);
+        if (benchmark) {
+            glFlush();
+        }
+        else {
+            glfwSwapBuffers(window);
+            // Waiting for the swap keeps the driver from buffering frames
+            // ahead, each holding input older than the one before it.
+            if (pacing == PacingMode::Vsync)
+                glFinish();
+        }
+        profiler.endFrame();
     }
 
+    if (benchmark) {
+        profiler.finish();
+        printBenchmarkReport(benchmarkResults, profiler.history(), benchmarkFirstProfiled);
+    }
+
+    if (options.profilePath)
+        profiler.writeFile(options.profilePath);
+
     // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteBuffers(1, &edgeEBO);
-    glDeleteProgram(mainShader);
-    glDeleteProgram(outlineShader);
+    residency.destroy();
+    offscreen.destroy();
+    hiZ.destroy();
+    gpuCuller.destroy();
+    destroyScene(scene);
+    stagingRing.destroy();
+    uniformRing.destroy();
+    destroyScenePrograms(programs);
+    metrics.destroy();
+    profiler.destroy();
 
     glfwTerminate();
     return 0;
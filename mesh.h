@@ -0,0 +1,90 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Most levels of detail a mesh carries, the full-resolution one included.
+const size_t maxLodCount = 4;
+
+// One level of detail: ranges of the mesh's indices and edge indices. All
+// levels share the vertex array. Stored as-is in the mesh cache.
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstEdgeIndex;
+    uint32_t edgeIndexCount;
+    // Bound on how far the simplified surface strays from the original,
+    // in mesh units; 0 for the full-resolution level.
+    float error;
+};
+
+struct Mesh {
+    std::vector<float> vertices;
+    // Set instead of vertices once quantizeMeshPositions has run: three
+    // 16-bit components per vertex, normalized to the bounds.
+    std::vector<uint16_t> quantizedVertices;
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> edgeIndices;
+    glm::vec3 color;
+    // Axis-aligned bounds of the positions; zero for an empty mesh.
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // Filled by buildMeshLods, finest first. Empty means the indices are a
+    // single full-resolution level.
+    std::vector<MeshLod> lods;
+};
+
+// Non-owning view of mesh arrays, backed either by a Mesh or by a mapped
+// cache file, so both can be uploaded the same way.
+struct MeshView {
+    // Exactly one of vertices and quantizedVertices is set for a mesh with
+    // vertices; see dequantizeTransform for the latter.
+    const float* vertices = nullptr;
+    const uint16_t* quantizedVertices = nullptr;
+    size_t vertexCount = 0;
+    const unsigned int* indices = nullptr;
+    size_t indexCount = 0;
+    const unsigned int* edgeIndices = nullptr;
+    size_t edgeIndexCount = 0;
+    const MeshLod* lods = nullptr;
+    size_t lodCount = 0;
+    glm::vec3 color = glm::vec3(0.0f);
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+inline MeshView viewOf(const Mesh& mesh) {
+    MeshView view;
+    if (mesh.quantizedVertices.empty()) {
+        view.vertices = mesh.vertices.data();
+        view.vertexCount = mesh.vertices.size() / 3;
+    }
+    else {
+        view.quantizedVertices = mesh.quantizedVertices.data();
+        view.vertexCount = mesh.quantizedVertices.size() / 3;
+    }
+    view.indices = mesh.indices.data();
+    view.indexCount = mesh.indices.size();
+    view.edgeIndices = mesh.edgeIndices.data();
+    view.edgeIndexCount = mesh.edgeIndices.size();
+    view.lods = mesh.lods.data();
+    view.lodCount = mesh.lods.size();
+    view.color = mesh.color;
+    view.boundsMin = mesh.boundsMin;
+    view.boundsMax = mesh.boundsMax;
+    return view;
+}
+
+// A view without LODs counts as one full-resolution level.
+inline size_t lodCountOf(const MeshView& view) {
+    return view.lodCount > 0 ? view.lodCount : 1;
+}
+
+// Level lod of the view, lod < lodCountOf(view).
+inline MeshLod lodOf(const MeshView& view, size_t lod) {
+    if (view.lodCount > 0)
+        return view.lods[lod];
+    MeshLod full = { 0, static_cast<uint32_t>(view.indexCount), 0, static_cast<uint32_t>(view.edgeIndexCount), 0.0f };
+    return full;
+}
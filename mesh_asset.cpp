@@ -0,0 +1,88 @@
+#include "mesh_asset.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj_loader.h"
+#include "scratch_arena.h"
+#include "vertex_quantization.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+bool loadMeshAsset(const char* path, bool needEdges, bool quantize, MeshAsset& asset, ScratchArena* scratch) {
+    std::string cachePath = meshCachePath(path);
+
+    auto cacheStart = std::chrono::steady_clock::now();
+    if (asset.cache.open(cachePath.c_str(), path) && (asset.cache.hasEdges() || !needEdges)
+        && asset.cache.quantized() == quantize) {
+        asset.view = asset.cache.view();
+        double cacheMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cacheStart).count();
+        std::cout << "Loaded " << cachePath << ": " << asset.view.vertexCount << " vertices"
+                  << (quantize ? " (16-bit)" : "") << ", " << lodOf(asset.view, 0).indexCount / 3 << " triangles, "
+                  << lodCountOf(asset.view) << " LODs in " << cacheMs << " ms" << std::endl;
+        return asset.view.vertexCount > 0;
+    }
+    asset.cache.close();
+
+    ScratchArena localScratch;
+    if (!scratch)
+        scratch = &localScratch;
+    ObjLoadOptions loadOptions;
+    loadOptions.buildEdges = needEdges;
+    loadOptions.scratch = scratch;
+    ObjLoadStats loadStats;
+    asset.mesh = loadOBJ(path, loadOptions, &loadStats);
+    // A missing or empty OBJ has nothing to optimize or cache
+    if (asset.mesh.vertices.empty())
+        return false;
+    std::cout << "Loaded " << path << ": " << asset.mesh.vertices.size() / 3 << " vertices, "
+              << asset.mesh.indices.size() / 3 << " triangles in " << loadStats.seconds * 1000.0 << " ms ("
+              << loadStats.megabytesPerSecond() << " MB/s, " << loadStats.chunks << " chunks on "
+              << loadStats.threads << " threads)" << std::endl;
+
+    MeshOptimizeStats optimizeStats = optimizeMesh(asset.mesh, scratch);
+    std::cout << "Optimized vertex cache order: ACMR " << optimizeStats.acmrBefore << " -> "
+              << optimizeStats.acmrAfter << " in " << optimizeStats.seconds * 1000.0 << " ms" << std::endl;
+
+    MeshLodStats lodStats = buildMeshLods(asset.mesh, scratch);
+    std::cout << "Built " << lodStats.lodCount << " LODs (";
+    for (size_t lod = 0; lod < lodStats.lodCount; lod++)
+        std::cout << (lod ? ", " : "") << lodStats.triangles[lod] << " triangles";
+    std::cout << ") in " << lodStats.seconds * 1000.0 << " ms" << std::endl;
+
+    ScratchArenaStats scratchStats = scratch->stats();
+    std::cout << "Scratch: " << scratchStats.allocations << " allocations, "
+              << scratchStats.bytes / (1024.0 * 1024.0) << " MB in " << scratchStats.blockAllocations
+              << " heap blocks" << std::endl;
+
+    if (quantize && !asset.mesh.vertices.empty()) {
+        float error = quantizeMeshPositions(asset.mesh);
+        std::cout << "Quantized positions to 16 bits, at most " << error << " units off" << std::endl;
+    }
+
+    asset.view = viewOf(asset.mesh);
+    if (asset.view.vertexCount > 0 && !writeMeshCache(cachePath.c_str(), path, asset.mesh, needEdges))
+        std::cerr << "Failed to write mesh cache: " << cachePath << std::endl;
+    return asset.view.vertexCount > 0;
+}
+
+bool loadPagedMeshAsset(const char* path, bool needEdges, MeshAsset& asset, ScratchArena* scratch) {
+    std::string pagePath = meshPagePath(path);
+    if (asset.pages.open(pagePath.c_str(), path) && (asset.pages.hasEdges() || !needEdges)) {
+        std::cout << "Mapped " << pagePath << ": " << asset.pages.pageCount() << " pages, "
+                  << asset.pages.header().triangleCount << " triangles" << std::endl;
+        return asset.pages.pageCount() > 0;
+    }
+    asset.pages.close();
+
+    MeshAsset source;
+    if (!loadMeshAsset(path, needEdges, false, source, scratch))
+        return false;
+    MeshPageStats stats;
+    if (!writeMeshPages(pagePath.c_str(), path, source.view, needEdges, &stats)) {
+        std::cerr << "Failed to write mesh pages: " << pagePath << std::endl;
+        return false;
+    }
+    std::cout << "Built " << stats.pageCount << " pages (" << stats.vertexDuplication << "x vertices) in "
+              << stats.seconds * 1000.0 << " ms" << std::endl;
+    return asset.pages.open(pagePath.c_str(), path) && asset.pages.pageCount() > 0;
+}
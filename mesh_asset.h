@@ -0,0 +1,33 @@
+#pragma once
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_pages.h"
+
+class ScratchArena;
+
+// A mesh ready for upload: mapped straight from its binary cache, or parsed,
+// optimized and cached when the cache was missing or stale. view points
+// into whichever of cache or mesh holds the data, so the asset must stay
+// alive (and unmoved) while view is used.
+struct MeshAsset {
+    MeshCache cache;
+    Mesh mesh;
+    MeshView view;
+    // Set instead of view for meshes drawn out of core.
+    MeshPageFile pages;
+};
+
+// Loads path into asset, printing load statistics. needEdges rejects
+// caches built without outline edges; quantize selects 16-bit positions
+// (view.quantizedVertices) over floats, and a cache in the other format
+// is rebuilt. Parsing, optimizing and building LODs take their working
+// memory from scratch, which the caller resets once the call returns;
+// without one a local arena is used. Returns false if the mesh is empty.
+bool loadMeshAsset(const char* path, bool needEdges, bool quantize, MeshAsset& asset,
+                   ScratchArena* scratch = nullptr);
+
+// Maps the page file of path into asset.pages, building it from the mesh
+// (loaded as by loadMeshAsset with float positions, then released) when
+// it is missing or stale.
+// Returns false if the mesh is empty or the pages cannot be written.
+bool loadPagedMeshAsset(const char* path, bool needEdges, MeshAsset& asset, ScratchArena* scratch = nullptr);
@@ -0,0 +1,204 @@
+#include "mesh_cache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+const char cacheMagic[8] = { 'S', 'R', 'M', 'E', 'S', 'H', '\0', '\0' };
+const uint32_t cacheVersion = 5;
+const uint64_t blobAlignment = 64;
+
+uint64_t fnv1a(const char* data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t alignBlob(uint64_t offset) {
+    return (offset + blobAlignment - 1) & ~(blobAlignment - 1);
+}
+
+bool blobFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize) {
+    return offset % blobAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+uint64_t indexEnd(const std::vector<unsigned int>& indices) {
+    uint64_t end = 0;
+    for (unsigned int index : indices)
+        end = std::max(end, uint64_t(index) + 1);
+    return end;
+}
+
+}
+
+// Size and modification time catch ordinary edits; hashing the head and
+// tail of the file also catches copies that preserved the timestamp.
+bool stampSource(const char* path, SourceStamp& stamp) {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error)
+        return false;
+
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    const size_t sample = 64 * 1024;
+    size_t head = std::min(sample, file.size());
+    size_t tail = std::min(sample, file.size() - head);
+
+    stamp.size = file.size();
+    stamp.time = static_cast<int64_t>(time.time_since_epoch().count());
+    stamp.hash = fnv1a(file.data(), head, 14695981039346656037ull);
+    stamp.hash = fnv1a(file.data() + file.size() - tail, tail, stamp.hash);
+    return true;
+}
+
+bool MeshCache::open(const char* cachePath, const char* sourcePath) {
+    close();
+
+    if (!file_.open(cachePath))
+        return false;
+
+    if (file_.size() < sizeof(MeshCacheHeader)) {
+        close();
+        return false;
+    }
+
+    const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(file_.data());
+    uint64_t size = file_.size();
+    uint64_t vertexSize = (header->flags & meshCacheQuantized) ? 3 * sizeof(uint16_t) : 3 * sizeof(float);
+    bool valid = std::memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) == 0
+        && header->version == cacheVersion
+        && blobFits(header->vertexOffset, header->vertexCount, vertexSize, size)
+        && blobFits(header->indexOffset, header->indexCount, sizeof(unsigned int), size)
+        && blobFits(header->edgeIndexOffset, header->edgeIndexCount, sizeof(unsigned int), size)
+        && blobFits(header->lodOffset, header->lodCount, sizeof(MeshLod), size)
+        && header->lodCount <= maxLodCount
+        && header->indexEnd <= header->vertexCount;
+
+    // Every level must lie inside the index arrays it points into.
+    const MeshLod* lods = reinterpret_cast<const MeshLod*>(file_.data() + (valid ? header->lodOffset : 0));
+    for (uint64_t i = 0; valid && i < header->lodCount; i++) {
+        valid = uint64_t(lods[i].firstIndex) + lods[i].indexCount <= header->indexCount
+            && uint64_t(lods[i].firstEdgeIndex) + lods[i].edgeIndexCount <= header->edgeIndexCount;
+    }
+
+    SourceStamp stamp;
+    valid = valid && stampSource(sourcePath, stamp)
+        && stamp.size == header->sourceSize
+        && stamp.time == header->sourceTime
+        && stamp.hash == header->sourceHash;
+
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    header_ = header;
+    return true;
+}
+
+void MeshCache::close() {
+    file_.close();
+    header_ = nullptr;
+}
+
+MeshView MeshCache::view() const {
+    MeshView view;
+    if (!header_)
+        return view;
+
+    if (quantized())
+        view.quantizedVertices = reinterpret_cast<const uint16_t*>(file_.data() + header_->vertexOffset);
+    else
+        view.vertices = reinterpret_cast<const float*>(file_.data() + header_->vertexOffset);
+    view.vertexCount = static_cast<size_t>(header_->vertexCount);
+    view.indices = reinterpret_cast<const unsigned int*>(file_.data() + header_->indexOffset);
+    view.indexCount = static_cast<size_t>(header_->indexCount);
+    view.edgeIndices = reinterpret_cast<const unsigned int*>(file_.data() + header_->edgeIndexOffset);
+    view.edgeIndexCount = static_cast<size_t>(header_->edgeIndexCount);
+    view.lods = reinterpret_cast<const MeshLod*>(file_.data() + header_->lodOffset);
+    view.lodCount = static_cast<size_t>(header_->lodCount);
+    view.color = glm::vec3(header_->color[0], header_->color[1], header_->color[2]);
+    view.boundsMin = glm::vec3(header_->boundsMin[0], header_->boundsMin[1], header_->boundsMin[2]);
+    view.boundsMax = glm::vec3(header_->boundsMax[0], header_->boundsMax[1], header_->boundsMax[2]);
+    return view;
+}
+
+std::string meshCachePath(const char* sourcePath) {
+    return std::string(sourcePath) + ".srmesh";
+}
+
+bool writeMeshCache(const char* cachePath, const char* sourcePath, const Mesh& mesh, bool hasEdges) {
+    SourceStamp stamp;
+    if (!stampSource(sourcePath, stamp))
+        return false;
+
+    bool quantized = !mesh.quantizedVertices.empty();
+    const void* vertices = quantized ? static_cast<const void*>(mesh.quantizedVertices.data()) : mesh.vertices.data();
+    uint64_t vertexBytes = quantized ? mesh.quantizedVertices.size() * sizeof(uint16_t)
+                                     : mesh.vertices.size() * sizeof(float);
+
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.flags = (hasEdges ? meshCacheHasEdges : 0) | (quantized ? meshCacheQuantized : 0);
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.sourceHash = stamp.hash;
+    header.vertexCount = quantized ? mesh.quantizedVertices.size() / 3 : mesh.vertices.size() / 3;
+    header.indexCount = mesh.indices.size();
+    header.edgeIndexCount = mesh.edgeIndices.size();
+    header.vertexOffset = alignBlob(sizeof(MeshCacheHeader));
+    header.indexOffset = alignBlob(header.vertexOffset + vertexBytes);
+    header.edgeIndexOffset = alignBlob(header.indexOffset + header.indexCount * sizeof(unsigned int));
+    header.lodCount = mesh.lods.size();
+    header.lodOffset = alignBlob(header.edgeIndexOffset + header.edgeIndexCount * sizeof(unsigned int));
+    header.indexEnd = std::max(indexEnd(mesh.indices), indexEnd(mesh.edgeIndices));
+    if (header.indexEnd > header.vertexCount)
+        return false;
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = mesh.boundsMin[i];
+        header.boundsMax[i] = mesh.boundsMax[i];
+        header.color[i] = mesh.color[i];
+    }
+
+    std::string tempPath = temporaryPathFor(cachePath);
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        const char padding[blobAlignment] = {};
+        auto writeBlob = [&](uint64_t offset, const void* data, uint64_t bytes) {
+            out.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(out.tellp())));
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+        };
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeBlob(header.vertexOffset, vertices, vertexBytes);
+        writeBlob(header.indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        writeBlob(header.edgeIndexOffset, mesh.edgeIndices.data(), mesh.edgeIndices.size() * sizeof(unsigned int));
+        writeBlob(header.lodOffset, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+
+        if (!out) {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "mapped_file.h"
+#include "mesh.h"
+#include <cstdint>
+#include <string>
+
+// Binary cache written next to a source OBJ. Layout (little-endian): this
+// header, then the vertex floats (or 16-bit quantized components with
+// meshCacheQuantized), triangle indices, edge indices and the MeshLod
+// table, each starting on a 64-byte boundary at the offsets recorded here.
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+
+    // Identity of the source file the cache was built from.
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t edgeIndexCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t edgeIndexOffset;
+    uint64_t lodCount;
+    uint64_t lodOffset;
+    // One past the largest triangle or edge index, checked against
+    // vertexCount on open without reading the index arrays.
+    uint64_t indexEnd;
+
+    float boundsMin[3];
+    float boundsMax[3];
+    float color[3];
+    uint32_t reserved;
+};
+
+const uint32_t meshCacheHasEdges = 1u << 0;
+const uint32_t meshCacheQuantized = 1u << 1;
+
+// A cache file mapped read-only; view() points straight into the mapping,
+// ready to be passed to glBufferData.
+class MeshCache {
+public:
+    // Maps cachePath and checks it against the current state of sourcePath.
+    // Returns false if the cache is missing, malformed or stale.
+    bool open(const char* cachePath, const char* sourcePath);
+    void close();
+
+    bool hasEdges() const { return header_ && (header_->flags & meshCacheHasEdges); }
+    bool quantized() const { return header_ && (header_->flags & meshCacheQuantized); }
+    MeshView view() const;
+
+private:
+    MappedFile file_;
+    const MeshCacheHeader* header_ = nullptr;
+};
+
+// Identity of a source file, recorded in the files derived from it.
+struct SourceStamp {
+    uint64_t size = 0;
+    int64_t time = 0;
+    uint64_t hash = 0;
+};
+
+// Size, modification time and a hash of the file's head and tail.
+bool stampSource(const char* path, SourceStamp& stamp);
+
+// Cache location for a source file: the same path with ".srmesh" appended.
+std::string meshCachePath(const char* sourcePath);
+
+// Writes the mesh through a temporary file that is renamed into place, so
+// a reader never maps a partially written cache. A quantized mesh is
+// stored quantized; a mesh with indices past its last vertex is refused.
+bool writeMeshCache(const char* cachePath, const char* sourcePath, const Mesh& mesh, bool hasEdges);
@@ -0,0 +1,169 @@
+#include "mesh_optimizer.h"
+#include "edge_builder.h"
+#include <algorithm>
+#include <chrono>
+
+double averageCacheMissRatio(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize,
+                             ScratchArena* scratch) {
+    if (indices.size() < 3)
+        return 0.0;
+
+    // Each vertex remembers when it entered the FIFO; it is still cached
+    // while fewer than cacheSize misses have happened since.
+    ScratchVector<size_t> enteredAt(vertexCount, 0, scratch);
+    size_t misses = 0;
+    for (unsigned int index : indices) {
+        if (enteredAt[index] == 0 || misses - enteredAt[index] >= cacheSize) {
+            misses++;
+            enteredAt[index] = misses;
+        }
+    }
+    return static_cast<double>(misses) / (indices.size() / 3);
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize,
+                         ScratchArena* scratch) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    // Vertex -> triangle adjacency in compressed rows.
+    ScratchVector<unsigned int> liveTriangles(vertexCount, 0, scratch);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        liveTriangles[indices[i]]++;
+
+    ScratchVector<size_t> adjacencyOffset(vertexCount + 1, 0, scratch);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+
+    ScratchVector<unsigned int> adjacency(adjacencyOffset[vertexCount], scratch);
+    ScratchVector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1, scratch);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+    }
+
+    // Every index is emitted exactly once; each triangle's fanning vertex
+    // adds at most its three corners to the dead-end stack.
+    ScratchVector<unsigned int> output(scratch);
+    output.reserve(triangleCount * 3);
+    ScratchVector<size_t> cacheTime(vertexCount, 0, scratch);
+    ScratchVector<unsigned char> emitted(triangleCount, 0, scratch);
+    ScratchVector<unsigned int> deadEnd(scratch);
+    deadEnd.reserve(triangleCount * 3);
+    ScratchVector<unsigned int> candidates(scratch);
+    size_t timeStamp = cacheSize + 1;
+    size_t cursor = 0;
+
+    long long fanning = 0;
+    while (fanning >= 0) {
+        unsigned int f = static_cast<unsigned int>(fanning);
+        candidates.clear();
+
+        // Emit every remaining triangle around the fanning vertex.
+        for (size_t a = adjacencyOffset[f]; a < adjacencyOffset[f + 1]; a++) {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = 1;
+
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (timeStamp - cacheTime[v] > cacheSize)
+                    cacheTime[v] = timeStamp++;
+            }
+        }
+
+        // Prefer the candidate that will still be in the cache after its
+        // remaining triangles are emitted, oldest first.
+        long long best = -1;
+        long long bestPriority = -1;
+        for (unsigned int v : candidates) {
+            if (liveTriangles[v] == 0)
+                continue;
+            long long priority = 0;
+            if (timeStamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = static_cast<long long>(timeStamp - cacheTime[v]);
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        if (best < 0) {
+            // Dead end: back up through recently used vertices, then scan
+            // forward for any vertex with triangles left.
+            while (!deadEnd.empty() && best < 0) {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0)
+                    best = v;
+            }
+            while (best < 0 && cursor < vertexCount) {
+                if (liveTriangles[cursor] > 0)
+                    best = static_cast<long long>(cursor);
+                cursor++;
+            }
+        }
+        fanning = best;
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(Mesh& mesh, ScratchArena* scratch) {
+    size_t vertexCount = mesh.vertices.size() / 3;
+    const unsigned int unassigned = ~0u;
+    ScratchVector<unsigned int> remap(vertexCount, unassigned, scratch);
+
+    unsigned int next = 0;
+    for (unsigned int& index : mesh.indices) {
+        if (remap[index] == unassigned)
+            remap[index] = next++;
+        index = remap[index];
+    }
+    // Vertices only referenced by edges or by nothing keep their relative
+    // order at the end.
+    for (unsigned int& slot : remap) {
+        if (slot == unassigned)
+            slot = next++;
+    }
+
+    // Permuted back into place from a copy, so the mesh keeps its array
+    ScratchVector<float> vertices(mesh.vertices.begin(), mesh.vertices.end(), scratch);
+    for (size_t v = 0; v < vertexCount; v++) {
+        mesh.vertices[remap[v] * 3] = vertices[v * 3];
+        mesh.vertices[remap[v] * 3 + 1] = vertices[v * 3 + 1];
+        mesh.vertices[remap[v] * 3 + 2] = vertices[v * 3 + 2];
+    }
+
+    for (unsigned int& index : mesh.edgeIndices)
+        index = remap[index];
+}
+
+MeshOptimizeStats optimizeMesh(Mesh& mesh, ScratchArena* scratch) {
+    auto startTime = std::chrono::steady_clock::now();
+    size_t vertexCount = mesh.vertices.size() / 3;
+
+    MeshOptimizeStats stats;
+    stats.acmrBefore = averageCacheMissRatio(mesh.indices, vertexCount, 16, scratch);
+
+    optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount, 16, scratch);
+    optimizeVertexFetch(mesh, scratch);
+
+    // Sorted edges touch vertices in roughly the same order as triangles.
+    ScratchVector<uint64_t> keys(scratch);
+    keys.reserve(mesh.edgeIndices.size() / 2);
+    for (size_t i = 0; i + 1 < mesh.edgeIndices.size(); i += 2)
+        keys.push_back(packEdge(mesh.edgeIndices[i], mesh.edgeIndices[i + 1]));
+    sortUniqueEdges(keys);
+    mesh.edgeIndices = edgeIndicesFromKeys(keys);
+
+    stats.acmrAfter = averageCacheMissRatio(mesh.indices, vertexCount, 16, scratch);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return stats;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "mesh.h"
+#include <cstddef>
+#include <vector>
+
+class ScratchArena;
+
+// Vertex count below which indices fit GL_UNSIGNED_SHORT.
+const size_t maxShortIndexVertices = 65536;
+
+struct MeshOptimizeStats {
+    double acmrBefore = 0.0;
+    double acmrAfter = 0.0;
+    double seconds = 0.0;
+};
+
+// Average cache miss ratio: transformed vertices per triangle for a FIFO
+// post-transform cache of the given size. 0.5 is ideal for large grids,
+// 3.0 means no reuse at all.
+double averageCacheMissRatio(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16,
+                             ScratchArena* scratch = nullptr);
+
+// Reorders triangles for the post-transform vertex cache (Tipsify,
+// Sander et al. 2007). Winding of each triangle is preserved.
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16,
+                         ScratchArena* scratch = nullptr);
+
+// Renumbers vertices in first-use order of the triangle list so vertex
+// fetches walk memory forward, remapping triangle and edge indices.
+void optimizeVertexFetch(Mesh& mesh, ScratchArena* scratch = nullptr);
+
+// Runs both passes and sorts the edge list by its new vertex numbers.
+// Working arrays come from scratch when given, the heap otherwise.
+MeshOptimizeStats optimizeMesh(Mesh& mesh, ScratchArena* scratch = nullptr);
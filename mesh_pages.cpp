@@ -0,0 +1,291 @@
+#include "mesh_pages.h"
+#include "edge_builder.h"
+#include "mesh_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const char pagesMagic[8] = { 'S', 'R', 'P', 'A', 'G', 'E', 'S', '\0' };
+const uint32_t pagesVersion = 2;
+const uint64_t pageAlignment = 4096;
+const unsigned int noLocalVertex = std::numeric_limits<unsigned int>::max();
+
+uint64_t alignPage(uint64_t offset) {
+    return (offset + pageAlignment - 1) & ~(pageAlignment - 1);
+}
+
+uint64_t pageBytes(const MeshPage& page) {
+    return uint64_t(page.vertexCount) * 3 * sizeof(float)
+        + (uint64_t(page.indexCount) + page.edgeIndexCount) * sizeof(uint16_t);
+}
+
+// Interleaves the low 10 bits of x, y and z.
+uint32_t mortonCode(uint32_t x, uint32_t y, uint32_t z) {
+    auto spread = [](uint32_t v) {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+// Triangles of the index range sorted along a Morton curve through their
+// centroids, so consecutive runs are spatially compact.
+std::vector<unsigned int> mortonTriangleOrder(const MeshView& view, const unsigned int* indices, size_t triangleCount) {
+    glm::vec3 extent = view.boundsMax - view.boundsMin;
+    glm::vec3 scale(extent.x > 0.0f ? 1023.0f / extent.x : 0.0f, extent.y > 0.0f ? 1023.0f / extent.y : 0.0f,
+                    extent.z > 0.0f ? 1023.0f / extent.z : 0.0f);
+
+    std::vector<uint64_t> keyed(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        glm::vec3 centroid(0.0f);
+        for (int corner = 0; corner < 3; corner++) {
+            const float* p = view.vertices + size_t(indices[t * 3 + corner]) * 3;
+            centroid += glm::vec3(p[0], p[1], p[2]);
+        }
+        glm::vec3 cell = glm::clamp((centroid / 3.0f - view.boundsMin) * scale, 0.0f, 1023.0f);
+        uint64_t code = mortonCode(static_cast<uint32_t>(cell.x), static_cast<uint32_t>(cell.y), static_cast<uint32_t>(cell.z));
+        keyed[t] = (code << 32) | t;
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    std::vector<unsigned int> order(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        order[t] = static_cast<unsigned int>(keyed[t] & 0xffffffffu);
+    return order;
+}
+
+}
+
+bool MeshPageFile::open(const char* pagePath, const char* sourcePath) {
+    close();
+
+    if (!file_.open(pagePath))
+        return false;
+
+    uint64_t size = file_.size();
+    const MeshPageFileHeader* header = reinterpret_cast<const MeshPageFileHeader*>(file_.data());
+    bool valid = size >= sizeof(MeshPageFileHeader)
+        && std::memcmp(header->magic, pagesMagic, sizeof(pagesMagic)) == 0
+        && header->version == pagesVersion
+        && header->tableOffset <= size
+        && header->pageCount <= (size - header->tableOffset) / sizeof(MeshPage)
+        && header->maxVertexCount <= pageVertexLimit
+        && header->maxIndexCount <= pageTriangleLimit * 3;
+
+    // Every page must lie inside the file and respect the limits above.
+    const MeshPage* pages = valid ? reinterpret_cast<const MeshPage*>(file_.data() + header->tableOffset) : nullptr;
+    for (uint64_t i = 0; valid && i < header->pageCount; i++) {
+        const MeshPage& page = pages[i];
+        valid = page.offset % pageAlignment == 0 && page.offset <= size && pageBytes(page) <= size - page.offset
+            && page.vertexCount <= header->maxVertexCount && page.indexCount <= header->maxIndexCount
+            && page.edgeIndexCount <= header->maxEdgeIndexCount && page.indexEnd <= page.vertexCount;
+    }
+
+    SourceStamp stamp;
+    valid = valid && stampSource(sourcePath, stamp)
+        && stamp.size == header->sourceSize
+        && stamp.time == header->sourceTime
+        && stamp.hash == header->sourceHash;
+
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    header_ = header;
+    pages_ = pages;
+    return true;
+}
+
+void MeshPageFile::close() {
+    file_.close();
+    header_ = nullptr;
+    pages_ = nullptr;
+}
+
+std::string meshPagePath(const char* sourcePath) {
+    return std::string(sourcePath) + ".srpages";
+}
+
+bool writeMeshPages(const char* pagePath, const char* sourcePath, const MeshView& view, bool hasEdges,
+                    MeshPageStats* stats) {
+    auto start = std::chrono::steady_clock::now();
+    SourceStamp stamp;
+    if (!stampSource(sourcePath, stamp))
+        return false;
+
+    MeshLod full = lodOf(view, 0);
+    const unsigned int* indices = view.indices + full.firstIndex;
+    size_t triangleCount = full.indexCount / 3;
+    std::vector<unsigned int> order = mortonTriangleOrder(view, indices, triangleCount);
+
+    // Cut the curve into runs that stay within both page limits.
+    std::vector<unsigned int> localIndex(view.vertexCount, noLocalVertex);
+    std::vector<size_t> pageStarts;
+    size_t pageVertices = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const unsigned int* corners = indices + size_t(order[t]) * 3;
+        size_t added = 0;
+        for (int corner = 0; corner < 3; corner++)
+            added += localIndex[corners[corner]] == noLocalVertex;
+        bool pageFull = !pageStarts.empty()
+            && (t - pageStarts.back() == pageTriangleLimit || pageVertices + added > pageVertexLimit);
+        if (pageStarts.empty() || pageFull) {
+            // Reset the marks of the previous run.
+            for (size_t u = pageStarts.empty() ? t : pageStarts.back(); u < t; u++) {
+                for (int corner = 0; corner < 3; corner++)
+                    localIndex[indices[size_t(order[u]) * 3 + corner]] = noLocalVertex;
+            }
+            pageStarts.push_back(t);
+            pageVertices = 0;
+        }
+        for (int corner = 0; corner < 3; corner++) {
+            if (localIndex[corners[corner]] == noLocalVertex) {
+                localIndex[corners[corner]] = 0;
+                pageVertices++;
+            }
+        }
+    }
+    std::fill(localIndex.begin(), localIndex.end(), noLocalVertex);
+
+    ScratchVector<uint64_t> edgeKeys;
+    if (hasEdges) {
+        const unsigned int* edges = view.edgeIndices + full.firstEdgeIndex;
+        edgeKeys.reserve(full.edgeIndexCount / 2);
+        for (size_t e = 0; e + 1 < full.edgeIndexCount; e += 2)
+            edgeKeys.push_back(packEdge(edges[e], edges[e + 1]));
+        sortUniqueEdges(edgeKeys);
+    }
+    std::vector<char> edgeAssigned(edgeKeys.size(), 0);
+
+    MeshPageFileHeader header = {};
+    std::memcpy(header.magic, pagesMagic, sizeof(pagesMagic));
+    header.version = pagesVersion;
+    header.flags = hasEdges ? meshPagesHaveEdges : 0;
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.sourceHash = stamp.hash;
+    header.pageCount = pageStarts.size();
+    header.tableOffset = sizeof(MeshPageFileHeader);
+    header.triangleCount = triangleCount;
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = view.boundsMin[i];
+        header.boundsMax[i] = view.boundsMax[i];
+        header.color[i] = view.color[i];
+    }
+    std::vector<MeshPage> table(pageStarts.size());
+
+    std::string tempPath = temporaryPathFor(pagePath);
+    size_t totalPageVertices = 0;
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        // The table is rewritten with the real entries once every page is out.
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(MeshPage)));
+
+        std::vector<float> vertices;
+        std::vector<uint16_t> pageIndices;
+        std::vector<uint16_t> pageEdges;
+        std::vector<unsigned int> localVertices;
+        const char padding[pageAlignment] = {};
+        for (size_t p = 0; p < pageStarts.size(); p++) {
+            size_t begin = pageStarts[p];
+            size_t end = p + 1 < pageStarts.size() ? pageStarts[p + 1] : triangleCount;
+            vertices.clear();
+            pageIndices.clear();
+            pageEdges.clear();
+            localVertices.clear();
+
+            auto local = [&](unsigned int vertex) {
+                if (localIndex[vertex] == noLocalVertex) {
+                    localIndex[vertex] = static_cast<unsigned int>(localVertices.size());
+                    localVertices.push_back(vertex);
+                    vertices.insert(vertices.end(), view.vertices + size_t(vertex) * 3, view.vertices + size_t(vertex) * 3 + 3);
+                }
+                return static_cast<uint16_t>(localIndex[vertex]);
+            };
+            for (size_t t = begin; t < end; t++) {
+                const unsigned int* corners = indices + size_t(order[t]) * 3;
+                for (int corner = 0; corner < 3; corner++)
+                    pageIndices.push_back(local(corners[corner]));
+                for (int corner = 0; corner < 3 && !edgeKeys.empty(); corner++) {
+                    uint64_t key = packEdge(corners[corner], corners[(corner + 1) % 3]);
+                    auto found = std::lower_bound(edgeKeys.begin(), edgeKeys.end(), key);
+                    if (found == edgeKeys.end() || *found != key || edgeAssigned[found - edgeKeys.begin()])
+                        continue;
+                    edgeAssigned[found - edgeKeys.begin()] = 1;
+                    pageEdges.push_back(local(corners[corner]));
+                    pageEdges.push_back(local(corners[(corner + 1) % 3]));
+                }
+            }
+
+            MeshPage& page = table[p];
+            page.boundsMin[0] = page.boundsMin[1] = page.boundsMin[2] = std::numeric_limits<float>::max();
+            page.boundsMax[0] = page.boundsMax[1] = page.boundsMax[2] = -std::numeric_limits<float>::max();
+            for (size_t v = 0; v < vertices.size(); v++) {
+                page.boundsMin[v % 3] = std::min(page.boundsMin[v % 3], vertices[v]);
+                page.boundsMax[v % 3] = std::max(page.boundsMax[v % 3], vertices[v]);
+            }
+            page.offset = alignPage(static_cast<uint64_t>(out.tellp()));
+            page.vertexCount = static_cast<uint32_t>(localVertices.size());
+            page.indexCount = static_cast<uint32_t>(pageIndices.size());
+            page.edgeIndexCount = static_cast<uint32_t>(pageEdges.size());
+            page.indexEnd = 0;
+            for (uint16_t index : pageIndices)
+                page.indexEnd = std::max(page.indexEnd, uint32_t(index) + 1);
+            for (uint16_t index : pageEdges)
+                page.indexEnd = std::max(page.indexEnd, uint32_t(index) + 1);
+            header.maxVertexCount = std::max(header.maxVertexCount, page.vertexCount);
+            header.maxIndexCount = std::max(header.maxIndexCount, page.indexCount);
+            header.maxEdgeIndexCount = std::max(header.maxEdgeIndexCount, page.edgeIndexCount);
+            header.edgeIndexCount += page.edgeIndexCount;
+            totalPageVertices += localVertices.size();
+
+            out.write(padding, static_cast<std::streamsize>(page.offset - static_cast<uint64_t>(out.tellp())));
+            out.write(reinterpret_cast<const char*>(vertices.data()), static_cast<std::streamsize>(vertices.size() * sizeof(float)));
+            out.write(reinterpret_cast<const char*>(pageIndices.data()), static_cast<std::streamsize>(pageIndices.size() * sizeof(uint16_t)));
+            out.write(reinterpret_cast<const char*>(pageEdges.data()), static_cast<std::streamsize>(pageEdges.size() * sizeof(uint16_t)));
+
+            for (unsigned int vertex : localVertices)
+                localIndex[vertex] = noLocalVertex;
+        }
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(MeshPage)));
+
+        if (!out) {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, pagePath, error);
+    if (error) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    if (stats) {
+        stats->pageCount = pageStarts.size();
+        stats->vertexDuplication = view.vertexCount > 0 ? double(totalPageVertices) / view.vertexCount : 0.0;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return true;
+}
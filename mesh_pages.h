@@ -0,0 +1,101 @@
+#pragma once
+#include "mapped_file.h"
+#include "mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Page file written next to a source OBJ for meshes drawn out of core.
+// The full-resolution triangles are cut into pages of spatially close
+// triangles, each carrying its own vertices, 16-bit triangle indices and
+// 16-bit outline edge indices, so a page is copied to the GPU in one
+// piece and drawn on its own. Layout (little-endian): this header, the
+// MeshPage table, then one blob per page on a 4 KB boundary holding the
+// vertex floats followed by the triangle and edge indices.
+struct MeshPageFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+
+    // Identity of the source file the pages were built from.
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+
+    uint64_t pageCount;
+    uint64_t tableOffset;
+    // Largest page in the file, for sizing residency slots.
+    uint32_t maxVertexCount;
+    uint32_t maxIndexCount;
+    uint32_t maxEdgeIndexCount;
+    uint32_t reserved;
+    uint64_t triangleCount;
+    uint64_t edgeIndexCount;
+
+    float boundsMin[3];
+    float boundsMax[3];
+    float color[3];
+    uint32_t reserved2;
+};
+
+const uint32_t meshPagesHaveEdges = 1u << 0;
+
+struct MeshPage {
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t offset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t edgeIndexCount;
+    // One past the largest triangle or edge index, checked against
+    // vertexCount on open so no page indexes outside its own vertices.
+    uint32_t indexEnd;
+};
+
+// Limits of one page; small enough that a page streams within a frame's
+// upload budget and its indices fit 16 bits.
+const uint32_t pageVertexLimit = 4096;
+const uint32_t pageTriangleLimit = 4096;
+
+// A page file mapped read-only. Only the pages that are streamed in are
+// ever touched, so the operating system keeps the rest on disk.
+class MeshPageFile {
+public:
+    // Maps pagePath and checks it against the current state of sourcePath.
+    // Returns false if the file is missing, malformed or stale.
+    bool open(const char* pagePath, const char* sourcePath);
+    void close();
+
+    bool isOpen() const { return header_ != nullptr; }
+    bool hasEdges() const { return header_ && (header_->flags & meshPagesHaveEdges); }
+    const MeshPageFileHeader& header() const { return *header_; }
+    size_t pageCount() const { return header_ ? static_cast<size_t>(header_->pageCount) : 0; }
+    const MeshPage& page(size_t index) const { return pages_[index]; }
+    // Vertex floats of the page, followed by its triangle and edge indices.
+    const unsigned char* pageData(size_t index) const {
+        return reinterpret_cast<const unsigned char*>(file_.data() + pages_[index].offset);
+    }
+
+private:
+    MappedFile file_;
+    const MeshPageFileHeader* header_ = nullptr;
+    const MeshPage* pages_ = nullptr;
+};
+
+struct MeshPageStats {
+    size_t pageCount = 0;
+    // Page vertices over mesh vertices: the cost of duplicating vertices
+    // shared across page borders.
+    double vertexDuplication = 0.0;
+    double seconds = 0.0;
+};
+
+// Page file location for a source file: the same path with ".srpages" appended.
+std::string meshPagePath(const char* sourcePath);
+
+// Splits the full-resolution level of view into pages along a Morton
+// curve over triangle centroids and writes them through a temporary file
+// that is renamed into place. Each outline edge goes to the first page
+// holding a triangle with that edge.
+bool writeMeshPages(const char* pagePath, const char* sourcePath, const MeshView& view, bool hasEdges,
+                    MeshPageStats* stats = nullptr);
@@ -0,0 +1,355 @@
+#include "mesh_simplifier.h"
+#include "edge_builder.h"
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <queue>
+
+namespace {
+
+// No level is made with fewer triangles than this, so small meshes keep
+// only their full-resolution level.
+const size_t minLodTriangles = 256;
+// Boundary edges get a constraint plane weighted this much more than a
+// face plane, so open borders do not shrink.
+const double boundaryWeight = 10.0;
+
+// Symmetric 4x4 matrix of a sum of squared plane distances.
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    void addPlane(double a, double b, double c, double d, double weight) {
+        a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+        b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+        c2 += weight * c * c; cd += weight * c * d;
+        d2 += weight * d * d;
+    }
+
+    void add(const Quadric& q) {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2;
+        bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2;
+    }
+
+    double evaluate(const float* p) const {
+        double x = p[0], y = p[1], z = p[2];
+        double value = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                     + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                     + c2 * z * z + 2 * cd * z + d2;
+        return value > 0.0 ? value : 0.0;
+    }
+};
+
+struct Collapse {
+    double cost;
+    unsigned int from;
+    unsigned int to;
+    unsigned int fromVersion;
+    unsigned int toVersion;
+
+    bool operator<(const Collapse& other) const { return cost > other.cost; }
+};
+
+glm::vec3 position(const float* vertices, unsigned int index) {
+    return glm::vec3(vertices[index * 3], vertices[index * 3 + 1], vertices[index * 3 + 2]);
+}
+
+glm::vec3 faceNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    return glm::cross(b - a, c - a);
+}
+
+unsigned int findRoot(ScratchVector<unsigned int>& remap, unsigned int index) {
+    unsigned int root = index;
+    while (remap[root] != root)
+        root = remap[root];
+    while (remap[index] != root) {
+        unsigned int next = remap[index];
+        remap[index] = root;
+        index = next;
+    }
+    return root;
+}
+
+}
+
+ScratchVector<unsigned int> simplifyMesh(const float* vertices, size_t vertexCount, const unsigned int* indices,
+                                         size_t indexCount, size_t targetIndexCount,
+                                         ScratchVector<unsigned int>& remap, float& error, ScratchArena* scratch) {
+    ScratchVector<unsigned int> triangles(indices, indices + indexCount, scratch);
+    size_t triangleCount = triangles.size() / 3;
+    size_t targetTriangles = targetIndexCount / 3;
+
+    remap.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        remap[v] = static_cast<unsigned int>(v);
+    error = 0.0f;
+
+    // Face planes, and a perpendicular plane along every boundary edge.
+    ScratchVector<Quadric> quadrics(vertexCount, Quadric(), scratch);
+    ScratchVector<uint64_t> edgeUses(scratch);
+    edgeUses.reserve(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; t++) {
+        const unsigned int* corner = &triangles[t * 3];
+        glm::vec3 normal = faceNormal(position(vertices, corner[0]), position(vertices, corner[1]),
+                                      position(vertices, corner[2]));
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            normal /= length;
+            double d = -glm::dot(normal, position(vertices, corner[0]));
+            for (int k = 0; k < 3; k++)
+                quadrics[corner[k]].addPlane(normal.x, normal.y, normal.z, d, 1.0);
+        }
+        appendFaceEdges(corner, 3, edgeUses);
+    }
+    std::sort(edgeUses.begin(), edgeUses.end());
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        const unsigned int* corner = &triangles[t * 3];
+        glm::vec3 normal = faceNormal(position(vertices, corner[0]), position(vertices, corner[1]),
+                                      position(vertices, corner[2]));
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = corner[k], b = corner[(k + 1) % 3];
+            uint64_t key = packEdge(a, b);
+            auto range = std::equal_range(edgeUses.begin(), edgeUses.end(), key);
+            if (range.second - range.first != 1)
+                continue;
+            glm::vec3 along = position(vertices, b) - position(vertices, a);
+            glm::vec3 side = glm::cross(along, normal);
+            float length = glm::length(side);
+            if (length <= 0.0f)
+                continue;
+            side /= length;
+            double d = -glm::dot(side, position(vertices, a));
+            quadrics[a].addPlane(side.x, side.y, side.z, d, boundaryWeight);
+            quadrics[b].addPlane(side.x, side.y, side.z, d, boundaryWeight);
+        }
+    }
+
+    // Triangles around each vertex as linked lists through the corners:
+    // corner c belongs to triangle c / 3 and starts in the list of the
+    // vertex it names. A collapse splices the lists together instead of
+    // copying them, so this is three arrays rather than a vector per
+    // vertex.
+    const unsigned int endOfList = ~0u;
+    ScratchVector<unsigned int> nextCorner(triangleCount * 3, endOfList, scratch);
+    ScratchVector<unsigned int> firstCorner(vertexCount, endOfList, scratch);
+    ScratchVector<unsigned int> lastCorner(vertexCount, endOfList, scratch);
+    for (size_t c = 0; c < triangleCount * 3; c++) {
+        unsigned int v = triangles[c];
+        if (lastCorner[v] == endOfList)
+            firstCorner[v] = static_cast<unsigned int>(c);
+        else
+            nextCorner[lastCorner[v]] = static_cast<unsigned int>(c);
+        lastCorner[v] = static_cast<unsigned int>(c);
+    }
+
+    ScratchVector<unsigned char> triangleAlive(triangleCount, 1, scratch);
+    ScratchVector<unsigned int> versions(vertexCount, 0, scratch);
+    ScratchVector<Collapse> heapStorage(scratch);
+    heapStorage.reserve(edgeUses.size());
+    std::priority_queue<Collapse, ScratchVector<Collapse>> heap(std::less<Collapse>(), std::move(heapStorage));
+
+    // Merging a into b keeps b's position; the cheaper direction is queued.
+    auto pushEdge = [&](unsigned int a, unsigned int b) {
+        Quadric sum = quadrics[a];
+        sum.add(quadrics[b]);
+        double costAB = sum.evaluate(&vertices[b * 3]);
+        double costBA = sum.evaluate(&vertices[a * 3]);
+        if (costAB <= costBA)
+            heap.push({ costAB, a, b, versions[a], versions[b] });
+        else
+            heap.push({ costBA, b, a, versions[b], versions[a] });
+    };
+
+    edgeUses.erase(std::unique(edgeUses.begin(), edgeUses.end()), edgeUses.end());
+    for (uint64_t key : edgeUses) {
+        unsigned int a = static_cast<unsigned int>(key >> 32);
+        unsigned int b = static_cast<unsigned int>(key & 0xffffffffu);
+        if (a != b)
+            pushEdge(a, b);
+    }
+    edgeUses.clear();
+    edgeUses.shrink_to_fit();
+
+    size_t liveTriangles = triangleCount;
+    double maxCost = 0.0;
+    ScratchVector<unsigned int> neighbours(scratch);
+    while (liveTriangles > targetTriangles && !heap.empty()) {
+        Collapse collapse = heap.top();
+        heap.pop();
+        unsigned int from = collapse.from, to = collapse.to;
+        if (remap[from] != from || remap[to] != to
+            || versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion)
+            continue;
+
+        // Reject collapses that would turn a surviving triangle over.
+        bool flips = false;
+        glm::vec3 target = position(vertices, to);
+        for (unsigned int c = firstCorner[from]; c != endOfList; c = nextCorner[c]) {
+            unsigned int t = c / 3;
+            if (!triangleAlive[t])
+                continue;
+            const unsigned int* corner = &triangles[t * 3];
+            if (corner[0] == to || corner[1] == to || corner[2] == to)
+                continue;
+            glm::vec3 p[3], q[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = position(vertices, corner[k]);
+                q[k] = corner[k] == from ? target : p[k];
+            }
+            if (glm::dot(faceNormal(p[0], p[1], p[2]), faceNormal(q[0], q[1], q[2])) <= 0.0f) {
+                flips = true;
+                break;
+            }
+        }
+        if (flips)
+            continue;
+
+        quadrics[to].add(quadrics[from]);
+        for (unsigned int c = firstCorner[from]; c != endOfList; c = nextCorner[c]) {
+            unsigned int t = c / 3;
+            if (!triangleAlive[t])
+                continue;
+            unsigned int* corner = &triangles[t * 3];
+            if (corner[0] == to || corner[1] == to || corner[2] == to) {
+                triangleAlive[t] = 0;
+                liveTriangles--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (corner[k] == from)
+                    corner[k] = to;
+            }
+        }
+        if (firstCorner[from] != endOfList) {
+            if (lastCorner[to] == endOfList)
+                firstCorner[to] = firstCorner[from];
+            else
+                nextCorner[lastCorner[to]] = firstCorner[from];
+            lastCorner[to] = lastCorner[from];
+            firstCorner[from] = lastCorner[from] = endOfList;
+        }
+        remap[from] = to;
+        versions[to]++;
+        maxCost = std::max(maxCost, collapse.cost);
+
+        // Drop the triangles that died, here or in earlier collapses, from
+        // the merged list.
+        unsigned int previousCorner = endOfList;
+        for (unsigned int c = firstCorner[to]; c != endOfList; c = nextCorner[c]) {
+            if (triangleAlive[c / 3]) {
+                previousCorner = c;
+                continue;
+            }
+            if (previousCorner == endOfList)
+                firstCorner[to] = nextCorner[c];
+            else
+                nextCorner[previousCorner] = nextCorner[c];
+        }
+        lastCorner[to] = previousCorner;
+        if (previousCorner != endOfList)
+            nextCorner[previousCorner] = endOfList;
+
+        neighbours.clear();
+        for (unsigned int c = firstCorner[to]; c != endOfList; c = nextCorner[c]) {
+            unsigned int t = c / 3;
+            for (int k = 0; k < 3; k++) {
+                if (triangles[t * 3 + k] != to)
+                    neighbours.push_back(triangles[t * 3 + k]);
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for (unsigned int neighbour : neighbours)
+            pushEdge(neighbour, to);
+    }
+
+    for (size_t v = 0; v < vertexCount; v++)
+        findRoot(remap, static_cast<unsigned int>(v));
+    error = static_cast<float>(std::sqrt(maxCost));
+
+    ScratchVector<unsigned int> output(scratch);
+    output.reserve(liveTriangles * 3);
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (triangleAlive[t])
+            output.insert(output.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+    }
+    return output;
+}
+
+MeshLodStats buildMeshLods(Mesh& mesh, ScratchArena* scratch) {
+    auto startTime = std::chrono::steady_clock::now();
+    size_t vertexCount = mesh.vertices.size() / 3;
+
+    mesh.lods.clear();
+    mesh.lods.push_back({ 0, static_cast<uint32_t>(mesh.indices.size()),
+                          0, static_cast<uint32_t>(mesh.edgeIndices.size()), 0.0f });
+
+    MeshLodStats stats;
+    stats.triangles[0] = mesh.indices.size() / 3;
+
+    // Each level is simplified from the one before; its vertex map and
+    // error bound accumulate along the chain.
+    ScratchVector<unsigned int> previous(mesh.indices.begin(), mesh.indices.end(), scratch);
+    ScratchVector<unsigned int> remap(vertexCount, 0, scratch);
+    for (size_t v = 0; v < vertexCount; v++)
+        remap[v] = static_cast<unsigned int>(v);
+    ScratchVector<unsigned int> stepRemap(scratch);
+    ScratchVector<uint64_t> outline(scratch);
+    outline.reserve(mesh.lods[0].edgeIndexCount / 2);
+    for (uint32_t i = 0; i + 1 < mesh.lods[0].edgeIndexCount; i += 2)
+        outline.push_back(packEdge(mesh.edgeIndices[i], mesh.edgeIndices[i + 1]));
+    float error = 0.0f;
+
+    while (mesh.lods.size() < maxLodCount) {
+        size_t target = previous.size() / 6 * 3;
+        if (target / 3 < minLodTriangles)
+            break;
+
+        float stepError = 0.0f;
+        ScratchVector<unsigned int> simplified = simplifyMesh(mesh.vertices.data(), vertexCount, previous.data(),
+                                                              previous.size(), target, stepRemap, stepError, scratch);
+        // Stop once collapses run out well short of the target.
+        if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+            break;
+        for (unsigned int& vertex : remap)
+            vertex = stepRemap[vertex];
+        error += stepError;
+        optimizeVertexCache(simplified.data(), simplified.size(), vertexCount, 16, scratch);
+
+        ScratchVector<uint64_t> present(scratch);
+        present.reserve(simplified.size());
+        for (size_t i = 0; i < simplified.size(); i += 3)
+            appendFaceEdges(&simplified[i], 3, present);
+        sortUniqueEdges(present);
+
+        ScratchVector<uint64_t> keys(scratch);
+        keys.reserve(outline.size());
+        for (uint64_t key : outline) {
+            unsigned int a = remap[static_cast<unsigned int>(key >> 32)];
+            unsigned int b = remap[static_cast<unsigned int>(key & 0xffffffffu)];
+            uint64_t mapped = packEdge(a, b);
+            if (a != b && std::binary_search(present.begin(), present.end(), mapped))
+                keys.push_back(mapped);
+        }
+        sortUniqueEdges(keys);
+        std::vector<unsigned int> edges = edgeIndicesFromKeys(keys);
+
+        MeshLod lod;
+        lod.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+        lod.indexCount = static_cast<uint32_t>(simplified.size());
+        lod.firstEdgeIndex = static_cast<uint32_t>(mesh.edgeIndices.size());
+        lod.edgeIndexCount = static_cast<uint32_t>(edges.size());
+        lod.error = error;
+        mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+        mesh.edgeIndices.insert(mesh.edgeIndices.end(), edges.begin(), edges.end());
+        stats.triangles[mesh.lods.size()] = simplified.size() / 3;
+        stats.error[mesh.lods.size()] = error;
+        mesh.lods.push_back(lod);
+        previous.swap(simplified);
+    }
+
+    stats.lodCount = mesh.lods.size();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return stats;
+}
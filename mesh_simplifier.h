@@ -0,0 +1,31 @@
+#pragma once
+#include "mesh.h"
+#include "scratch_arena.h"
+#include <cstddef>
+#include <vector>
+
+struct MeshLodStats {
+    size_t lodCount = 0;
+    size_t triangles[maxLodCount] = {};
+    float error[maxLodCount] = {};
+    double seconds = 0.0;
+};
+
+// Simplifies a triangle list by quadric error edge collapses (Garland and
+// Heckbert 1997) until at most targetIndexCount indices remain or no
+// collapse is left. Vertices are never moved or added: each collapse
+// merges a vertex into a neighbour, so the result indexes the same vertex
+// array. remap is set to the vertex each input vertex was merged into,
+// and error to the bound on surface deviation of the last collapse taken.
+// The result and working arrays come from scratch when given.
+ScratchVector<unsigned int> simplifyMesh(const float* vertices, size_t vertexCount, const unsigned int* indices,
+                                         size_t indexCount, size_t targetIndexCount,
+                                         ScratchVector<unsigned int>& remap, float& error,
+                                         ScratchArena* scratch = nullptr);
+
+// Appends up to maxLodCount - 1 coarser levels, each with about half the
+// triangles of the one before, to mesh.indices and mesh.edgeIndices and
+// records all levels in mesh.lods. Outline edges of each level are the
+// full-resolution outline edges that survive the collapses. Run after
+// optimizeMesh, which reorders the whole index arrays.
+MeshLodStats buildMeshLods(Mesh& mesh, ScratchArena* scratch = nullptr);
@@ -0,0 +1,261 @@
+#include "metrics.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Lines the writer may fall behind by before the oldest are dropped.
+const size_t maxQueuedLines = 64;
+
+enum class WriteResult { Written, Dropped, Failed };
+
+// The metrics file as the writer thread sees it. Opening never blocks:
+// a named pipe without a reader fails the open, and a pipe whose reader
+// is behind drops the line rather than waiting for room.
+class LineSink {
+public:
+    ~LineSink() { close(); }
+
+#ifdef _WIN32
+    bool isOpen() const { return file_.is_open(); }
+
+    bool open(const char* path) {
+        file_.open(path, std::ios::out | std::ios::app);
+        return file_.is_open();
+    }
+
+    void close() {
+        if (file_.is_open())
+            file_.close();
+        file_.clear();
+    }
+
+    WriteResult write(const std::string& line) {
+        file_ << line << '\n';
+        file_.flush();
+        if (file_)
+            return WriteResult::Written;
+        close();
+        return WriteResult::Failed;
+    }
+
+private:
+    std::ofstream file_;
+#else
+    bool isOpen() const { return fd_ >= 0; }
+
+    bool open(const char* path) {
+        fd_ = ::open(path, O_WRONLY | O_APPEND | O_CREAT | O_NONBLOCK | O_CLOEXEC, 0644);
+        return fd_ >= 0;
+    }
+
+    void close() {
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+    WriteResult write(const std::string& line) {
+        std::string text = line + '\n';
+        size_t written = 0;
+        while (written < text.size()) {
+            ssize_t count = ::write(fd_, text.data() + written, text.size() - written);
+            if (count > 0) {
+                written += size_t(count);
+                continue;
+            }
+            if (count < 0 && errno == EINTR)
+                continue;
+            // Lines are shorter than PIPE_BUF, so a full pipe takes none
+            // of one and the reader still sees whole lines
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && written == 0)
+                return WriteResult::Dropped;
+            close();
+            return WriteResult::Failed;
+        }
+        return WriteResult::Written;
+    }
+
+private:
+    int fd_ = -1;
+#endif
+};
+
+std::string headerLine() {
+    std::ostringstream header;
+    header << "{\"frameTimeBucketEdgesMs\":[";
+    for (size_t i = 0; i + 1 < frameTimeBucketCount; i++)
+        header << (i ? "," : "") << frameTimeBucketEdges[i];
+    header << "]}";
+    return header.str();
+}
+
+void writeCount(std::ostringstream& out, const char* name, long long value) {
+    out << "\"" << name << "\":";
+    if (value < 0)
+        out << "null";
+    else
+        out << value;
+}
+
+}
+
+Metrics::~Metrics() {
+    destroy();
+}
+
+void Metrics::create(const char* path, double intervalSeconds) {
+    destroy();
+    enabled_ = true;
+    start_ = intervalStart_ = Clock::now();
+    interval_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(intervalSeconds));
+    current_ = MetricsSnapshot();
+    frameMsSum_ = cpuMsSum_ = gpuMsSum_ = 0.0;
+    timedFrames_ = 0;
+    if (!path)
+        return;
+
+#ifndef _WIN32
+    // A collector closing its end of a named pipe must fail the write,
+    // not kill the viewer
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    path_ = path;
+    stopping_ = false;
+    writer_ = std::thread(&Metrics::run, this);
+}
+
+void Metrics::destroy() {
+    if (writer_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            stopping_ = true;
+        }
+        queueChanged_.notify_one();
+        writer_.join();
+    }
+    queue_.clear();
+    enabled_ = false;
+}
+
+void Metrics::addFrameTime(double ms) {
+    size_t bucket = 0;
+    while (bucket + 1 < frameTimeBucketCount && ms > frameTimeBucketEdges[bucket])
+        bucket++;
+    current_.frameHistogram[bucket]++;
+    current_.frameMsMin = current_.frames ? std::min(current_.frameMsMin, ms) : ms;
+    current_.frameMsMax = std::max(current_.frameMsMax, ms);
+    frameMsSum_ += ms;
+    current_.frames++;
+}
+
+void Metrics::endFrame(uint64_t frame, const MetricsCounters& counters) {
+    if (!enabled_)
+        return;
+    Clock::time_point now = Clock::now();
+    if (now - intervalStart_ >= interval_)
+        publish(frame, counters, now);
+}
+
+void Metrics::publish(uint64_t frame, const MetricsCounters& counters, Clock::time_point now) {
+    MetricsSnapshot& snapshot = current_;
+    snapshot.seconds = std::chrono::duration<double>(now - start_).count();
+    snapshot.frame = frame;
+    snapshot.frameMsMean = snapshot.frames ? frameMsSum_ / snapshot.frames : 0.0;
+    snapshot.cpuMs = timedFrames_ ? cpuMsSum_ / timedFrames_ : 0.0;
+    snapshot.gpuMs = timedFrames_ ? gpuMsSum_ / timedFrames_ : 0.0;
+    snapshot.counters = counters;
+    {
+        std::lock_guard<std::mutex> lock(snapshotMutex_);
+        published_ = snapshot;
+    }
+    if (writer_.joinable()) {
+        std::string line = metricsJson(snapshot);
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (queue_.size() >= maxQueuedLines)
+                queue_.pop_front();
+            queue_.push_back(std::move(line));
+        }
+        queueChanged_.notify_one();
+    }
+
+    current_ = MetricsSnapshot();
+    frameMsSum_ = cpuMsSum_ = gpuMsSum_ = 0.0;
+    timedFrames_ = 0;
+    intervalStart_ = now;
+}
+
+MetricsSnapshot Metrics::snapshot() const {
+    std::lock_guard<std::mutex> lock(snapshotMutex_);
+    return published_;
+}
+
+void Metrics::run() {
+    const std::string header = headerLine();
+    LineSink sink;
+    bool failed = false;
+    bool dropping = false;
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    for (;;) {
+        queueChanged_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty())
+            return;
+        std::string line = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        // Opened here rather than in create, and again on the first line
+        // after a failure. Every open starts with the line naming the
+        // histogram buckets, so a collector that reconnects can read on
+        if (!sink.isOpen() && sink.open(path_.c_str()) && sink.write(header) == WriteResult::Written && failed) {
+            std::cerr << "Metrics file reopened: " << path_ << std::endl;
+            failed = false;
+        }
+        // Written unbuffered per line, so a reader tailing the file sees
+        // each interval as it closes
+        WriteResult result = sink.isOpen() ? sink.write(line) : WriteResult::Failed;
+        if (result == WriteResult::Failed && !failed) {
+            std::cerr << "Metrics file unavailable: " << path_ << "; dropping lines until it reopens" << std::endl;
+            failed = true;
+        }
+        else if (result == WriteResult::Dropped && !dropping)
+            std::cerr << "Metrics reader is not keeping up; dropping lines" << std::endl;
+        dropping = result == WriteResult::Dropped;
+        lock.lock();
+    }
+}
+
+std::string metricsJson(const MetricsSnapshot& snapshot) {
+    const MetricsCounters& counters = snapshot.counters;
+    std::ostringstream out;
+    out << "{\"seconds\":" << snapshot.seconds << ",\"frame\":" << snapshot.frame << ",\"frames\":" << snapshot.frames
+        << ",\"frameMs\":{\"mean\":" << snapshot.frameMsMean << ",\"min\":" << snapshot.frameMsMin
+        << ",\"max\":" << snapshot.frameMsMax << ",\"histogram\":[";
+    for (size_t i = 0; i < frameTimeBucketCount; i++)
+        out << (i ? "," : "") << snapshot.frameHistogram[i];
+    out << "]},\"cpuMs\":" << snapshot.cpuMs << ",\"gpuMs\":" << snapshot.gpuMs
+        << ",\"drawCalls\":" << counters.drawCalls << ",";
+    writeCount(out, "trianglesSubmitted", counters.trianglesSubmitted);
+    out << ",";
+    writeCount(out, "trianglesCulled", counters.trianglesCulled);
+    out << ",";
+    writeCount(out, "instancesVisible", counters.instancesVisible);
+    out << ",";
+    writeCount(out, "instancesCulled", counters.instancesCulled);
+    out << ",\"bufferBytes\":{\"geometry\":" << counters.geometryBytes << ",\"instances\":" << counters.instanceBytes
+        << ",\"staging\":" << counters.stagingBytes << ",\"pages\":" << counters.pageBytes
+        << "},\"uploadBytes\":" << counters.uploadBytes << ",\"loadMs\":" << counters.loadMs
+        << ",\"uploadMs\":" << counters.uploadMs << "}";
+    return out.str();
+}
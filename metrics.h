@@ -0,0 +1,131 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Upper edges in milliseconds of the frame time histogram's buckets; one
+// more bucket counts the frames slower than the last edge.
+const double frameTimeBucketEdges[] = { 4.0, 8.0, 12.0, 16.7, 20.0, 25.0, 33.3, 50.0, 100.0 };
+const size_t frameTimeBucketCount = sizeof(frameTimeBucketEdges) / sizeof(frameTimeBucketEdges[0]) + 1;
+
+// What the render loop knows about its latest frame, handed to
+// Metrics::endFrame.
+struct MetricsCounters {
+    size_t drawCalls = 0;
+    // Negative when culling ran on the GPU and the counts never reach
+    // the CPU.
+    long long trianglesSubmitted = -1;
+    long long trianglesCulled = -1;
+    long long instancesVisible = -1;
+    long long instancesCulled = -1;
+    // GPU buffers in use.
+    size_t geometryBytes = 0;
+    size_t instanceBytes = 0;
+    size_t stagingBytes = 0;
+    size_t pageBytes = 0;
+    // Bytes copied to the GPU since startup: streamed geometry, draw
+    // lists and out-of-core pages.
+    uint64_t uploadBytes = 0;
+    // Startup: mesh files loaded, then geometry resident on the GPU.
+    double loadMs = 0.0;
+    double uploadMs = 0.0;
+};
+
+// One export interval: frame statistics over its frames, and the
+// counters as of its last frame.
+struct MetricsSnapshot {
+    // Seconds since Metrics::create, and the last frame's number.
+    double seconds = 0.0;
+    uint64_t frame = 0;
+    size_t frames = 0;
+    // Start-to-start frame times, including any pacing wait.
+    double frameMsMean = 0.0;
+    double frameMsMin = 0.0;
+    double frameMsMax = 0.0;
+    size_t frameHistogram[frameTimeBucketCount] = {};
+    // CPU and GPU time per frame, over the frames FrameProfiler completed
+    // in the interval; its GPU results arrive a few frames late.
+    double cpuMs = 0.0;
+    double gpuMs = 0.0;
+    MetricsCounters counters;
+};
+
+// Live performance counters for unattended viewers. The render loop
+// reports each frame; every interval the frames so far are summarized
+// into a snapshot, which snapshot() hands to in-process callers and which
+// is appended to a JSON lines file when one is given. The file is opened
+// and written on a thread of its own, so a slow disk or a named pipe
+// without a reader never stalls a frame; a file that fails is reported
+// once and reopened on a later interval. Until create is called every
+// record call returns on its first test, and the loop skips gathering
+// counters, so disabled metrics cost nothing measurable.
+class Metrics {
+public:
+    Metrics() = default;
+    ~Metrics();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    // path may be null to keep the snapshots in process only.
+    void create(const char* path, double intervalSeconds);
+    // Writes the lines still queued and stops the writer.
+    void destroy();
+    bool enabled() const { return enabled_; }
+
+    // Called by FrameProfiler: the time since the previous frame started,
+    // and the CPU and GPU total of each frame it completes.
+    void recordFrameTime(double ms) {
+        if (enabled_)
+            addFrameTime(ms);
+    }
+    void recordTimings(double cpuMs, double gpuMs) {
+        if (enabled_) {
+            cpuMsSum_ += cpuMs;
+            gpuMsSum_ += gpuMs;
+            timedFrames_++;
+        }
+    }
+    // Ends a frame; closes the interval once it has run its length.
+    void endFrame(uint64_t frame, const MetricsCounters& counters);
+
+    // The last closed interval; safe to call from any thread.
+    MetricsSnapshot snapshot() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void addFrameTime(double ms);
+    void publish(uint64_t frame, const MetricsCounters& counters, Clock::time_point now);
+    void run();
+
+    bool enabled_ = false;
+    Clock::time_point start_;
+    Clock::time_point intervalStart_;
+    Clock::duration interval_ = Clock::duration::zero();
+
+    // Frames of the open interval.
+    MetricsSnapshot current_;
+    double frameMsSum_ = 0.0;
+    double cpuMsSum_ = 0.0;
+    double gpuMsSum_ = 0.0;
+    size_t timedFrames_ = 0;
+
+    mutable std::mutex snapshotMutex_;
+    MetricsSnapshot published_;
+
+    std::string path_;
+    std::thread writer_;
+    std::mutex queueMutex_;
+    std::condition_variable queueChanged_;
+    std::deque<std::string> queue_;
+    bool stopping_ = false;
+};
+
+// The snapshot as one line of JSON, without the newline.
+std::string metricsJson(const MetricsSnapshot& snapshot);
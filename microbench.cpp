@@ -0,0 +1,324 @@
+// Microbenchmarks for the CPU side of mesh loading, built as the separate
+// Simple_rasterizer_bench target. Every stage runs over synthetic grids
+// from 1K triangles up to --max-triangles, ten times larger each step, so
+// scaling shows in one table.
+#include "edge_builder.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "obj_loader.h"
+#include "scratch_arena.h"
+#include "thread_pool.h"
+#include "triangulation.h"
+#include "vertex_quantization.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Runs repeat until they add up to this, with at least minRuns, unless one
+// run alone is slower than maxSeconds.
+const double targetSeconds = 0.5;
+const double maxSeconds = 2.0;
+const int minRuns = 3;
+
+// The std::set reference allocates a node per edge and is skipped above
+// this size.
+const size_t maxSetTriangles = 10000000;
+
+const char* objPath = "microbench_grid.obj";
+
+struct Timing {
+    int runs = 0;
+    double bestMs = 0.0;
+    double medianMs = 0.0;
+};
+
+// Times body, calling setup untimed before each run.
+Timing measure(const std::function<void()>& setup, const std::function<void()>& body) {
+    std::vector<double> samples;
+    double total = 0.0;
+    do {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        samples.push_back(seconds * 1000.0);
+        total += seconds;
+    } while (total < maxSeconds && (total < targetSeconds || static_cast<int>(samples.size()) < minRuns));
+    std::sort(samples.begin(), samples.end());
+    Timing timing;
+    timing.runs = static_cast<int>(samples.size());
+    timing.bestMs = samples.front();
+    timing.medianMs = samples[samples.size() / 2];
+    return timing;
+}
+
+void printHeader() {
+    std::printf("%-22s %12s %6s %12s %12s %10s\n", "stage", "triangles", "runs", "best ms", "median ms", "Mtri/s");
+}
+
+void printRow(const char* stage, size_t triangles, const Timing& timing) {
+    double rate = timing.bestMs > 0.0 ? triangles / (timing.bestMs * 1000.0) : 0.0;
+    std::printf("%-22s %12zu %6d %12.3f %12.3f %10.2f\n", stage, triangles, timing.runs, timing.bestMs,
+                timing.medianMs, rate);
+    std::fflush(stdout);
+}
+
+// Square grid of quads in the XZ plane, at least triangles / 2 of them.
+struct Grid {
+    size_t side = 0;
+    size_t vertexCount() const { return (side + 1) * (side + 1); }
+    size_t quadCount() const { return side * side; }
+};
+
+Grid gridFor(size_t triangles) {
+    Grid grid;
+    while (2 * grid.quadCount() < triangles)
+        grid.side++;
+    return grid;
+}
+
+// Vertex indices of quad q, counter-clockwise seen from +Y.
+void quadCorners(const Grid& grid, size_t q, unsigned int corners[4]) {
+    size_t row = q / grid.side, column = q % grid.side;
+    unsigned int first = static_cast<unsigned int>(row * (grid.side + 1) + column);
+    unsigned int stride = static_cast<unsigned int>(grid.side + 1);
+    corners[0] = first;
+    corners[1] = first + stride;
+    corners[2] = first + stride + 1;
+    corners[3] = first + 1;
+}
+
+// Grid as a triangle mesh with its quad outlines, triangles shuffled so
+// the cache optimizer has real work to do.
+Mesh buildGridMesh(const Grid& grid) {
+    Mesh mesh;
+    mesh.vertices.reserve(grid.vertexCount() * 3);
+    for (size_t z = 0; z <= grid.side; z++) {
+        for (size_t x = 0; x <= grid.side; x++) {
+            mesh.vertices.push_back(static_cast<float>(x));
+            mesh.vertices.push_back(0.0f);
+            mesh.vertices.push_back(static_cast<float>(z));
+        }
+    }
+
+    std::vector<size_t> order(grid.quadCount());
+    for (size_t q = 0; q < order.size(); q++)
+        order[q] = q;
+    std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+
+    ScratchVector<uint64_t> keys;
+    keys.reserve(grid.quadCount() * 4);
+    mesh.indices.reserve(grid.quadCount() * 6);
+    for (size_t q : order) {
+        unsigned int c[4];
+        quadCorners(grid, q, c);
+        mesh.indices.insert(mesh.indices.end(), { c[0], c[1], c[2], c[0], c[2], c[3] });
+        appendFaceEdges(c, 4, keys);
+    }
+    sortUniqueEdges(keys);
+    mesh.edgeIndices = edgeIndicesFromKeys(keys);
+    mesh.color = glm::vec3(1.0f);
+    mesh.boundsMin = glm::vec3(0.0f);
+    mesh.boundsMax = glm::vec3(static_cast<float>(grid.side), 0.0f, static_cast<float>(grid.side));
+    return mesh;
+}
+
+bool writeGridObj(const Grid& grid, const char* path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    std::vector<char> line(96);
+    for (size_t z = 0; z <= grid.side; z++) {
+        for (size_t x = 0; x <= grid.side; x++) {
+            int length = std::snprintf(line.data(), line.size(), "v %zu.25 0.5 %zu.75\n", x, z);
+            out.write(line.data(), length);
+        }
+    }
+    for (size_t q = 0; q < grid.quadCount(); q++) {
+        unsigned int c[4];
+        quadCorners(grid, q, c);
+        int length = std::snprintf(line.data(), line.size(), "f %u %u %u %u\n", c[0] + 1, c[1] + 1, c[2] + 1, c[3] + 1);
+        out.write(line.data(), length);
+    }
+    return static_cast<bool>(out);
+}
+
+bool selected(const char* stage, const char* filter) {
+    return !filter || std::strstr(stage, filter) != nullptr;
+}
+
+void benchmarkSize(size_t triangles, const char* filter) {
+    Grid grid = gridFor(triangles);
+    size_t gridTriangles = 2 * grid.quadCount();
+    Mesh mesh = buildGridMesh(grid);
+
+    // The cache stamps the OBJ it was built from, so it needs the file too.
+    bool parse = selected("obj parse", filter) || selected("obj parse+edges", filter)
+        || selected("obj parse+edges arena", filter);
+    bool cacheStage = selected("cache write", filter) || selected("cache read", filter);
+    if (parse || cacheStage) {
+        if (!writeGridObj(grid, objPath)) {
+            std::cerr << "Failed to write " << objPath << std::endl;
+            return;
+        }
+    }
+
+    if (selected("obj parse", filter)) {
+        ObjLoadOptions options;
+        options.buildEdges = false;
+        Mesh parsed;
+        printRow("obj parse", gridTriangles, measure([&] { parsed = Mesh(); }, [&] { parsed = loadOBJ(objPath, options); }));
+    }
+    if (selected("obj parse+edges", filter)) {
+        Mesh parsed;
+        printRow("obj parse+edges", gridTriangles, measure([&] { parsed = Mesh(); }, [&] { parsed = loadOBJ(objPath); }));
+    }
+    // As loadMeshAsset parses: scratch from an arena reset between loads
+    if (selected("obj parse+edges arena", filter)) {
+        ScratchArena scratch;
+        ObjLoadOptions options;
+        options.scratch = &scratch;
+        Mesh parsed;
+        printRow("obj parse+edges arena", gridTriangles, measure([&] { parsed = Mesh(); scratch.reset(); },
+                                                                 [&] { parsed = loadOBJ(objPath, options); }));
+    }
+
+    if (selected("triangulate quads", filter)) {
+        std::vector<unsigned int> faces(grid.quadCount() * 4);
+        for (size_t q = 0; q < grid.quadCount(); q++)
+            quadCorners(grid, q, &faces[q * 4]);
+        std::vector<unsigned int> out(grid.quadCount() * 6);
+        TriangulationScratch scratch;
+        printRow("triangulate quads", gridTriangles, measure([] {}, [&] {
+            for (size_t q = 0; q < grid.quadCount(); q++)
+                triangulatePolygon(mesh.vertices.data(), &faces[q * 4], 4, &out[q * 6], scratch);
+        }));
+    }
+
+    if (selected("edges std::set", filter) && gridTriangles <= maxSetTriangles) {
+        std::set<std::pair<unsigned int, unsigned int>> edges;
+        printRow("edges std::set", gridTriangles, measure([&] { edges.clear(); }, [&] {
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                for (int k = 0; k < 3; k++) {
+                    unsigned int a = mesh.indices[i + k], b = mesh.indices[i + (k + 1) % 3];
+                    edges.insert(std::make_pair(std::min(a, b), std::max(a, b)));
+                }
+            }
+        }));
+    }
+    if (selected("edges sort-unique", filter)) {
+        std::vector<unsigned int> edges;
+        printRow("edges sort-unique", gridTriangles,
+                 measure([&] { edges.clear(); }, [&] { edges = buildTriangleEdges(mesh.indices); }));
+    }
+
+    if (selected("vertex cache", filter)) {
+        std::vector<unsigned int> indices;
+        size_t vertexCount = grid.vertexCount();
+        printRow("vertex cache", gridTriangles, measure([&] { indices = mesh.indices; }, [&] {
+            optimizeVertexCache(indices.data(), indices.size(), vertexCount);
+        }));
+        std::printf("%-22s %12s acmr %.3f -> %.3f\n", "", "", averageCacheMissRatio(mesh.indices, vertexCount),
+                    averageCacheMissRatio(indices, vertexCount));
+    }
+    if (selected("vertex fetch", filter)) {
+        Mesh optimized;
+        printRow("vertex fetch", gridTriangles,
+                 measure([&] { optimized = mesh; }, [&] { optimizeVertexFetch(optimized); }));
+    }
+    if (selected("quantize positions", filter)) {
+        Mesh quantized;
+        printRow("quantize positions", gridTriangles,
+                 measure([&] { quantized = mesh; }, [&] { quantizeMeshPositions(quantized); }));
+    }
+
+    // A failed write or open is reported rather than timed as a no-op.
+    std::string cachePath = meshCachePath(objPath);
+    if (cacheStage) {
+        bool written = true;
+        Timing timing = measure([] {}, [&] {
+            written = writeMeshCache(cachePath.c_str(), objPath, mesh, true) && written;
+        });
+        if (written)
+            printRow("cache write", gridTriangles, timing);
+        else
+            std::cerr << "Failed to write " << cachePath << std::endl;
+        cacheStage = written;
+    }
+    if (cacheStage && selected("cache read", filter)) {
+        // Open, validate and touch one float per page, as an upload would.
+        volatile float sink = 0.0f;
+        bool opened = true;
+        Timing timing = measure([] {}, [&] {
+            MeshCache cache;
+            if (!cache.open(cachePath.c_str(), objPath)) {
+                opened = false;
+                return;
+            }
+            MeshView view = cache.view();
+            float sum = 0.0f;
+            for (size_t i = 0; i < view.vertexCount * 3; i += 1024)
+                sum += view.vertices[i];
+            for (size_t i = 0; i < view.indexCount; i += 1024)
+                sum += static_cast<float>(view.indices[i]);
+            sink = sum;
+        });
+        (void)sink;
+        if (opened)
+            printRow("cache read", gridTriangles, timing);
+        else
+            std::cerr << "Failed to open " << cachePath << std::endl;
+    }
+    std::remove(cachePath.c_str());
+    std::remove(objPath);
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --max-triangles <count>  largest synthetic mesh (default 1000000; up to 100000000)\n"
+              << "  --stage <name>           only stages whose name contains this text\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t maxTriangles = 1000000;
+    const char* filter = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(argv[i], "--max-triangles") == 0 && value) {
+            char* end = nullptr;
+            maxTriangles = static_cast<size_t>(std::strtoull(value, &end, 10));
+            if (end == value || *end != '\0' || maxTriangles < 1000) {
+                printUsage(argv[0]);
+                return -1;
+            }
+            i++;
+        }
+        else if (std::strcmp(argv[i], "--stage") == 0 && value) {
+            filter = value;
+            i++;
+        }
+        else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    std::cout << ThreadPool::shared().threadCount() << " worker threads" << std::endl;
+    printHeader();
+    for (size_t triangles = 1000; triangles <= maxTriangles; triangles *= 10)
+        benchmarkSize(triangles, filter);
+    return 0;
+}
@@ -0,0 +1,344 @@
+#include "obj_loader.h"
+#include "edge_builder.h"
+#include "mapped_file.h"
+#include "scratch_arena.h"
+#include "thread_pool.h"
+#include "triangulation.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+inline bool isLineEnd(char c) {
+    return c == '\n' || c == '\r';
+}
+
+const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p))
+        ++p;
+    return p;
+}
+
+const char* skipLine(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+const char* parseFloat(const char* p, const char* end, float& value) {
+    p = skipBlanks(p, end);
+    // from_chars does not accept an explicit plus sign.
+    if (p < end && *p == '+')
+        ++p;
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        value = 0.0f;
+        return p;
+    }
+    return result.ptr;
+}
+
+// Parses one "v", "v/vt", "v//vn" or "v/vt/vn" token and returns the
+// position index. Positive indices are made zero-based; negative ones are
+// resolved against the chunk's own vertex count and flagged as relative so
+// the chunk's global vertex base can be added after all chunks are parsed.
+const char* parseFaceIndex(const char* p, const char* end, size_t localVertexCount,
+                           bool& valid, bool& relative, unsigned int& index) {
+    long long value = 0;
+    auto result = std::from_chars(p, end, value);
+    valid = result.ec == std::errc() && value != 0;
+    relative = value < 0;
+    // Indices past 2^32 in either direction would wrap onto a real vertex
+    // when narrowed; they become one no vertex array reaches, so the face
+    // is skipped and reported with the other out-of-range faces
+    const long long indexLimit = std::numeric_limits<unsigned int>::max();
+    if (valid && (value - 1 >= indexLimit || value <= -indexLimit)) {
+        relative = false;
+        index = std::numeric_limits<unsigned int>::max();
+    }
+    else if (valid) {
+        // Relative indices may point into an earlier chunk, so they are kept
+        // modulo 2^32 and only become meaningful once the base is added.
+        long long resolved = value > 0 ? value - 1 : static_cast<long long>(localVertexCount) + value;
+        index = static_cast<unsigned int>(resolved);
+    }
+
+    p = result.ptr;
+    while (p < end && !isBlank(*p) && !isLineEnd(*p))
+        ++p;
+    return p;
+}
+
+// Faces whose indices fall outside the vertex array are marked in their
+// size entry and skipped when emitting triangles and edges.
+const unsigned int invalidFaceBit = 0x80000000u;
+
+// Parse results for one newline-aligned slice of the file.
+struct ObjChunk {
+    explicit ObjChunk(ScratchArena* scratch)
+        : vertices(scratch), faceIndices(scratch), faceSizes(scratch), relativeSlots(scratch), edgeKeys(scratch) {}
+
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    ScratchVector<float> vertices;
+    ScratchVector<unsigned int> faceIndices;
+    ScratchVector<unsigned int> faceSizes;
+    ScratchVector<size_t> relativeSlots;
+    ScratchVector<uint64_t> edgeKeys;
+
+    size_t vertexBase = 0;
+    size_t triangleCount = 0;
+    size_t triangleBase = 0;
+
+    glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+};
+
+// Counts vertex lines, face lines and face index tokens so parseChunk can
+// size its arrays once instead of growing them line by line.
+void reserveChunk(ObjChunk& chunk) {
+    size_t vertexLines = 0, faceLines = 0, faceTokens = 0;
+    const char* p = chunk.begin;
+    const char* end = chunk.end;
+
+    while (p < end) {
+        p = skipBlanks(p, end);
+
+        if (end - p >= 2 && p[0] == 'v' && isBlank(p[1])) {
+            vertexLines++;
+        }
+        else if (end - p >= 2 && p[0] == 'f' && isBlank(p[1])) {
+            faceLines++;
+            for (++p; p < end && !isLineEnd(*p) && *p != '#';) {
+                p = skipBlanks(p, end);
+                if (p < end && !isLineEnd(*p) && *p != '#')
+                    faceTokens++;
+                while (p < end && !isBlank(*p) && !isLineEnd(*p))
+                    ++p;
+            }
+        }
+
+        p = skipLine(p, end);
+    }
+
+    chunk.vertices.reserve(vertexLines * 3);
+    chunk.faceSizes.reserve(faceLines);
+    chunk.faceIndices.reserve(faceTokens);
+}
+
+void parseChunk(ObjChunk& chunk) {
+    reserveChunk(chunk);
+
+    const char* p = chunk.begin;
+    const char* end = chunk.end;
+
+    while (p < end) {
+        p = skipBlanks(p, end);
+
+        if (end - p >= 2 && p[0] == 'v' && isBlank(p[1])) {
+            float x, y, z;
+            p = parseFloat(p + 1, end, x);
+            p = parseFloat(p, end, y);
+            p = parseFloat(p, end, z);
+            chunk.vertices.push_back(x);
+            chunk.vertices.push_back(y);
+            chunk.vertices.push_back(z);
+        }
+        else if (end - p >= 2 && p[0] == 'f' && isBlank(p[1])) {
+            size_t localVertexCount = chunk.vertices.size() / 3;
+            size_t first = chunk.faceIndices.size();
+
+            p = skipBlanks(p + 1, end);
+            while (p < end && !isLineEnd(*p) && *p != '#') {
+                bool valid, relative;
+                unsigned int index;
+                p = parseFaceIndex(p, end, localVertexCount, valid, relative, index);
+                if (valid) {
+                    if (relative)
+                        chunk.relativeSlots.push_back(chunk.faceIndices.size());
+                    chunk.faceIndices.push_back(index);
+                }
+                p = skipBlanks(p, end);
+            }
+
+            chunk.faceSizes.push_back(static_cast<unsigned int>(chunk.faceIndices.size() - first));
+        }
+
+        p = skipLine(p, end);
+    }
+}
+
+// Makes every index in the chunk global and checks it against the total
+// vertex count, counting the triangles the valid faces will produce.
+void resolveChunk(ObjChunk& chunk, size_t totalVertices) {
+    for (size_t slot : chunk.relativeSlots)
+        chunk.faceIndices[slot] += static_cast<unsigned int>(chunk.vertexBase);
+
+    size_t offset = 0;
+    for (unsigned int& size : chunk.faceSizes) {
+        const unsigned int* face = chunk.faceIndices.data() + offset;
+        offset += size;
+
+        bool inRange = true;
+        for (unsigned int i = 0; i < size; i++)
+            inRange = inRange && face[i] < totalVertices;
+
+        if (!inRange)
+            size |= invalidFaceBit;
+        else if (size >= 3)
+            chunk.triangleCount += size - 2;
+    }
+}
+
+void collectChunkEdges(ObjChunk& chunk) {
+    chunk.edgeKeys.reserve(chunk.faceIndices.size());
+
+    size_t offset = 0;
+    for (unsigned int size : chunk.faceSizes) {
+        const unsigned int* face = chunk.faceIndices.data() + offset;
+        offset += size & ~invalidFaceBit;
+        if (size & invalidFaceBit)
+            continue;
+        appendFaceEdges(face, size, chunk.edgeKeys);
+    }
+
+    // Neighbouring faces share most of their edges, so deduplicating per
+    // chunk first roughly halves what the merge has to touch.
+    sortUniqueEdges(chunk.edgeKeys);
+}
+
+void emitChunkTriangles(const ObjChunk& chunk, const float* positions, unsigned int* out) {
+    TriangulationScratch scratch(chunk.edgeKeys.get_allocator().arena());
+    size_t offset = 0;
+    for (unsigned int size : chunk.faceSizes) {
+        const unsigned int* face = chunk.faceIndices.data() + offset;
+        offset += size & ~invalidFaceBit;
+        if ((size & invalidFaceBit) || size < 3)
+            continue;
+
+        triangulatePolygon(positions, face, size, out, scratch);
+        out += (size - 2) * 3;
+    }
+}
+
+// Splits [data, data + size) into roughly equal pieces that each end just
+// after a newline, so no line straddles two chunks.
+std::vector<ObjChunk> splitChunks(const char* data, size_t size, size_t chunkCount, ScratchArena* scratch) {
+    std::vector<ObjChunk> chunks;
+    const char* end = data + size;
+    const char* begin = data;
+
+    for (size_t i = 1; i <= chunkCount && begin < end; i++) {
+        const char* split = i == chunkCount ? end : skipLine(data + size / chunkCount * i, end);
+        if (split <= begin)
+            continue;
+
+        ObjChunk chunk(scratch);
+        chunk.begin = begin;
+        chunk.end = split;
+        chunks.push_back(std::move(chunk));
+        begin = split;
+    }
+    return chunks;
+}
+
+// Slices smaller than this are not worth handing to another thread.
+const size_t minChunkBytes = 1 << 20;
+
+}
+
+Mesh loadOBJ(const char* path, const ObjLoadOptions& options, ObjLoadStats* stats) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    Mesh mesh;
+    mesh.color = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open OBJ file: " << path << std::endl;
+        return mesh;
+    }
+
+    // Several chunks per thread keep the workers busy when the density of
+    // faces varies across the file.
+    ThreadPool& pool = ThreadPool::shared();
+    size_t maxChunks = static_cast<size_t>(pool.threadCount()) * 4;
+    size_t chunkCount = std::max<size_t>(1, std::min(maxChunks, file.size() / minChunkBytes));
+    std::vector<ObjChunk> chunks = splitChunks(file.data(), file.size(), chunkCount, options.scratch);
+
+    pool.parallelFor(chunks.size(), [&](size_t i) { parseChunk(chunks[i]); });
+
+    size_t totalVertices = 0;
+    for (ObjChunk& chunk : chunks) {
+        chunk.vertexBase = totalVertices;
+        totalVertices += chunk.vertices.size() / 3;
+    }
+
+    pool.parallelFor(chunks.size(), [&](size_t i) { resolveChunk(chunks[i], totalVertices); });
+
+    size_t totalTriangles = 0;
+    size_t invalidFaces = 0;
+    for (ObjChunk& chunk : chunks) {
+        chunk.triangleBase = totalTriangles;
+        totalTriangles += chunk.triangleCount;
+        for (unsigned int size : chunk.faceSizes)
+            invalidFaces += (size & invalidFaceBit) ? 1 : 0;
+    }
+    if (invalidFaces > 0)
+        std::cerr << "Skipped " << invalidFaces << " faces with out-of-range indices in " << path << std::endl;
+
+    mesh.vertices.resize(totalVertices * 3);
+    mesh.indices.resize(totalTriangles * 3);
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        ObjChunk& chunk = chunks[i];
+        for (size_t v = 0; v < chunk.vertices.size(); v += 3) {
+            glm::vec3 position(chunk.vertices[v], chunk.vertices[v + 1], chunk.vertices[v + 2]);
+            chunk.boundsMin = glm::min(chunk.boundsMin, position);
+            chunk.boundsMax = glm::max(chunk.boundsMax, position);
+        }
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(), mesh.vertices.begin() + chunk.vertexBase * 3);
+        chunk.vertices.clear();
+        chunk.vertices.shrink_to_fit();
+    });
+    if (totalVertices > 0) {
+        mesh.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        mesh.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        for (const ObjChunk& chunk : chunks) {
+            mesh.boundsMin = glm::min(mesh.boundsMin, chunk.boundsMin);
+            mesh.boundsMax = glm::max(mesh.boundsMax, chunk.boundsMax);
+        }
+    }
+
+    // Concave faces need positions from any chunk, so triangulation waits
+    // until every vertex is in place.
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        const ObjChunk& chunk = chunks[i];
+        emitChunkTriangles(chunk, mesh.vertices.data(), mesh.indices.data() + chunk.triangleBase * 3);
+    });
+
+    if (options.buildEdges) {
+        pool.parallelFor(chunks.size(), [&](size_t i) { collectChunkEdges(chunks[i]); });
+
+        std::vector<ScratchVector<uint64_t>> runs;
+        runs.reserve(chunks.size());
+        for (ObjChunk& chunk : chunks)
+            runs.push_back(std::move(chunk.edgeKeys));
+        mesh.edgeIndices = edgeIndicesFromKeys(mergeEdgeRuns(runs, pool));
+    }
+
+    if (stats) {
+        stats->bytes = file.size();
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        stats->threads = pool.threadCount();
+        stats->chunks = chunks.size();
+    }
+    return mesh;
+}
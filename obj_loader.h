@@ -0,0 +1,31 @@
+#pragma once
+#include "mesh.h"
+#include <cstddef>
+
+class ScratchArena;
+
+struct ObjLoadOptions {
+    // Unique polygon edges for the outline pass. Leave off when outlines
+    // are not drawn; buildTriangleEdges can still produce them later.
+    bool buildEdges = true;
+    // Where the per-chunk parse, triangulation and edge arrays go; the
+    // heap when null. Only the returned mesh outlives the call.
+    ScratchArena* scratch = nullptr;
+};
+
+// Timing of a single loadOBJ call.
+struct ObjLoadStats {
+    size_t bytes = 0;
+    double seconds = 0.0;
+    unsigned int threads = 1;
+    size_t chunks = 0;
+
+    double megabytesPerSecond() const {
+        return seconds > 0.0 ? (bytes / (1024.0 * 1024.0)) / seconds : 0.0;
+    }
+};
+
+// Parses the positions and faces of a Wavefront OBJ file in place from a
+// memory mapping. Large files are split at line boundaries and parsed on
+// the shared thread pool. Returns an empty mesh if the file cannot be opened.
+Mesh loadOBJ(const char* path, const ObjLoadOptions& options = ObjLoadOptions(), ObjLoadStats* stats = nullptr);
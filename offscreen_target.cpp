@@ -0,0 +1,45 @@
+#include "offscreen_target.h"
+#include <glad/glad.h>
+#include <iostream>
+
+bool OffscreenTarget::create(int width, int height) {
+    destroy();
+    width_ = width;
+    height_ = height;
+
+    glGenRenderbuffers(1, &colorBuffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthBuffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer_);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cerr << "Offscreen framebuffer " << width << "x" << height << " is incomplete" << std::endl;
+        destroy();
+    }
+    return complete;
+}
+
+void OffscreenTarget::destroy() {
+    if (framebuffer_)
+        glDeleteFramebuffers(1, &framebuffer_);
+    if (colorBuffer_)
+        glDeleteRenderbuffers(1, &colorBuffer_);
+    if (depthBuffer_)
+        glDeleteRenderbuffers(1, &depthBuffer_);
+    framebuffer_ = colorBuffer_ = depthBuffer_ = 0;
+    width_ = height_ = 0;
+}
+
+void OffscreenTarget::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, width_, height_);
+}
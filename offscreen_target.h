@@ -0,0 +1,25 @@
+#pragma once
+
+// Framebuffer object with an RGBA8 colour and a 24-bit depth renderbuffer,
+// for rendering at a fixed resolution without presenting to the window.
+class OffscreenTarget {
+public:
+    // Returns false if the driver reports the framebuffer incomplete.
+    bool create(int width, int height);
+    void destroy();
+
+    // Binds the framebuffer for drawing and reading, with a viewport
+    // covering it.
+    void bind() const;
+
+    unsigned int framebuffer() const { return framebuffer_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    unsigned int framebuffer_ = 0;
+    unsigned int colorBuffer_ = 0;
+    unsigned int depthBuffer_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+};
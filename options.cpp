@@ -0,0 +1,295 @@
+#include "options.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+const char* outlineModeName(OutlineMode mode) {
+    switch (mode) {
+    case OutlineMode::TwoPass: return "two-pass";
+    case OutlineMode::SinglePass: return "single-pass";
+    case OutlineMode::Off: return "off";
+    }
+    return "unknown";
+}
+
+const char* pacingModeName(PacingMode mode) {
+    switch (mode) {
+    case PacingMode::Vsync: return "vsync";
+    case PacingMode::Uncapped: return "uncapped";
+    case PacingMode::Capped: return "capped";
+    }
+    return "unknown";
+}
+
+const char* cameraPathName(CameraPath path) {
+    switch (path) {
+    case CameraPath::Spin: return "spin";
+    case CameraPath::Tumble: return "tumble";
+    case CameraPath::Orbit: return "orbit";
+    }
+    return "unknown";
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [mesh.obj...]\n"
+              << "  --copies <count>                      instances of each mesh, on a grid (default 1)\n"
+              << "  --animate <count>                     spin this many instances about their own centres\n"
+              << "  --outline <two-pass|single-pass|off>  outline rendering (default two-pass)\n"
+              << "  --line-width <pixels>                 outline width (default 3)\n"
+              << "  --no-indirect                         one draw per mesh instead of multi-draw indirect\n"
+              << "  --cull <cpu|gpu|off>                  frustum culling (default cpu; gpu needs OpenGL 4.3)\n"
+              << "  --lod-error <pixels>                  screen error allowed when picking LODs, 0 disables (default 1)\n"
+              << "  --occlusion                           Hi-Z occlusion culling, with --cull gpu\n"
+              << "  --occluders <count>                   largest instances drawn as occluders (default 64)\n"
+              << "  --upload-budget <MB>                  mesh data uploaded per frame while loading (default 16)\n"
+              << "  --residency <MB>                      draw meshes out of core from streamed pages in this much GPU memory\n"
+              << "  --quantize                            store positions as 16 bits per component within each mesh's bounds\n"
+              << "  --pacing <vsync|uncapped|capped>      when window frames start (default vsync)\n"
+              << "  --frame-rate <fps>                    frame rate of --pacing capped (default 60)\n"
+              << "  --on-demand                           only draw when input arrives or the scene is changing\n"
+              << "  --shader-cache <dir|off>              keep linked shader binaries here (default shader_cache)\n"
+              << "  --profile <file.csv|file.json>        write per-frame CPU phase and GPU pass timings at exit\n"
+              << "  --profile-overlay                     start with the frame-time graph shown (P toggles)\n"
+              << "  --metrics <file.jsonl>                append live counters as JSON lines while running\n"
+              << "  --metrics-interval <seconds>          seconds between metrics lines (default 1)\n"
+              << "  --benchmark <frames>                  render this many frames offscreen with vsync off, then report timings\n"
+              << "  --resolution <width>x<height>         benchmark, software and batch image size (default 1920x1080)\n"
+              << "  --camera-path <spin|tumble|orbit>     scripted benchmark motion (default tumble)\n"
+              << "  --software <out.png>                  rasterize on the CPU without a GPU and write the image\n"
+              << "  --no-simd                             scalar software rasterizer tiles instead of AVX2\n"
+              << "  --software-threads <count>            software rasterizer threads (default one per hardware thread)\n"
+              << "  --batch <list.txt>                    render each mesh in the list to its own PNG, then exit\n"
+              << "  --batch-output <dir>                  directory for batch images (default next to each mesh)\n"
+              << "  --batch-software                      render the batch with the software rasterizer\n";
+}
+
+static bool parseCount(const char* text, size_t& value) {
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    value = static_cast<size_t>(parsed);
+    return end != text && *end == '\0' && text[0] != '-';
+}
+
+static bool parseFloat(const char* text, float& value) {
+    char* end = nullptr;
+    value = std::strtof(text, &end);
+    return end != text && *end == '\0';
+}
+
+static bool parseResolution(const char* text, int& width, int& height) {
+    char* end = nullptr;
+    long parsedWidth = std::strtol(text, &end, 10);
+    if (end == text || *end != 'x')
+        return false;
+    const char* heightText = end + 1;
+    long parsedHeight = std::strtol(heightText, &end, 10);
+    if (end == heightText || *end != '\0' || parsedWidth <= 0 || parsedHeight <= 0)
+        return false;
+    width = static_cast<int>(parsedWidth);
+    height = static_cast<int>(parsedHeight);
+    return true;
+}
+
+bool parseOptions(int argc, char** argv, AppOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (std::strcmp(arg, "--outline") == 0 && value) {
+            if (std::strcmp(value, "two-pass") == 0)
+                options.outlineMode = OutlineMode::TwoPass;
+            else if (std::strcmp(value, "single-pass") == 0)
+                options.outlineMode = OutlineMode::SinglePass;
+            else if (std::strcmp(value, "off") == 0)
+                options.outlineMode = OutlineMode::Off;
+            else {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--line-width") == 0 && value) {
+            if (!parseFloat(value, options.lineWidth) || options.lineWidth <= 0.0f) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--copies") == 0 && value) {
+            if (!parseCount(value, options.copies) || options.copies == 0) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--animate") == 0 && value) {
+            if (!parseCount(value, options.animatedInstances)) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--no-indirect") == 0) {
+            options.indirect = false;
+        }
+        else if (std::strcmp(arg, "--benchmark") == 0 && value) {
+            if (!parseCount(value, options.benchmarkFrames) || options.benchmarkFrames == 0) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--resolution") == 0 && value) {
+            if (!parseResolution(value, options.benchmarkWidth, options.benchmarkHeight)) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--camera-path") == 0 && value) {
+            if (std::strcmp(value, "spin") == 0)
+                options.cameraPath = CameraPath::Spin;
+            else if (std::strcmp(value, "tumble") == 0)
+                options.cameraPath = CameraPath::Tumble;
+            else if (std::strcmp(value, "orbit") == 0)
+                options.cameraPath = CameraPath::Orbit;
+            else {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--software") == 0 && value) {
+            options.softwareOutput = value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--no-simd") == 0) {
+            options.simd = false;
+        }
+        else if (std::strcmp(arg, "--software-threads") == 0 && value) {
+            if (!parseCount(value, options.softwareThreads) || options.softwareThreads == 0) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--batch") == 0 && value) {
+            options.batchList = value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--batch-output") == 0 && value) {
+            options.batchOutputDir = value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--batch-software") == 0) {
+            options.batchSoftware = true;
+        }
+        else if (std::strcmp(arg, "--profile") == 0 && value) {
+            options.profilePath = value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--profile-overlay") == 0) {
+            options.profileOverlay = true;
+        }
+        else if (std::strcmp(arg, "--metrics") == 0 && value) {
+            options.metricsPath = value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--metrics-interval") == 0 && value) {
+            if (!parseFloat(value, options.metricsInterval) || options.metricsInterval <= 0.0f) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--occlusion") == 0) {
+            options.occlusion = true;
+        }
+        else if (std::strcmp(arg, "--occluders") == 0 && value) {
+            if (!parseCount(value, options.occluders) || options.occluders == 0) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--upload-budget") == 0 && value) {
+            size_t megabytes = 0;
+            if (!parseCount(value, megabytes) || megabytes == 0) {
+                printUsage(argv[0]);
+                return false;
+            }
+            options.uploadBudget = megabytes << 20;
+            i++;
+        }
+        else if (std::strcmp(arg, "--quantize") == 0) {
+            options.quantizePositions = true;
+        }
+        else if (std::strcmp(arg, "--pacing") == 0 && value) {
+            if (std::strcmp(value, "vsync") == 0)
+                options.pacing = PacingMode::Vsync;
+            else if (std::strcmp(value, "uncapped") == 0)
+                options.pacing = PacingMode::Uncapped;
+            else if (std::strcmp(value, "capped") == 0)
+                options.pacing = PacingMode::Capped;
+            else {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--frame-rate") == 0 && value) {
+            if (!parseFloat(value, options.frameRate) || options.frameRate <= 0.0f) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--on-demand") == 0) {
+            options.onDemand = true;
+        }
+        else if (std::strcmp(arg, "--shader-cache") == 0 && value) {
+            options.shaderCacheDir = std::strcmp(value, "off") == 0 ? nullptr : value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--residency") == 0 && value) {
+            size_t megabytes = 0;
+            if (!parseCount(value, megabytes) || megabytes == 0) {
+                printUsage(argv[0]);
+                return false;
+            }
+            options.residencyBytes = megabytes << 20;
+            i++;
+        }
+        else if (std::strcmp(arg, "--lod-error") == 0 && value) {
+            if (!parseFloat(value, options.lodError) || options.lodError < 0.0f) {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--cull") == 0 && value) {
+            if (std::strcmp(value, "cpu") == 0)
+                options.cullMode = CullMode::Cpu;
+            else if (std::strcmp(value, "gpu") == 0)
+                options.cullMode = CullMode::Gpu;
+            else if (std::strcmp(value, "off") == 0)
+                options.cullMode = CullMode::Off;
+            else {
+                printUsage(argv[0]);
+                return false;
+            }
+            i++;
+        }
+        else if (arg[0] != '-') {
+            options.meshPaths.push_back(arg);
+        }
+        else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options.meshPaths.empty())
+        options.meshPaths.push_back("prism.obj");
+    return true;
+}
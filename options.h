@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+enum class OutlineMode {
+    // Filled triangles, then GL_LINES over the edge indices with the outline variant.
+    TwoPass,
+    // One draw with a geometry shader that blends the outline into the fill.
+    SinglePass,
+    Off
+};
+
+const char* outlineModeName(OutlineMode mode);
+
+enum class CullMode {
+    // BVH over instance bounds, walked on the CPU when the view changes.
+    Cpu,
+    // Compute shader over all instances; needs a GL 4.3 context.
+    Gpu,
+    Off
+};
+
+// When the interactive window starts its frames.
+enum class PacingMode {
+    // Swap interval 1; the CPU waits for each swap so the driver never
+    // queues frames ahead of the display.
+    Vsync,
+    // Swap interval 0, as fast as the GPU allows.
+    Uncapped,
+    // Swap interval 0, one frame per 1 / frameRate seconds.
+    Capped
+};
+
+const char* pacingModeName(PacingMode mode);
+
+// Scripted motion replayed by the benchmark, one full cycle over the run.
+enum class CameraPath {
+    // Assembly turns once about Y; the camera stays put.
+    Spin,
+    // Assembly turns about Y and twice about Z, as if A and W were held.
+    Tumble,
+    // Camera circles the scene while dollying in to 60% of its distance
+    // and back, so culling and LOD selection change every frame.
+    Orbit
+};
+
+const char* cameraPathName(CameraPath path);
+
+// Command-line settings for the viewer.
+struct AppOptions {
+    // Defaults to prism.obj when no mesh is given.
+    std::vector<const char*> meshPaths;
+    // Instances of each mesh, laid out on a grid.
+    size_t copies = 1;
+    // Instances, from the first, that spin about their own centres while
+    // the rest of the scene stays put.
+    size_t animatedInstances = 0;
+    OutlineMode outlineMode = OutlineMode::TwoPass;
+    float lineWidth = 3.0f;
+    // Draw through glMultiDrawElementsIndirect when the context has it.
+    bool indirect = true;
+    // How instances outside the view frustum are skipped.
+    CullMode cullMode = CullMode::Cpu;
+    // Screen-space error in pixels an LOD may show; 0 always draws full
+    // resolution.
+    float lodError = 1.0f;
+    // Hi-Z occlusion culling against the depth of the largest instances;
+    // needs CullMode::Gpu.
+    bool occlusion = false;
+    size_t occluders = 64;
+    // Bytes of mesh data copied to the GPU per frame while a scene streams in.
+    size_t uploadBudget = 16u << 20;
+    // GPU memory for meshes drawn out of core from their page files; 0
+    // uploads every mesh whole.
+    size_t residencyBytes = 0;
+    // Keep positions as 16-bit components normalized to each mesh's
+    // bounds, in the mesh cache and on the GPU, instead of floats.
+    bool quantizePositions = false;
+    PacingMode pacing = PacingMode::Vsync;
+    float frameRate = 60.0f;
+    // Only draw when input arrives or something on screen is still
+    // changing; otherwise sleep until the next event.
+    bool onDemand = false;
+    // Directory linked shader binaries are kept in between runs; null
+    // compiles them every start.
+    const char* shaderCacheDir = "shader_cache";
+    // Per-frame CPU and GPU timings are written here at exit, as JSON when
+    // the name ends in .json and CSV otherwise.
+    const char* profilePath = nullptr;
+    // Start with the profiler overlay shown; P toggles it.
+    bool profileOverlay = false;
+    // Live counters are appended here as JSON lines, one per
+    // metricsInterval seconds; null disables them.
+    const char* metricsPath = nullptr;
+    float metricsInterval = 1.0f;
+    // Frames to render offscreen along cameraPath before printing timing
+    // percentiles and exiting; 0 opens the interactive window.
+    size_t benchmarkFrames = 0;
+    int benchmarkWidth = 1920;
+    int benchmarkHeight = 1080;
+    CameraPath cameraPath = CameraPath::Tumble;
+    // Render on the CPU into this PNG instead of opening a window; the
+    // image is benchmarkWidth x benchmarkHeight.
+    const char* softwareOutput = nullptr;
+    // Let the software rasterizer use AVX2 when the CPU has it.
+    bool simd = true;
+    // Threads the software rasterizer bins and rasterizes on; 0 uses one
+    // per hardware thread.
+    size_t softwareThreads = 0;
+    // Render every mesh listed in this file to its own PNG, one at a time
+    // at a fixed camera, and exit; meshPaths and copies are ignored.
+    const char* batchList = nullptr;
+    // Where batch images go; null writes each next to its mesh.
+    const char* batchOutputDir = nullptr;
+    // Render the batch with SoftwareRasterizer instead of OpenGL.
+    bool batchSoftware = false;
+};
+
+// Fills options from argv. Prints usage and returns false on bad arguments.
+bool parseOptions(int argc, char** argv, AppOptions& options);
@@ -0,0 +1,268 @@
+#include "page_residency.h"
+#include "staging_ring.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+GpuMesh pagedMeshInfo(const MeshPageFile& pages) {
+    const MeshPageFileHeader& header = pages.header();
+    GpuMesh mesh;
+    mesh.indexCount = static_cast<size_t>(header.triangleCount * 3);
+    mesh.edgeIndexCount = static_cast<size_t>(header.edgeIndexCount);
+    mesh.lods[0] = { 0, static_cast<uint32_t>(mesh.indexCount), 0, static_cast<uint32_t>(mesh.edgeIndexCount), 0.0f };
+    mesh.lodCount = 1;
+    mesh.color = glm::vec3(header.color[0], header.color[1], header.color[2]);
+    mesh.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    mesh.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    return mesh;
+}
+
+bool PageResidency::create(const std::vector<const MeshPageFile*>& meshes, size_t memoryBytes) {
+    destroy();
+
+    size_t maxVertices = 1, maxIndices = 0, maxEdgeIndices = 0;
+    meshFirstPage_.push_back(0);
+    for (unsigned int mesh = 0; mesh < meshes.size(); mesh++) {
+        const MeshPageFile& file = *meshes[mesh];
+        maxVertices = std::max<size_t>(maxVertices, file.header().maxVertexCount);
+        maxIndices = std::max<size_t>(maxIndices, file.header().maxIndexCount);
+        maxEdgeIndices = std::max<size_t>(maxEdgeIndices, file.header().maxEdgeIndexCount);
+        for (size_t page = 0; page < file.pageCount(); page++)
+            pages_.push_back({ mesh, &file.page(page), file.pageData(page), -1 });
+        meshFirstPage_.push_back(pages_.size());
+    }
+
+    // Slots are sized for the largest page; index storage is the page's
+    // triangle indices followed by its edge indices.
+    slotVertices_ = maxVertices;
+    slotIndices_ = std::max<size_t>(maxIndices + maxEdgeIndices, 1);
+    size_t slotBytes = slotVertices_ * 3 * sizeof(float) + slotIndices_ * sizeof(uint16_t);
+    size_t slotCount = std::max<size_t>(memoryBytes / slotBytes, 1);
+    if (slotCount > pages_.size())
+        slotCount = std::max<size_t>(pages_.size(), 1);
+
+    slots_.resize(slotCount);
+    for (size_t i = 0; i < slotCount; i++) {
+        slots_[i].prev = static_cast<int>(i) - 1;
+        slots_[i].next = i + 1 < slotCount ? static_cast<int>(i) + 1 : -1;
+    }
+    mostRecent_ = 0;
+    leastRecent_ = static_cast<int>(slotCount) - 1;
+
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vertexBuffer_);
+    glGenBuffers(1, &indexBuffer_);
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+    glBufferData(GL_ARRAY_BUFFER, slotCount * slotVertices_ * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(positionAttribute);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, slotCount * slotIndices_ * sizeof(uint16_t), nullptr, GL_DYNAMIC_DRAW);
+    glBindVertexArray(0);
+
+    stats_ = PageResidencyStats();
+    stats_.slots = slotCount;
+    stats_.memoryBytes = slotCount * slotBytes;
+    neededDistance_.assign(pages_.size(), std::numeric_limits<float>::max());
+    return true;
+}
+
+void PageResidency::destroy() {
+    if (vao_)
+        glDeleteVertexArrays(1, &vao_);
+    for (unsigned int* buffer : { &vertexBuffer_, &indexBuffer_, &commandBuffer_ }) {
+        if (*buffer)
+            glDeleteBuffers(1, buffer);
+        *buffer = 0;
+    }
+    vao_ = 0;
+    pages_.clear();
+    meshFirstPage_.clear();
+    slots_.clear();
+    needed_.clear();
+    neededDistance_.clear();
+    commands_.clear();
+    mostRecent_ = leastRecent_ = -1;
+    frame_ = 0;
+    commandsDirty_ = true;
+    stats_ = PageResidencyStats();
+}
+
+void PageResidency::selectPages(const Scene& scene, const DrawListView& view) {
+    needed_.clear();
+    Frustum sceneFrustum = frustumFromMatrix(view.viewProjection);
+    for (const InstanceBatch& batch : scene.batches) {
+        size_t firstPage = meshFirstPage_[batch.mesh];
+        size_t lastPage = meshFirstPage_[batch.mesh + 1];
+        for (size_t instance = batch.firstInstance; instance < batch.firstInstance + batch.instanceCount; instance++) {
+            if (view.frustumCull && !boxIntersectsFrustum(sceneFrustum, scene.instanceBoundsMin[instance],
+                                                           scene.instanceBoundsMax[instance]))
+                continue;
+            // Page bounds are in mesh space, so the frustum is brought there.
+            const glm::mat4& transform = scene.instanceData[instance].transform;
+            Frustum frustum = frustumFromMatrix(view.viewProjection * transform);
+            for (size_t page = firstPage; page < lastPage; page++) {
+                const MeshPage& info = *pages_[page].info;
+                glm::vec3 boundsMin(info.boundsMin[0], info.boundsMin[1], info.boundsMin[2]);
+                glm::vec3 boundsMax(info.boundsMax[0], info.boundsMax[1], info.boundsMax[2]);
+                if (view.frustumCull && !boxIntersectsFrustum(frustum, boundsMin, boundsMax))
+                    continue;
+                glm::vec3 center = glm::vec3(transform * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+                float distance = glm::length(view.eye - center);
+                if (neededDistance_[page] == std::numeric_limits<float>::max())
+                    needed_.push_back(static_cast<unsigned int>(page));
+                neededDistance_[page] = std::min(neededDistance_[page], distance);
+            }
+        }
+    }
+
+    std::sort(needed_.begin(), needed_.end(),
+              [&](unsigned int a, unsigned int b) { return neededDistance_[a] < neededDistance_[b]; });
+    for (unsigned int page : needed_)
+        neededDistance_[page] = std::numeric_limits<float>::max();
+    stats_.neededPages = needed_.size();
+    commandsDirty_ = true;
+}
+
+void PageResidency::touch(int slot) {
+    if (slot == mostRecent_)
+        return;
+    Slot& entry = slots_[slot];
+    // Unlink, then push at the front.
+    if (entry.prev >= 0)
+        slots_[entry.prev].next = entry.next;
+    if (entry.next >= 0)
+        slots_[entry.next].prev = entry.prev;
+    if (slot == leastRecent_)
+        leastRecent_ = entry.prev;
+    entry.prev = -1;
+    entry.next = mostRecent_;
+    slots_[mostRecent_].prev = slot;
+    mostRecent_ = slot;
+}
+
+void PageResidency::update(StagingRing& ring) {
+    frame_++;
+    // Touch the farthest first so the nearest end up most recently used.
+    for (auto it = needed_.rbegin(); it != needed_.rend(); ++it) {
+        int slot = pages_[*it].slot;
+        if (slot >= 0) {
+            slots_[slot].lastUsed = frame_;
+            touch(slot);
+        }
+    }
+
+    unsigned char* staging = nullptr;
+    size_t used = 0;
+    for (unsigned int page : needed_) {
+        Page& entry = pages_[page];
+        if (entry.slot >= 0)
+            continue;
+
+        size_t vertexBytes = size_t(entry.info->vertexCount) * 3 * sizeof(float);
+        size_t indexBytes = (size_t(entry.info->indexCount) + entry.info->edgeIndexCount) * sizeof(uint16_t);
+        if (used + vertexBytes + indexBytes > ring.segmentSize())
+            break;
+        // Every slot holds a page this frame needs.
+        int slot = leastRecent_;
+        if (slots_[slot].page >= 0 && slots_[slot].lastUsed == frame_)
+            break;
+        if (!staging && !(staging = ring.beginSegment()))
+            break;
+
+        if (slots_[slot].page >= 0) {
+            pages_[slots_[slot].page].slot = -1;
+            stats_.evictions++;
+        }
+        std::memcpy(staging + used, entry.data, vertexBytes + indexBytes);
+        ring.copy(used, vertexBuffer_, slot * slotVertices_ * 3 * sizeof(float), vertexBytes);
+        ring.copy(used + vertexBytes, indexBuffer_, slot * slotIndices_ * sizeof(uint16_t), indexBytes);
+        used += vertexBytes + indexBytes;
+
+        slots_[slot].page = static_cast<int>(page);
+        slots_[slot].lastUsed = frame_;
+        entry.slot = slot;
+        touch(slot);
+        stats_.loads++;
+        stats_.bytesStreamed += vertexBytes + indexBytes;
+        commandsDirty_ = true;
+    }
+    if (staging)
+        ring.endSegment();
+}
+
+void PageResidency::buildCommands(const Scene& scene) {
+    commands_.clear();
+    stats_.residentNeeded = 0;
+    for (int edges = 0; edges < 2; edges++) {
+        if (edges)
+            edgeCommandsStart_ = commands_.size();
+        for (unsigned int page : needed_) {
+            const Page& entry = pages_[page];
+            if (entry.slot < 0)
+                continue;
+            stats_.residentNeeded += !edges;
+            unsigned int count = edges ? entry.info->edgeIndexCount : entry.info->indexCount;
+            if (count == 0)
+                continue;
+            unsigned int firstIndex = static_cast<unsigned int>(entry.slot * slotIndices_ + (edges ? entry.info->indexCount : 0));
+            unsigned int baseVertex = static_cast<unsigned int>(entry.slot * slotVertices_);
+            for (const InstanceBatch& batch : scene.drawBatches) {
+                if (batch.mesh == entry.mesh) {
+                    commands_.push_back({ count, static_cast<unsigned int>(batch.instanceCount), firstIndex, baseVertex,
+                                          static_cast<unsigned int>(batch.firstInstance) });
+                }
+            }
+        }
+    }
+
+    if (scene.indirect && !commands_.empty()) {
+        if (!commandBuffer_)
+            glGenBuffers(1, &commandBuffer_);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer_);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands_.size() * sizeof(DrawElementsIndirectCommand),
+                     commands_.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    commandsDirty_ = false;
+}
+
+size_t PageResidency::draw(const Scene& scene, ScenePass pass) {
+    if (commandsDirty_)
+        buildCommands(scene);
+
+    bool edges = pass == ScenePass::Edges;
+    size_t first = edges ? edgeCommandsStart_ : 0;
+    size_t count = edges ? commands_.size() - edgeCommandsStart_ : edgeCommandsStart_;
+    if (count == 0)
+        return 0;
+
+    GLenum mode = edges ? GL_LINES : GL_TRIANGLES;
+    if (scene.indirect) {
+        bindInstanceAttributes(vao_, scene.instanceBuffer, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer_);
+        glMultiDrawElementsIndirect(mode, GL_UNSIGNED_SHORT, (void*)(first * sizeof(DrawElementsIndirectCommand)),
+                                    static_cast<GLsizei>(count), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return 1;
+    }
+
+    // Without a base instance the instance attributes are re-pointed
+    // whenever the batch changes.
+    size_t boundInstance = std::numeric_limits<size_t>::max();
+    for (size_t i = first; i < first + count; i++) {
+        const DrawElementsIndirectCommand& command = commands_[i];
+        if (command.baseInstance != boundInstance) {
+            bindInstanceAttributes(vao_, scene.instanceBuffer, command.baseInstance);
+            boundInstance = command.baseInstance;
+        }
+        glDrawElementsInstancedBaseVertex(mode, static_cast<GLsizei>(command.count), GL_UNSIGNED_SHORT,
+                                          (void*)(size_t(command.firstIndex) * sizeof(uint16_t)),
+                                          static_cast<GLsizei>(command.instanceCount),
+                                          static_cast<GLint>(command.baseVertex));
+    }
+    return count;
+}
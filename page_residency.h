@@ -0,0 +1,97 @@
+#pragma once
+#include "mesh_pages.h"
+#include "scene.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class StagingRing;
+
+struct PageResidencyStats {
+    size_t slots = 0;
+    size_t memoryBytes = 0;
+    // Pages the current view needs, and how many of them are resident.
+    size_t neededPages = 0;
+    size_t residentNeeded = 0;
+    // Since create.
+    size_t loads = 0;
+    size_t evictions = 0;
+    size_t bytesStreamed = 0;
+};
+
+// Description of a paged mesh for the scene: bounds, colour and a single
+// full-resolution level. Its geometry never enters the scene's pool.
+GpuMesh pagedMeshInfo(const MeshPageFile& pages);
+
+// Fixed-size GPU cache of mesh pages for meshes drawn out of core. Memory
+// is split into equal slots, each holding one page's vertices and 16-bit
+// indices. Pages the view needs are streamed into slots through a
+// StagingRing, nearest first; when no slot is free the least recently
+// needed page is evicted. GPU memory stays at the size given to create no
+// matter how large the meshes are, and only the pages that were needed
+// are ever read from their files.
+class PageResidency {
+public:
+    // meshes[i] holds the pages of scene mesh i and must outlive the
+    // residency.
+    bool create(const std::vector<const MeshPageFile*>& meshes, size_t memoryBytes);
+    void destroy();
+
+    // Rebuilds the needed pages: those of every instance in view whose
+    // bounds intersect the frustum, ordered by distance to the eye. Only
+    // needs calling when the view changes.
+    void selectPages(const Scene& scene, const DrawListView& view);
+
+    // Marks the needed pages as used this frame and streams missing ones
+    // through one segment of ring. Evicts only pages not needed this
+    // frame, so with too few slots the farthest pages stay out.
+    void update(StagingRing& ring);
+
+    // Draws the needed pages that are resident, once per draw batch of
+    // their mesh, with the bound program. Returns the draw calls issued.
+    size_t draw(const Scene& scene, ScenePass pass);
+
+    const PageResidencyStats& stats() const { return stats_; }
+
+private:
+    struct Page {
+        unsigned int mesh;
+        const MeshPage* info;
+        const unsigned char* data;
+        int slot;
+    };
+    // Slots form a doubly linked list from most to least recently used.
+    struct Slot {
+        int page = -1;
+        uint64_t lastUsed = 0;
+        int prev = -1;
+        int next = -1;
+    };
+    void touch(int slot);
+    void buildCommands(const Scene& scene);
+
+    // Pages of mesh m are pages_[meshFirstPage_[m]] up to meshFirstPage_[m + 1].
+    std::vector<Page> pages_;
+    std::vector<size_t> meshFirstPage_;
+    std::vector<Slot> slots_;
+    int mostRecent_ = -1;
+    int leastRecent_ = -1;
+    uint64_t frame_ = 0;
+    std::vector<unsigned int> needed_;
+    std::vector<float> neededDistance_;
+
+    unsigned int vao_ = 0;
+    unsigned int vertexBuffer_ = 0;
+    unsigned int indexBuffer_ = 0;
+    unsigned int commandBuffer_ = 0;
+    size_t slotVertices_ = 0;
+    size_t slotIndices_ = 0;
+
+    // Draw commands for the resident needed pages, triangles then edges,
+    // rebuilt when residency or the needed pages change.
+    std::vector<DrawElementsIndirectCommand> commands_;
+    size_t edgeCommandsStart_ = 0;
+    bool commandsDirty_ = true;
+
+    PageResidencyStats stats_;
+};
@@ -0,0 +1,155 @@
+#include "program_cache.h"
+#include "mapped_file.h"
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const char programMagic[8] = { 'S', 'R', 'P', 'R', 'O', 'G', '\0', '\0' };
+const uint32_t programVersion = 1;
+
+struct ProgramFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t binaryFormat;
+    // Hash of the sources and driver, repeated from the file name.
+    uint64_t key;
+    uint64_t binaryLength;
+};
+
+uint64_t fnv1a(const std::string& text, uint64_t hash) {
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    // Separates the strings, so moving text between them changes the key
+    hash ^= 0xff;
+    return hash * 1099511628211ull;
+}
+
+std::string glString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+}
+
+void ProgramCache::open(const char* directory) {
+    directory_.clear();
+    loaded_ = 0;
+    compiled_ = 0;
+    if (!directory)
+        return;
+    if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+        return;
+    int formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0)
+        return;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Failed to create shader cache directory: " << directory << std::endl;
+        return;
+    }
+    directory_ = directory;
+    driver_ = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+}
+
+ShaderProgram ProgramCache::link(const std::string& vertexSource, const std::string& fragmentSource,
+                                 const std::string& geometrySource) {
+    const char* geometry = geometrySource.empty() ? nullptr : geometrySource.c_str();
+    ShaderProgram program;
+    if (!enabled()) {
+        program = linkShaderProgram(vertexSource.c_str(), fragmentSource.c_str(), geometry);
+        compiled_++;
+        return program;
+    }
+
+    uint64_t key = 14695981039346656037ull;
+    const std::string* texts[] = { &driver_, &vertexSource, &fragmentSource, &geometrySource };
+    for (const std::string* text : texts)
+        key = fnv1a(*text, key);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.srprog", static_cast<unsigned long long>(key));
+    std::string path = (std::filesystem::path(directory_) / name).string();
+
+    program.id = glCreateProgram();
+    if (load(path, key, program.id)) {
+        loaded_++;
+    }
+    else {
+        glDeleteProgram(program.id);
+        program.id = createShaderProgram(vertexSource.c_str(), fragmentSource.c_str(), geometry, true);
+        compiled_++;
+        if (programLinked(program.id))
+            store(path, key, program.id);
+    }
+    resolveProgramInterface(program);
+    return program;
+}
+
+bool ProgramCache::load(const std::string& path, uint64_t key, unsigned int program) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    ProgramFileHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, programMagic, sizeof(programMagic)) != 0
+        || header.version != programVersion || header.key != key || header.binaryLength == 0
+        || header.binaryLength > (64u << 20))
+        return false;
+    std::vector<char> binary(static_cast<size_t>(header.binaryLength));
+    in.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (!in)
+        return false;
+
+    // Drivers may refuse binaries from an older build of themselves; the
+    // caller then compiles and overwrites the file.
+    glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+    return programLinked(program);
+}
+
+void ProgramCache::store(const std::string& path, uint64_t key, unsigned int program) {
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+
+    ProgramFileHeader header = {};
+    std::memcpy(header.magic, programMagic, sizeof(programMagic));
+    header.version = programVersion;
+    header.binaryFormat = format;
+    header.key = key;
+    header.binaryLength = static_cast<uint64_t>(written);
+
+    // Written aside and renamed, so a crash never leaves half a binary
+    std::string tempPath = temporaryPathFor(path.c_str());
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), written);
+        if (!out) {
+            out.close();
+            std::remove(tempPath.c_str());
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error)
+        std::remove(tempPath.c_str());
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "shader_program.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Linked program binaries kept on disk, so startups after the first skip
+// compiling and linking. Each program is stored in its own file named by
+// a hash of its sources and the driver's vendor, renderer and version, so
+// a driver update or an edited shader simply misses. A binary the driver
+// rejects is compiled from source and stored again.
+class ProgramCache {
+public:
+    // Needs a current context. A null directory, or a context without
+    // binary formats, compiles every program.
+    void open(const char* directory);
+    bool enabled() const { return !directory_.empty(); }
+
+    // Like linkShaderProgram, from the cache when it holds the program.
+    ShaderProgram link(const std::string& vertexSource, const std::string& fragmentSource,
+                       const std::string& geometrySource = std::string());
+
+    // Programs loaded from binaries and compiled from source so far.
+    size_t loaded() const { return loaded_; }
+    size_t compiled() const { return compiled_; }
+
+private:
+    bool load(const std::string& path, uint64_t key, unsigned int program);
+    void store(const std::string& path, uint64_t key, unsigned int program);
+
+    std::string directory_;
+    std::string driver_;
+    size_t loaded_ = 0;
+    size_t compiled_ = 0;
+};
@@ -0,0 +1,78 @@
+#include "readback_ring.h"
+#include <glad/glad.h>
+#include <cstring>
+#include <iostream>
+
+void ReadbackRing::create(int width, int height) {
+    destroy();
+    width_ = width;
+    height_ = height;
+
+    // GL_STREAM_READ: written by the GPU once, read by the CPU once
+    size_t bytes = static_cast<size_t>(width) * height * 4;
+    glGenBuffers(slotCount, buffers_);
+    for (unsigned int buffer : buffers_) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void ReadbackRing::destroy() {
+    for (void*& fence : fences_) {
+        if (fence)
+            glDeleteSync(static_cast<GLsync>(fence));
+        fence = nullptr;
+    }
+    if (buffers_[0])
+        glDeleteBuffers(slotCount, buffers_);
+    for (unsigned int& buffer : buffers_)
+        buffer = 0;
+    oldest_ = 0;
+    count_ = 0;
+}
+
+void ReadbackRing::read(size_t tag) {
+    int slot = (oldest_ + count_) % slotCount;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers_[slot]);
+    // With a pack buffer bound the last argument is an offset into it, and
+    // the call returns as soon as the copy is queued
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // Get the commands to the GPU now rather than when the fence is polled
+    glFlush();
+    tags_[slot] = tag;
+    count_++;
+}
+
+bool ReadbackRing::oldestReady() {
+    GLsync sync = static_cast<GLsync>(fences_[oldest_]);
+    return glClientWaitSync(sync, 0, 0) != GL_TIMEOUT_EXPIRED;
+}
+
+bool ReadbackRing::takeOldest(uint32_t* pixels) {
+    GLsync sync = static_cast<GLsync>(fences_[oldest_]);
+    GLenum status = glClientWaitSync(sync, 0, 0);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    glDeleteSync(sync);
+    fences_[oldest_] = nullptr;
+
+    size_t bytes = static_cast<size_t>(width_) * height_ * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers_[oldest_]);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    bool mapped = data != nullptr;
+    if (mapped) {
+        std::memcpy(pixels, data, bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else {
+        std::cerr << "Failed to map readback buffer" << std::endl;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    oldest_ = (oldest_ + 1) % slotCount;
+    count_--;
+    return mapped;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Pixel pack buffers that glReadPixels copies frames into without waiting
+// for them, one per readback in flight. Each copy is fenced; its buffer is
+// mapped once the fence has signalled, so reading the pixels back never
+// stalls the GPU on frames queued behind it. Readbacks complete in the
+// order they were started.
+class ReadbackRing {
+public:
+    static const int slotCount = 3;
+
+    // Buffers hold width x height RGBA8 pixels.
+    void create(int width, int height);
+    void destroy();
+
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == slotCount; }
+
+    // Queues a copy of the bound read framebuffer's colour into the next
+    // free buffer and fences it. tag comes back from oldestTag(). Only
+    // call when not full().
+    void read(size_t tag);
+
+    size_t oldestTag() const { return tags_[oldest_]; }
+    // True once the oldest copy has finished. Never blocks.
+    bool oldestReady();
+    // Waits for the oldest copy, copies its pixels into pixels (rows
+    // bottom first, width apart) and frees its buffer. Returns false if
+    // the buffer could not be mapped.
+    bool takeOldest(uint32_t* pixels);
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    unsigned int buffers_[slotCount] = {};
+    void* fences_[slotCount] = {};
+    size_t tags_[slotCount] = {};
+    int oldest_ = 0;
+    int count_ = 0;
+};
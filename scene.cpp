@@ -0,0 +1,483 @@
+#include "scene.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+bool multiDrawIndirectSupported() {
+    return GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect;
+}
+
+void transformBounds(const GpuMesh& mesh, const glm::mat4& transform, glm::vec3& boundsMin, glm::vec3& boundsMax) {
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 local((corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x,
+                        (corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+                        (corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+        glm::vec3 world = glm::vec3(transform * glm::vec4(local, 1.0f));
+        boundsMin = glm::min(boundsMin, world);
+        boundsMax = glm::max(boundsMax, world);
+    }
+}
+
+std::vector<DrawElementsIndirectCommand> buildDrawCommands(const Scene& scene, const std::vector<InstanceBatch>& batches) {
+    std::vector<DrawElementsIndirectCommand> commands;
+    commands.reserve(batches.size() * 2);
+    for (const InstanceBatch& batch : batches) {
+        const GpuMesh& mesh = scene.meshes[batch.mesh];
+        const MeshLod& lod = mesh.lods[batch.lod];
+        commands.push_back({ lod.indexCount,
+                             static_cast<unsigned int>(batch.instanceCount),
+                             static_cast<unsigned int>(mesh.firstIndex + lod.firstIndex),
+                             static_cast<unsigned int>(mesh.baseVertex),
+                             static_cast<unsigned int>(batch.firstInstance) });
+    }
+    for (const InstanceBatch& batch : batches) {
+        const GpuMesh& mesh = scene.meshes[batch.mesh];
+        const MeshLod& lod = mesh.lods[batch.lod];
+        commands.push_back({ lod.edgeIndexCount,
+                             static_cast<unsigned int>(batch.instanceCount),
+                             static_cast<unsigned int>(mesh.firstEdgeIndex + lod.firstEdgeIndex),
+                             static_cast<unsigned int>(mesh.baseVertex),
+                             static_cast<unsigned int>(batch.firstInstance) });
+    }
+    return commands;
+}
+
+// Unchanged instances between two changed ones that are written through
+// rather than starting another sub-range upload.
+static const size_t maxUploadGap = 16;
+
+static bool sameInstance(const InstanceData& a, const InstanceData& b) {
+    return std::memcmp(&a, &b, sizeof(InstanceData)) == 0;
+}
+
+static bool sameBatches(const std::vector<InstanceBatch>& a, const std::vector<InstanceBatch>& b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].mesh != b[i].mesh || a[i].lod != b[i].lod || a[i].firstInstance != b[i].firstInstance
+            || a[i].instanceCount != b[i].instanceCount)
+            return false;
+    }
+    return true;
+}
+
+// Uploads instances and the commands for scene.drawBatches, writing only
+// what differs from the previous upload. The buffer is sized for every
+// instance, so no draw list outgrows it. Returns the bytes written.
+static size_t uploadDrawList(Scene& scene, const std::vector<InstanceData>& instances) {
+    size_t bytes = 0;
+    if (!scene.instanceBuffer)
+        glGenBuffers(1, &scene.instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, scene.instanceBuffer);
+    if (instances.size() > scene.instanceCapacity) {
+        scene.instanceCapacity = std::max(instances.size(), scene.instanceData.size());
+        glBufferData(GL_ARRAY_BUFFER, scene.instanceCapacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+        scene.uploadedInstances.clear();
+    }
+
+    std::vector<InstanceData>& uploaded = scene.uploadedInstances;
+    size_t comparable = std::min(instances.size(), uploaded.size());
+    size_t i = 0;
+    while (i < instances.size()) {
+        if (i < comparable && sameInstance(instances[i], uploaded[i])) {
+            i++;
+            continue;
+        }
+        size_t last = i;
+        for (size_t j = i + 1; j < instances.size() && j - last <= maxUploadGap; j++) {
+            if (j >= comparable || !sameInstance(instances[j], uploaded[j]))
+                last = j;
+        }
+        size_t count = last + 1 - i;
+        glBufferSubData(GL_ARRAY_BUFFER, i * sizeof(InstanceData), count * sizeof(InstanceData), &instances[i]);
+        bytes += count * sizeof(InstanceData);
+        i = last + 1;
+    }
+    uploaded.assign(instances.begin(), instances.end());
+
+    if (!scene.indirect || (scene.commandBuffer && sameBatches(scene.drawBatches, scene.uploadedBatches)))
+        return bytes;
+    std::vector<DrawElementsIndirectCommand> commands = buildDrawCommands(scene, scene.drawBatches);
+    if (!scene.commandBuffer)
+        glGenBuffers(1, &scene.commandBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand),
+                 commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    scene.uploadedBatches = scene.drawBatches;
+    return bytes + commands.size() * sizeof(DrawElementsIndirectCommand);
+}
+
+void uploadSceneInstances(Scene& scene, bool useIndirect) {
+    std::vector<size_t> perMesh(scene.meshes.size(), 0);
+    for (const SceneInstance& instance : scene.instances)
+        perMesh[instance.mesh]++;
+
+    scene.batches.clear();
+    std::vector<size_t> cursor(scene.meshes.size(), 0);
+    size_t first = 0;
+    for (unsigned int mesh = 0; mesh < scene.meshes.size(); mesh++) {
+        cursor[mesh] = first;
+        if (perMesh[mesh] > 0)
+            scene.batches.push_back({ mesh, 0, first, perMesh[mesh] });
+        first += perMesh[mesh];
+    }
+
+    scene.instanceData.resize(scene.instances.size());
+    scene.instanceBoundsMin.resize(scene.instances.size());
+    scene.instanceBoundsMax.resize(scene.instances.size());
+    scene.instanceScale.resize(scene.instances.size());
+    scene.instanceSlots.resize(scene.instances.size());
+    scene.instanceDirty.assign(scene.instances.size(), 0);
+    scene.dirtyInstances.clear();
+    scene.changedSlots.clear();
+    for (size_t i = 0; i < scene.instances.size(); i++) {
+        const SceneInstance& instance = scene.instances[i];
+        const GpuMesh& mesh = scene.meshes[instance.mesh];
+        size_t slot = cursor[instance.mesh]++;
+        scene.instanceSlots[i] = static_cast<unsigned int>(slot);
+        InstanceData& data = scene.instanceData[slot];
+        data.transform = instance.transform * mesh.positionTransform;
+        data.color = glm::vec4(mesh.color, 1.0f);
+        data.edgeMaskBase = static_cast<unsigned int>(mesh.firstTriangle);
+        data.padding[0] = data.padding[1] = data.padding[2] = 0;
+        transformBounds(mesh, instance.transform, scene.instanceBoundsMin[slot], scene.instanceBoundsMax[slot]);
+        scene.instanceScale[slot] = transformScale(instance.transform);
+    }
+    scene.bvh.build(scene.instanceBoundsMin, scene.instanceBoundsMax);
+
+    scene.indirect = useIndirect && multiDrawIndirectSupported();
+    scene.drawBatches = scene.batches;
+    uploadDrawList(scene, scene.instanceData);
+    scene.instanceBufferHoldsAll = true;
+    scene.pool.bindInstanceAttributes(scene.instanceBuffer, 0);
+    glBindVertexArray(0);
+}
+
+void destroyScene(Scene& scene) {
+    scene.pool.destroy();
+    if (scene.instanceBuffer)
+        glDeleteBuffers(1, &scene.instanceBuffer);
+    if (scene.commandBuffer)
+        glDeleteBuffers(1, &scene.commandBuffer);
+    if (scene.occluderBuffer)
+        glDeleteBuffers(1, &scene.occluderBuffer);
+    scene = Scene();
+}
+
+void setInstanceTransform(Scene& scene, size_t instance, const glm::mat4& transform) {
+    scene.instances[instance].transform = transform;
+    if (!scene.instanceDirty[instance]) {
+        scene.instanceDirty[instance] = 1;
+        scene.dirtyInstances.push_back(static_cast<unsigned int>(instance));
+    }
+}
+
+// Writes the listed slots, sorted, of source to buffer, one sub-range per
+// run of adjacent slots. index maps a slot to its place in the buffer, or
+// returns false for slots the buffer does not hold.
+template <class Index>
+static void writeSlots(unsigned int buffer, const std::vector<unsigned int>& slots, const InstanceData* source,
+                       Index index) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    size_t i = 0;
+    while (i < slots.size()) {
+        size_t first;
+        if (!index(slots[i], first)) {
+            i++;
+            continue;
+        }
+        size_t count = 1;
+        size_t next;
+        while (i + count < slots.size() && slots[i + count] == slots[i] + count && index(slots[i + count], next)
+               && next == first + count)
+            count++;
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(InstanceData), count * sizeof(InstanceData),
+                        source + slots[i]);
+        i += count;
+    }
+}
+
+bool flushInstanceTransforms(Scene& scene) {
+    scene.changedSlots.clear();
+    if (scene.dirtyInstances.empty())
+        return false;
+    for (unsigned int index : scene.dirtyInstances) {
+        const SceneInstance& instance = scene.instances[index];
+        const GpuMesh& mesh = scene.meshes[instance.mesh];
+        unsigned int slot = scene.instanceSlots[index];
+        scene.instanceData[slot].transform = instance.transform * mesh.positionTransform;
+        transformBounds(mesh, instance.transform, scene.instanceBoundsMin[slot], scene.instanceBoundsMax[slot]);
+        scene.instanceScale[slot] = transformScale(instance.transform);
+        scene.instanceDirty[index] = 0;
+        scene.changedSlots.push_back(slot);
+    }
+    scene.dirtyInstances.clear();
+    std::sort(scene.changedSlots.begin(), scene.changedSlots.end());
+    scene.bvh.refit(scene.changedSlots, scene.instanceBoundsMin, scene.instanceBoundsMax);
+
+    // A draw list holds copies in its own order and is rebuilt by the
+    // caller; without one the buffer is instanceData itself.
+    if (scene.instanceBufferHoldsAll) {
+        writeSlots(scene.instanceBuffer, scene.changedSlots, scene.instanceData.data(),
+                   [](unsigned int slot, size_t& index) { index = slot; return true; });
+        for (unsigned int slot : scene.changedSlots)
+            scene.uploadedInstances[slot] = scene.instanceData[slot];
+    }
+    if (!scene.occluderSlots.empty()) {
+        const std::vector<unsigned int>& occluders = scene.occluderSlots;
+        writeSlots(scene.occluderBuffer, scene.changedSlots, scene.instanceData.data(),
+                   [&](unsigned int slot, size_t& index) {
+                       auto found = std::lower_bound(occluders.begin(), occluders.end(), slot);
+                       index = static_cast<size_t>(found - occluders.begin());
+                       return found != occluders.end() && *found == slot;
+                   });
+    }
+    return true;
+}
+
+float transformScale(const glm::mat4& transform) {
+    return std::max(glm::length(glm::vec3(transform[0])),
+                    std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+}
+
+unsigned int selectLod(const GpuMesh& mesh, const DrawListView& view, const glm::vec3& boundsMin,
+                       const glm::vec3& boundsMax, float scale) {
+    if (view.maxPixelError <= 0.0f)
+        return 0;
+    // Distance to the nearest point of the bounding sphere; inside it the
+    // full-resolution mesh is always used.
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = glm::length(boundsMax - boundsMin) * 0.5f;
+    float distance = glm::length(view.eye - center) - radius;
+    if (distance <= 0.0f)
+        return 0;
+
+    float pixelsPerError = scale * view.pixelsPerUnit / distance;
+    unsigned int lod = 0;
+    while (lod + 1 < mesh.lodCount && mesh.lods[lod + 1].error * pixelsPerError <= view.maxPixelError)
+        lod++;
+    return lod;
+}
+
+void buildDrawList(Scene& scene, const DrawListView& view, DrawListStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    stats = DrawListStats();
+
+    std::vector<unsigned int>& visible = scene.visibleScratch;
+    std::vector<unsigned int>& lods = scene.lodScratch;
+    std::vector<InstanceData>& instances = scene.drawInstanceScratch;
+    visible.clear();
+    instances.clear();
+    if (view.frustumCull) {
+        scene.bvh.cull(frustumFromMatrix(view.viewProjection), visible, stats.cull);
+        // instanceData is grouped by batch, so sorted indices regroup the
+        // survivors into contiguous per-batch runs.
+        std::sort(visible.begin(), visible.end());
+    }
+    else {
+        visible.resize(scene.instanceData.size());
+        for (size_t i = 0; i < visible.size(); i++)
+            visible[i] = static_cast<unsigned int>(i);
+        stats.cull.visible = visible.size();
+    }
+
+    lods.resize(visible.size());
+
+    scene.drawBatches.clear();
+    size_t next = 0;
+    for (const InstanceBatch& batch : scene.batches) {
+        const GpuMesh& mesh = scene.meshes[batch.mesh];
+        size_t begin = next;
+        while (next < visible.size() && visible[next] < batch.firstInstance + batch.instanceCount) {
+            unsigned int instance = visible[next];
+            lods[next] = selectLod(mesh, view, scene.instanceBoundsMin[instance], scene.instanceBoundsMax[instance],
+                                   scene.instanceScale[instance]);
+            next++;
+        }
+
+        for (unsigned int lod = 0; lod < mesh.lodCount; lod++) {
+            InstanceBatch drawBatch = { batch.mesh, lod, instances.size(), 0 };
+            for (size_t i = begin; i < next; i++) {
+                if (lods[i] != lod)
+                    continue;
+                instances.push_back(scene.instanceData[visible[i]]);
+                instances.back().edgeMaskBase = static_cast<unsigned int>(mesh.firstTriangle + mesh.lods[lod].firstIndex / 3);
+                drawBatch.instanceCount++;
+            }
+            if (drawBatch.instanceCount == 0)
+                continue;
+            scene.drawBatches.push_back(drawBatch);
+            stats.lodInstances[lod] += drawBatch.instanceCount;
+            stats.triangles += drawBatch.instanceCount * (mesh.lods[lod].indexCount / 3);
+        }
+    }
+    stats.uploadBytes = uploadDrawList(scene, instances);
+    scene.instanceBufferHoldsAll = false;
+
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+size_t drawScenePass(const Scene& scene, ScenePass pass) {
+    if (scene.drawBatches.empty())
+        return 0;
+
+    bool edges = pass == ScenePass::Edges;
+    GLenum mode = edges ? GL_LINES : GL_TRIANGLES;
+    const GeometryPool& pool = scene.pool;
+
+    glBindVertexArray(pool.vao());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edges ? pool.edgeIndexBuffer() : pool.indexBuffer());
+
+    size_t drawCalls = 0;
+    if (scene.indirect) {
+        size_t firstCommand = edges ? scene.drawBatches.size() : 0;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.commandBuffer);
+        glMultiDrawElementsIndirect(mode, pool.indexType(),
+                                    (void*)(firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                    static_cast<GLsizei>(scene.drawBatches.size()), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        drawCalls = 1;
+    }
+    else {
+        // Without a base instance the instance attributes are re-pointed
+        // at each batch.
+        for (const InstanceBatch& batch : scene.drawBatches) {
+            const GpuMesh& mesh = scene.meshes[batch.mesh];
+            const MeshLod& lod = mesh.lods[batch.lod];
+            size_t first = edges ? mesh.firstEdgeIndex + lod.firstEdgeIndex : mesh.firstIndex + lod.firstIndex;
+            size_t count = edges ? lod.edgeIndexCount : lod.indexCount;
+            pool.bindInstanceAttributes(scene.instanceBuffer, batch.firstInstance);
+            glDrawElementsInstancedBaseVertex(mode, static_cast<GLsizei>(count), pool.indexType(),
+                                              (void*)(first * pool.indexSize()),
+                                              static_cast<GLsizei>(batch.instanceCount),
+                                              static_cast<GLint>(mesh.baseVertex));
+            drawCalls++;
+        }
+    }
+    return drawCalls;
+}
+
+void selectOccluders(Scene& scene, size_t maxOccluders) {
+    std::vector<unsigned int> order(scene.instanceData.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = static_cast<unsigned int>(i);
+    size_t count = std::min(maxOccluders, order.size());
+    auto extent = [&](unsigned int i) { return glm::length(scene.instanceBoundsMax[i] - scene.instanceBoundsMin[i]); };
+    std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                      [&](unsigned int a, unsigned int b) { return extent(a) > extent(b); });
+    // Back in instance order, which groups them by batch.
+    order.resize(count);
+    std::sort(order.begin(), order.end());
+    scene.occluderSlots = order;
+
+    std::vector<InstanceData> instances;
+    scene.occluderBatches.clear();
+    size_t next = 0;
+    for (const InstanceBatch& batch : scene.batches) {
+        InstanceBatch occluderBatch = { batch.mesh, 0, instances.size(), 0 };
+        while (next < order.size() && order[next] < batch.firstInstance + batch.instanceCount) {
+            instances.push_back(scene.instanceData[order[next++]]);
+            occluderBatch.instanceCount++;
+        }
+        if (occluderBatch.instanceCount > 0)
+            scene.occluderBatches.push_back(occluderBatch);
+    }
+
+    if (!scene.occluderBuffer)
+        glGenBuffers(1, &scene.occluderBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, scene.occluderBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+}
+
+void drawOccluders(const Scene& scene) {
+    const GeometryPool& pool = scene.pool;
+    glBindVertexArray(pool.vao());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.indexBuffer());
+    for (const InstanceBatch& batch : scene.occluderBatches) {
+        const GpuMesh& mesh = scene.meshes[batch.mesh];
+        pool.bindInstanceAttributes(scene.occluderBuffer, batch.firstInstance);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.lods[0].indexCount, pool.indexType(),
+                                          (void*)((mesh.firstIndex + mesh.lods[0].firstIndex) * pool.indexSize()),
+                                          static_cast<GLsizei>(batch.instanceCount),
+                                          static_cast<GLint>(mesh.baseVertex));
+    }
+    pool.bindInstanceAttributes(scene.instanceBuffer, 0);
+}
+
+void addInstanceGrid(Scene& scene, size_t copiesPerMesh) {
+    size_t total = copiesPerMesh * scene.meshes.size();
+    if (total == 0)
+        return;
+
+    float spacing = 0.0f;
+    for (const GpuMesh& mesh : scene.meshes) {
+        glm::vec3 extent = mesh.boundsMax - mesh.boundsMin;
+        spacing = std::max(spacing, std::max(extent.x, std::max(extent.y, extent.z)));
+    }
+    spacing = spacing > 0.0f ? spacing * 1.5f : 1.0f;
+
+    size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(total))));
+    float offset = (side - 1) * spacing * 0.5f;
+
+    for (size_t i = 0; i < total; i++) {
+        const GpuMesh& mesh = scene.meshes[i % scene.meshes.size()];
+        glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+        glm::vec3 cell((i % side) * spacing - offset, 0.0f, (i / side) * spacing - offset);
+
+        SceneInstance instance;
+        instance.mesh = static_cast<unsigned int>(i % scene.meshes.size());
+        instance.transform = glm::translate(glm::mat4(1.0f), cell - center);
+        scene.instances.push_back(instance);
+    }
+}
+
+void sceneBounds(const Scene& scene, glm::vec3& boundsMin, glm::vec3& boundsMax) {
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (const SceneInstance& instance : scene.instances) {
+        glm::vec3 instanceMin, instanceMax;
+        transformBounds(scene.meshes[instance.mesh], instance.transform, instanceMin, instanceMax);
+        boundsMin = glm::min(boundsMin, instanceMin);
+        boundsMax = glm::max(boundsMax, instanceMax);
+    }
+    if (scene.instances.empty()) {
+        boundsMin = glm::vec3(0.0f);
+        boundsMax = glm::vec3(0.0f);
+    }
+}
+
+SceneFraming frameScene(const Scene& scene) {
+    if (scene.instances.size() <= 1)
+        return SceneFraming();
+    glm::vec3 sceneMin, sceneMax;
+    sceneBounds(scene, sceneMin, sceneMax);
+    return frameBounds(sceneMin, sceneMax);
+}
+
+SceneFraming frameBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    SceneFraming framing;
+    float radius = glm::length(boundsMax - boundsMin) * 0.5f;
+    if (radius <= 0.0f)
+        return framing;
+    float distance = radius / std::sin(framing.fovY * 0.5f);
+    framing.target = (boundsMin + boundsMax) * 0.5f;
+    framing.eye = framing.target + glm::normalize(glm::vec3(1, 1, 1)) * distance;
+    framing.farPlane = std::max(framing.farPlane, distance + 2.0f * radius);
+    // Near plane scaled to the box, so depth keeps its precision at any
+    // size; a quarter of the gap leaves room for the orbit path's dolly.
+    framing.nearPlane = (distance - radius) * 0.25f;
+    return framing;
+}
+
+size_t sceneTriangleCount(const Scene& scene) {
+    size_t triangles = 0;
+    for (const SceneInstance& instance : scene.instances)
+        triangles += scene.meshes[instance.mesh].lods[0].indexCount / 3;
+    return triangles;
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include "bvh.h"
+#include "geometry_pool.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// One placed copy of a mesh.
+struct SceneInstance {
+    unsigned int mesh = 0;
+    glm::mat4 transform = glm::mat4(1.0f);
+};
+
+// Instances of one mesh drawn at one LOD, stored contiguously in the
+// instance buffer; one draw command per batch and pass.
+struct InstanceBatch {
+    unsigned int mesh = 0;
+    unsigned int lod = 0;
+    size_t firstInstance = 0;
+    size_t instanceCount = 0;
+};
+
+// Layout of glMultiDrawElementsIndirect's command records.
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    unsigned int baseVertex;
+    unsigned int baseInstance;
+};
+
+enum class ScenePass {
+    // Filled triangles from the pool's index buffer.
+    Triangles,
+    // GL_LINES over the pool's edge index buffer.
+    Edges
+};
+
+struct Scene {
+    // All meshes live in the pool; meshes[i] records where.
+    GeometryPool pool;
+    std::vector<GpuMesh> meshes;
+    std::vector<SceneInstance> instances;
+
+    // Built by uploadSceneInstances. instanceData holds every instance,
+    // grouped by batch; the BVH indexes the same order. Its transforms
+    // include each mesh's positionTransform, so LOD selection reads the
+    // instance's own scale from instanceScale.
+    std::vector<InstanceBatch> batches;
+    std::vector<InstanceData> instanceData;
+    std::vector<glm::vec3> instanceBoundsMin;
+    std::vector<glm::vec3> instanceBoundsMax;
+    std::vector<float> instanceScale;
+    Bvh bvh;
+
+    // Slot of each instance in instanceData. setInstanceTransform marks
+    // instances dirty; flushInstanceTransforms refreshes their slots and
+    // lists them in changedSlots, sorted, until the next flush.
+    std::vector<unsigned int> instanceSlots;
+    std::vector<unsigned int> dirtyInstances;
+    std::vector<unsigned char> instanceDirty;
+    std::vector<unsigned int> changedSlots;
+
+    // What the passes draw: all batches at full resolution, or after
+    // buildDrawList the visible instances, compacted into one batch per
+    // mesh and LOD.
+    std::vector<InstanceBatch> drawBatches;
+    unsigned int instanceBuffer = 0;
+    // Instances the buffer has room for, and what it holds as last
+    // uploaded, so a rebuilt draw list only writes what differs. The
+    // buffer holds instanceData itself until a draw list is built.
+    size_t instanceCapacity = 0;
+    std::vector<InstanceData> uploadedInstances;
+    std::vector<InstanceBatch> uploadedBatches;
+    bool instanceBufferHoldsAll = false;
+    // Triangle commands for every draw batch, followed by edge commands.
+    unsigned int commandBuffer = 0;
+    // Whether passes go through glMultiDrawElementsIndirect.
+    bool indirect = false;
+
+    // Largest instances, drawn into the Hi-Z buffer before occlusion
+    // culling. Built by selectOccluders.
+    std::vector<InstanceBatch> occluderBatches;
+    // Slots of the occluders, sorted, in occluderBuffer order.
+    std::vector<unsigned int> occluderSlots;
+    unsigned int occluderBuffer = 0;
+
+    // Reused by buildDrawList between frames.
+    std::vector<unsigned int> visibleScratch;
+    std::vector<unsigned int> lodScratch;
+    std::vector<InstanceData> drawInstanceScratch;
+};
+
+// True when the context has glMultiDrawElementsIndirect (GL 4.3 or
+// ARB_multi_draw_indirect).
+bool multiDrawIndirectSupported();
+
+// Groups instances by mesh, builds the BVH over their world bounds,
+// uploads their attributes into one buffer and builds the per-batch draw
+// commands. Without indirect support (or with
+// useIndirect false) passes fall back to one instanced draw per batch.
+void uploadSceneInstances(Scene& scene, bool useIndirect);
+void destroyScene(Scene& scene);
+
+// Moves an instance after uploadSceneInstances. Only marks it dirty; the
+// scene is updated by the next flushInstanceTransforms.
+void setInstanceTransform(Scene& scene, size_t instance, const glm::mat4& transform);
+
+// Refreshes the attributes, bounds and scale of the instances moved since
+// the last call, refits the BVH around them and writes them to the
+// instance and occluder buffers in place, one sub-range per run of
+// adjacent slots. Returns true if any moved; a draw list built before no
+// longer matches them and has to be rebuilt, and a GpuCuller has to be
+// given changedSlots.
+bool flushInstanceTransforms(Scene& scene);
+
+// The view a draw list is built for, in the space of the instance
+// transforms (i.e. with the assembly rotation folded in).
+struct DrawListView {
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    bool frustumCull = true;
+    glm::vec3 eye = glm::vec3(0.0f);
+    // Framebuffer pixels covered by one unit at distance one.
+    float pixelsPerUnit = 1.0f;
+    // Each instance uses its coarsest LOD whose error projects to at most
+    // this many pixels; 0 keeps every instance at full resolution.
+    float maxPixelError = 0.0f;
+};
+
+struct DrawListStats {
+    CullStats cull;
+    // Visible instances drawn at each LOD.
+    size_t lodInstances[maxLodCount] = {};
+    size_t triangles = 0;
+    // Instance and command bytes written to the GPU; 0 when the list came
+    // out the same as the one already uploaded.
+    size_t uploadBytes = 0;
+    double milliseconds = 0.0;
+};
+
+// Rebuilds the draw list for the view: instances outside the frustum are
+// dropped and the rest are grouped by mesh and selected LOD. Only needs
+// calling when the view changes or instances moved. The new list is
+// compared with the uploaded one, and only the runs of instances that
+// differ are written; commands are only rewritten when the batches
+// changed.
+void buildDrawList(Scene& scene, const DrawListView& view, DrawListStats& stats);
+
+// LOD of a mesh for an instance with the given world bounds and scale.
+unsigned int selectLod(const GpuMesh& mesh, const DrawListView& view, const glm::vec3& boundsMin,
+                       const glm::vec3& boundsMax, float scale);
+
+// World-space bounds of a mesh's box under transform.
+void transformBounds(const GpuMesh& mesh, const glm::mat4& transform, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+// Largest axis scale of an instance transform.
+float transformScale(const glm::mat4& transform);
+
+// Triangle commands for batches followed by their edge commands, the
+// layout of commandBuffer.
+std::vector<DrawElementsIndirectCommand> buildDrawCommands(const Scene& scene, const std::vector<InstanceBatch>& batches);
+
+// Draws every batch for the pass with the bound program. Returns the
+// number of draw calls issued.
+size_t drawScenePass(const Scene& scene, ScenePass pass);
+
+// Picks the maxOccluders instances with the largest bounds as occluders.
+void selectOccluders(Scene& scene, size_t maxOccluders);
+
+// Draws the occluders at full resolution with the bound program, one
+// instanced draw per mesh, and re-points the instance attributes at the
+// scene's instance buffer afterwards.
+void drawOccluders(const Scene& scene);
+
+// Lays out copiesPerMesh instances of every mesh on a square grid in the
+// XZ plane, centred on the origin, spaced by the largest mesh extent.
+void addInstanceGrid(Scene& scene, size_t copiesPerMesh);
+
+// World-space bounds of all instances.
+void sceneBounds(const Scene& scene, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+// Starting camera: a single mesh keeps the original view, larger scenes
+// are framed whole from the (1, 1, 1) diagonal.
+struct SceneFraming {
+    glm::vec3 eye = glm::vec3(3.0f);
+    glm::vec3 target = glm::vec3(0.0f);
+    float fovY = glm::radians(45.0f);
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+};
+
+SceneFraming frameScene(const Scene& scene);
+// Frames a box whole from the (1, 1, 1) diagonal, as frameScene does for
+// larger scenes.
+SceneFraming frameBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+// Triangles of every instance at full resolution.
+size_t sceneTriangleCount(const Scene& scene);
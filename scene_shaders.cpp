@@ -0,0 +1,150 @@
+#include "scene_shaders.h"
+#include "program_cache.h"
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+// Frame and Object mirror FrameUniforms and ObjectUniforms in
+// uniform_ring.h; per-mesh colour comes from the instance attributes laid
+// out by InstanceData in geometry_pool.h.
+const char* sceneVertexShader = R"glsl(
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in mat4 instanceTransform;
+layout (location = 5) in vec4 instanceColor;
+layout (location = 6) in uint instanceEdgeMaskBase;
+layout (std140) uniform Frame { mat4 viewProjection; vec4 viewport; } frame;
+layout (std140) uniform Object { mat4 model; vec4 color; } object;
+flat out vec3 meshColor;
+flat out uint meshEdgeMaskBase;
+void main() {
+    gl_Position = frame.viewProjection * object.model * instanceTransform * vec4(aPos, 1.0);
+    meshColor = instanceColor.rgb * object.color.rgb;
+    meshEdgeMaskBase = instanceEdgeMaskBase;
+}
+)glsl";
+
+// edgeMask says which of a triangle's edges are real polygon edges rather
+// than triangulation diagonals (bit k = edge opposite corner k); each
+// mesh's masks start at its instances' meshEdgeMaskBase in the pooled
+// buffer.
+const char* wireframeGeometryShader = R"glsl(
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+layout (std140) uniform Frame { mat4 viewProjection; vec4 viewport; } frame;
+uniform usamplerBuffer edgeMask;
+flat in vec3 meshColor[];
+flat in uint meshEdgeMaskBase[];
+noperspective out vec3 edgeDistance;
+flat out uint edgeFlags;
+flat out vec3 fillColor;
+void main() {
+    vec2 p0 = frame.viewport.zw * gl_in[0].gl_Position.xy / gl_in[0].gl_Position.w;
+    vec2 p1 = frame.viewport.zw * gl_in[1].gl_Position.xy / gl_in[1].gl_Position.w;
+    vec2 p2 = frame.viewport.zw * gl_in[2].gl_Position.xy / gl_in[2].gl_Position.w;
+    // Twice the screen area over each edge length gives the corner height.
+    float area = abs((p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x));
+    vec3 heights = area / vec3(length(p2 - p1), length(p2 - p0), length(p1 - p0));
+    // Screen-space distances are meaningless for corners behind the eye.
+    bool projectable = gl_in[0].gl_Position.w > 0.0 && gl_in[1].gl_Position.w > 0.0 && gl_in[2].gl_Position.w > 0.0;
+    uint flags = projectable ? texelFetch(edgeMask, int(meshEdgeMaskBase[0]) + gl_PrimitiveIDIn).r : 0u;
+
+    gl_Position = gl_in[0].gl_Position;
+    edgeDistance = vec3(heights.x, 0.0, 0.0);
+    edgeFlags = flags;
+    fillColor = meshColor[0];
+    EmitVertex();
+    gl_Position = gl_in[1].gl_Position;
+    edgeDistance = vec3(0.0, heights.y, 0.0);
+    edgeFlags = flags;
+    fillColor = meshColor[0];
+    EmitVertex();
+    gl_Position = gl_in[2].gl_Position;
+    edgeDistance = vec3(0.0, 0.0, heights.z);
+    edgeFlags = flags;
+    fillColor = meshColor[0];
+    EmitVertex();
+    EndPrimitive();
+}
+)glsl";
+
+const char* sceneFragmentShader = R"glsl(
+out vec4 FragColor;
+#if defined(WIREFRAME)
+noperspective in vec3 edgeDistance;
+flat in uint edgeFlags;
+flat in vec3 fillColor;
+uniform float lineWidth;
+void main() {
+    float d = 1e30;
+    if ((edgeFlags & 1u) != 0u) d = min(d, edgeDistance.x);
+    if ((edgeFlags & 2u) != 0u) d = min(d, edgeDistance.y);
+    if ((edgeFlags & 4u) != 0u) d = min(d, edgeDistance.z);
+    // Lines are drawn inside each triangle, so half the width on each side
+    // of a shared edge adds up to the full width.
+    float halfWidth = lineWidth * 0.5;
+    float line = 1.0 - smoothstep(halfWidth - 0.5, halfWidth + 0.5, d);
+    FragColor = vec4(mix(fillColor, vec3(0.0), line), 1.0);
+}
+#elif defined(OUTLINE)
+void main() {
+    FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
+#else
+flat in vec3 meshColor;
+void main() {
+    FragColor = vec4(meshColor, 1.0);
+}
+#endif
+)glsl";
+
+// #version has to come first, so the defines go between it and the body.
+std::string variantSource(const char* body, unsigned features) {
+    std::string source = "#version 330 core\n";
+    if (features & sceneShaderOutline)
+        source += "#define OUTLINE 1\n";
+    if (features & sceneShaderWireframe)
+        source += "#define WIREFRAME 1\n";
+    return source + body;
+}
+
+ShaderProgram linkVariant(ProgramCache* cache, unsigned features) {
+    SceneShaderSources sources = sceneShaderSources(features);
+    if (cache)
+        return cache->link(sources.vertex, sources.fragment, sources.geometry);
+    return linkShaderProgram(sources.vertex.c_str(), sources.fragment.c_str(),
+                             sources.geometry.empty() ? nullptr : sources.geometry.c_str());
+}
+
+}
+
+SceneShaderSources sceneShaderSources(unsigned features) {
+    SceneShaderSources sources;
+    sources.vertex = variantSource(sceneVertexShader, features);
+    sources.fragment = variantSource(sceneFragmentShader, features);
+    if (features & sceneShaderWireframe)
+        sources.geometry = variantSource(wireframeGeometryShader, features);
+    return sources;
+}
+
+void linkScenePrograms(const AppOptions& options, ProgramCache* cache, ScenePrograms& programs) {
+    auto start = std::chrono::steady_clock::now();
+    size_t loadedBefore = cache ? cache->loaded() : 0;
+    programs.fill = linkVariant(cache, 0);
+    programs.outline = linkVariant(cache, sceneShaderOutline);
+    programs.wireframe = linkVariant(cache, sceneShaderWireframe);
+    glUseProgram(programs.wireframe.id);
+    glUniform1f(programs.wireframe.location(Uniform::LineWidth), options.lineWidth);
+    glUniform1i(programs.wireframe.location(Uniform::EdgeMask), 0);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Linked 3 scene programs in " << ms << " ms";
+    if (cache && cache->enabled())
+        std::cout << " (" << cache->loaded() - loadedBefore << " from the binary cache)";
+    std::cout << std::endl;
+}
+
+void destroyScenePrograms(ScenePrograms& programs) {
+    destroyShaderProgram(programs.fill);
+    destroyShaderProgram(programs.outline);
+    destroyShaderProgram(programs.wireframe);
+}
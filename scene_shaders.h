@@ -0,0 +1,99 @@
+#pragma once
+#include "options.h"
+#include "scene.h"
+#include "shader_program.h"
+#include <glad/glad.h>
+#include <string>
+
+class ProgramCache;
+
+// Features a scene program variant is generated for. Each set bit becomes
+// a #define ahead of the shared sources, so every variant compiles only
+// the code it runs.
+enum SceneShaderFeature : unsigned {
+    // Flat outline colour for the edge pass.
+    sceneShaderOutline = 1u << 0,
+    // Single-pass wireframe: a geometry shader measures each corner's
+    // distance to the opposite edge and the fill blends the outline in.
+    sceneShaderWireframe = 1u << 1,
+};
+
+struct SceneShaderSources {
+    std::string vertex;
+    std::string fragment;
+    // Empty for variants without a geometry stage.
+    std::string geometry;
+};
+
+SceneShaderSources sceneShaderSources(unsigned features);
+
+// Fixed pipeline state of each variant, known at compile time: what its
+// draws read and which state it needs bound. bindScenePipeline and
+// drawScenePipeline are instantiated per variant, so the draw code picks
+// a variant once per pass and never tests the outline mode again.
+template <unsigned Features>
+struct ScenePipeline;
+
+template <>
+struct ScenePipeline<0> {
+    static constexpr ScenePass pass = ScenePass::Triangles;
+    static constexpr bool edgeMask = false;
+    static constexpr bool lines = false;
+};
+
+template <>
+struct ScenePipeline<sceneShaderOutline> {
+    static constexpr ScenePass pass = ScenePass::Edges;
+    static constexpr bool edgeMask = false;
+    static constexpr bool lines = true;
+};
+
+template <>
+struct ScenePipeline<sceneShaderWireframe> {
+    static constexpr ScenePass pass = ScenePass::Triangles;
+    static constexpr bool edgeMask = true;
+    static constexpr bool lines = false;
+};
+
+// The scene program of every variant the renderer draws with.
+struct ScenePrograms {
+    ShaderProgram fill;
+    ShaderProgram outline;
+    ShaderProgram wireframe;
+
+    template <unsigned Features>
+    const ShaderProgram& get() const {
+        if constexpr (Features == sceneShaderOutline)
+            return outline;
+        else if constexpr (Features == sceneShaderWireframe)
+            return wireframe;
+        else
+            return fill;
+    }
+};
+
+// Links every variant, through cache when given, and sets the uniforms that
+// never change; program state keeps them.
+void linkScenePrograms(const AppOptions& options, ProgramCache* cache, ScenePrograms& programs);
+void destroyScenePrograms(ScenePrograms& programs);
+
+// Makes the variant's program current with the state it needs.
+template <unsigned Features>
+void bindScenePipeline(const Scene& scene, const ScenePrograms& programs, float lineWidth) {
+    using Pipeline = ScenePipeline<Features>;
+    glUseProgram(programs.get<Features>().id);
+    if constexpr (Pipeline::edgeMask) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, scene.pool.edgeMaskTexture());
+    }
+    if constexpr (Pipeline::lines)
+        glLineWidth(lineWidth);
+}
+
+// Binds the variant and draws its pass of the scene. Returns the number
+// of draw calls issued.
+template <unsigned Features>
+size_t drawScenePipeline(const Scene& scene, const ScenePrograms& programs, float lineWidth) {
+    bindScenePipeline<Features>(scene, programs, lineWidth);
+    return drawScenePass(scene, ScenePipeline<Features>::pass);
+}
@@ -0,0 +1,44 @@
+#include "scratch_arena.h"
+#include <algorithm>
+
+ScratchArena::ScratchArena(size_t blockSize, size_t retainBytes)
+    : blockSize_(blockSize), retainBytes_(retainBytes), nextBlockSize_(blockSize) {
+}
+
+void* ScratchArena::allocate(size_t bytes, size_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t offset = (used_ + alignment - 1) / alignment * alignment;
+    if (blocks_.empty() || offset + bytes > blocks_.back().size) {
+        // Each new block at least doubles the capacity, so a cycle takes
+        // a logarithmic number of blocks however it grows.
+        size_t size = std::max(bytes, std::max(nextBlockSize_, stats_.capacity));
+        blocks_.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+        stats_.blockAllocations++;
+        stats_.capacity += size;
+        nextBlockSize_ = blockSize_;
+        offset = 0;
+    }
+    used_ = offset + bytes;
+    stats_.allocations++;
+    stats_.bytes += bytes;
+    return blocks_.back().data.get() + offset;
+}
+
+void ScratchArena::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (blocks_.size() > 1 || stats_.capacity > retainBytes_) {
+        // Replaced by one block of the combined size on the next allocation
+        nextBlockSize_ = std::max(blockSize_, std::min(stats_.capacity, retainBytes_));
+        blocks_.clear();
+        stats_.capacity = 0;
+    }
+    used_ = 0;
+    stats_.allocations = 0;
+    stats_.bytes = 0;
+    stats_.blockAllocations = 0;
+}
+
+ScratchArenaStats ScratchArena::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
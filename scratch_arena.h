@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct ScratchArenaStats {
+    // Allocations served and bytes handed out since the last reset. Bytes
+    // only grow until then, so this is also the peak.
+    size_t allocations = 0;
+    size_t bytes = 0;
+    // Blocks taken from the heap since the last reset, and bytes held in
+    // blocks now.
+    size_t blockAllocations = 0;
+    size_t capacity = 0;
+};
+
+// Bump allocator for data that only lives while a mesh is loaded and
+// optimized: parser chunks, triangulation and edge scratch, cache and LOD
+// build arrays. Allocating moves a pointer through the current block,
+// freeing does nothing, and reset() drops everything at once. reset()
+// keeps up to retainBytes of blocks, merged into one, so an arena reused
+// mesh after mesh stops touching the heap once it has seen the largest;
+// anything beyond retainBytes is returned, so one huge mesh does not pin
+// its scratch for the rest of a batch. Growing a vector leaves its old
+// storage behind until the reset, so stages reserve up front where they
+// can. Allocation takes a lock and may come from several threads.
+class ScratchArena {
+public:
+    explicit ScratchArena(size_t blockSize = 1 << 20, size_t retainBytes = size_t(256) << 20);
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    // Aligned to alignment, at most alignof(std::max_align_t).
+    void* allocate(size_t bytes, size_t alignment);
+    // Invalidates everything allocated so far.
+    void reset();
+
+    ScratchArenaStats stats() const;
+
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    mutable std::mutex mutex_;
+    size_t blockSize_;
+    size_t retainBytes_;
+    // Size of the first block after a reset: what the previous cycle
+    // needed, within retainBytes.
+    size_t nextBlockSize_;
+    std::vector<Block> blocks_;
+    // Bytes used of blocks_.back().
+    size_t used_ = 0;
+    ScratchArenaStats stats_;
+};
+
+// Standard allocator over a ScratchArena; without one it uses the heap, so
+// code can hold ScratchVectors whether or not its caller has an arena.
+template <class T>
+class ScratchAllocator {
+public:
+    using value_type = T;
+
+    ScratchAllocator(ScratchArena* arena = nullptr) : arena_(arena) {}
+    template <class U>
+    ScratchAllocator(const ScratchAllocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(size_t count) {
+        if (!arena_)
+            return std::allocator<T>().allocate(count);
+        return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* pointer, size_t count) {
+        if (!arena_)
+            std::allocator<T>().deallocate(pointer, count);
+    }
+
+    ScratchArena* arena() const { return arena_; }
+
+    template <class U>
+    bool operator==(const ScratchAllocator<U>& other) const { return arena_ == other.arena(); }
+    template <class U>
+    bool operator!=(const ScratchAllocator<U>& other) const { return arena_ != other.arena(); }
+
+private:
+    ScratchArena* arena_;
+};
+
+template <class T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
@@ -0,0 +1,120 @@
+#include "shader_program.h"
+#include "uniform_ring.h"
+#include <glad/glad.h>
+#include <iostream>
+
+static const char* uniformNames[] = {
+    "lineWidth",
+    "edgeMask",
+    "instanceCount",
+    "batchCount",
+    "frustumPlanes",
+    "frustumCull",
+    "lodEye",
+    "pixelsPerUnit",
+    "maxPixelError",
+    "occlusionCull",
+    "hiZ",
+    "hiZSize",
+    "viewProjection",
+    "depthLevel",
+};
+static_assert(sizeof(uniformNames) / sizeof(uniformNames[0]) == static_cast<int>(Uniform::Count),
+              "every Uniform needs a name");
+
+unsigned int compileShader(unsigned int type, const char* source) {
+    unsigned int id = glCreateShader(type);
+    glShaderSource(id, 1, &source, nullptr);
+    glCompileShader(id);
+
+    int success;
+    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(id, 512, nullptr, infoLog);
+        std::cerr << "Shader error:\n" << infoLog << std::endl;
+    }
+    return id;
+}
+
+unsigned int createShaderProgram(const char* vertexSource, const char* fragmentSource, const char* geometrySource,
+                                 bool retrievableBinary) {
+    unsigned int program = glCreateProgram();
+    unsigned int vs = compileShader(GL_VERTEX_SHADER, vertexSource);
+    unsigned int fs = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    unsigned int gs = geometrySource ? compileShader(GL_GEOMETRY_SHADER, geometrySource) : 0;
+
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    if (gs)
+        glAttachShader(program, gs);
+    if (retrievableBinary)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "Program linking error:\n" << infoLog << std::endl;
+    }
+
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    if (gs)
+        glDeleteShader(gs);
+
+    return program;
+}
+
+bool programLinked(unsigned int program) {
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+}
+
+void resolveProgramInterface(ShaderProgram& program) {
+    for (int i = 0; i < static_cast<int>(Uniform::Count); i++)
+        program.locations[i] = glGetUniformLocation(program.id, uniformNames[i]);
+
+    unsigned int frameBlock = glGetUniformBlockIndex(program.id, "Frame");
+    if (frameBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(program.id, frameBlock, frameBlockBinding);
+    unsigned int objectBlock = glGetUniformBlockIndex(program.id, "Object");
+    if (objectBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(program.id, objectBlock, objectBlockBinding);
+}
+
+ShaderProgram linkShaderProgram(const char* vertexSource, const char* fragmentSource, const char* geometrySource) {
+    ShaderProgram program;
+    program.id = createShaderProgram(vertexSource, fragmentSource, geometrySource);
+    resolveProgramInterface(program);
+    return program;
+}
+
+ShaderProgram linkComputeProgram(const char* computeSource) {
+    ShaderProgram program;
+    program.id = glCreateProgram();
+    unsigned int cs = compileShader(GL_COMPUTE_SHADER, computeSource);
+    glAttachShader(program.id, cs);
+    glLinkProgram(program.id);
+
+    int success;
+    glGetProgramiv(program.id, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program.id, 512, nullptr, infoLog);
+        std::cerr << "Program linking error:\n" << infoLog << std::endl;
+    }
+    glDeleteShader(cs);
+
+    for (int i = 0; i < static_cast<int>(Uniform::Count); i++)
+        program.locations[i] = glGetUniformLocation(program.id, uniformNames[i]);
+    return program;
+}
+
+void destroyShaderProgram(ShaderProgram& program) {
+    glDeleteProgram(program.id);
+    program = ShaderProgram();
+}
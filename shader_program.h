@@ -0,0 +1,45 @@
+#pragma once
+
+// Uniforms the renderer sets. Locations are resolved once per program at
+// link time; programs that lack a uniform get -1, which GL ignores.
+enum class Uniform {
+    LineWidth,
+    EdgeMask,
+    InstanceCount,
+    BatchCount,
+    FrustumPlanes,
+    FrustumCull,
+    LodEye,
+    PixelsPerUnit,
+    MaxPixelError,
+    OcclusionCull,
+    HiZ,
+    HiZSize,
+    ViewProjection,
+    DepthLevel,
+    Count
+};
+
+struct ShaderProgram {
+    unsigned int id = 0;
+    int locations[static_cast<int>(Uniform::Count)] = {};
+
+    int location(Uniform uniform) const { return locations[static_cast<int>(uniform)]; }
+};
+
+unsigned int compileShader(unsigned int type, const char* source);
+// retrievableBinary asks the driver to keep the linked binary for
+// glGetProgramBinary.
+unsigned int createShaderProgram(const char* vertexSource, const char* fragmentSource, const char* geometrySource = nullptr,
+                                 bool retrievableBinary = false);
+bool programLinked(unsigned int program);
+
+// Caches the uniform locations of a linked program and attaches its Frame
+// and Object uniform blocks to the binding points UniformRing uses.
+void resolveProgramInterface(ShaderProgram& program);
+
+// Links a program and resolves its interface.
+ShaderProgram linkShaderProgram(const char* vertexSource, const char* fragmentSource, const char* geometrySource = nullptr);
+// Compute shaders need GL 4.3.
+ShaderProgram linkComputeProgram(const char* computeSource);
+void destroyShaderProgram(ShaderProgram& program);
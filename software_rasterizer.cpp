@@ -0,0 +1,822 @@
+#include "software_rasterizer.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SOFTWARE_RASTER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles AVX2 intrinsics anywhere; GCC and Clang need the kernel
+// marked so the rest of the file stays baseline x86-64.
+#if defined(SOFTWARE_RASTER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SOFTWARE_RASTER_AVX2 __attribute__((target("avx2")))
+#else
+#define SOFTWARE_RASTER_AVX2
+#endif
+
+namespace {
+
+const int subpixelBits = 8;
+const float subpixelScale = 256.0f;
+// Window coordinates are kept within this many pixels outside the
+// viewport, so fixed-point positions fit 22 bits and an edge function
+// stays within 32 bits across a tile.
+const float guardBandPixels = 4096.0f;
+// Outlines lie on the surfaces they bound; this much window depth lets
+// them win ties without showing through nearer surfaces.
+const float lineDepthBias = -1.0e-5f;
+const size_t maxClipVertices = 9;
+
+// Work per transform and setup job, and the queue size that forces a
+// flush, which bounds the memory of the clip-space and setup arrays.
+const size_t transformJobVertices = 16384;
+const size_t setupJobPrimitives = 4096;
+const size_t maxQueuedVertices = size_t(1) << 22;
+const size_t maxQueuedPrimitives = size_t(1) << 21;
+
+struct TileJob {
+    uint32_t* color;
+    float* depth;
+    size_t stride;
+    // Full tiles are inside all three edges and skip the edge tests.
+    bool full;
+    // Edge functions at the tile's first pixel and their steps per pixel
+    // in x and y; a pixel is covered where all three are >= 0.
+    int32_t e[3];
+    int32_t a[3];
+    int32_t b[3];
+    float z;
+    float dzdx;
+    float dzdy;
+    uint32_t rgba;
+};
+
+void shadeTileScalar(const TileJob& job) {
+    for (int row = 0; row < SoftwareRasterizer::tileSize; row++) {
+        uint32_t* color = job.color + row * job.stride;
+        float* depth = job.depth + row * job.stride;
+        float zRow = job.z + static_cast<float>(row) * job.dzdy;
+        for (int lane = 0; lane < SoftwareRasterizer::tileSize; lane++) {
+            if (!job.full) {
+                int32_t e0 = job.e[0] + job.a[0] * lane + job.b[0] * row;
+                int32_t e1 = job.e[1] + job.a[1] * lane + job.b[1] * row;
+                int32_t e2 = job.e[2] + job.a[2] * lane + job.b[2] * row;
+                if ((e0 | e1 | e2) < 0)
+                    continue;
+            }
+            float z = zRow + static_cast<float>(lane) * job.dzdx;
+            if (z < depth[lane]) {
+                depth[lane] = z;
+                color[lane] = job.rgba;
+            }
+        }
+    }
+}
+
+#if defined(SOFTWARE_RASTER_X86)
+SOFTWARE_RASTER_AVX2 void shadeTileAvx2(const TileJob& job) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 zStep = _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(job.dzdx));
+    const __m256i color = _mm256_set1_epi32(static_cast<int>(job.rgba));
+    __m256i e0 = _mm256_add_epi32(_mm256_set1_epi32(job.e[0]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(job.a[0])));
+    __m256i e1 = _mm256_add_epi32(_mm256_set1_epi32(job.e[1]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(job.a[1])));
+    __m256i e2 = _mm256_add_epi32(_mm256_set1_epi32(job.e[2]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(job.a[2])));
+    const __m256i b0 = _mm256_set1_epi32(job.b[0]);
+    const __m256i b1 = _mm256_set1_epi32(job.b[1]);
+    const __m256i b2 = _mm256_set1_epi32(job.b[2]);
+
+    for (int row = 0; row < SoftwareRasterizer::tileSize; row++) {
+        float* depth = job.depth + row * job.stride;
+        int* target = reinterpret_cast<int*>(job.color + row * job.stride);
+        __m256 z = _mm256_add_ps(_mm256_set1_ps(job.z + static_cast<float>(row) * job.dzdy), zStep);
+        __m256i mask = _mm256_castps_si256(_mm256_cmp_ps(z, _mm256_loadu_ps(depth), _CMP_LT_OQ));
+        if (!job.full) {
+            // Sign bit of the OR is set wherever any edge is negative
+            __m256i outside = _mm256_srai_epi32(_mm256_or_si256(_mm256_or_si256(e0, e1), e2), 31);
+            mask = _mm256_andnot_si256(outside, mask);
+            e0 = _mm256_add_epi32(e0, b0);
+            e1 = _mm256_add_epi32(e1, b1);
+            e2 = _mm256_add_epi32(e2, b2);
+        }
+        if (_mm256_testz_si256(mask, mask))
+            continue;
+        _mm256_maskstore_ps(depth, mask, z);
+        _mm256_maskstore_epi32(target, mask, color);
+    }
+}
+#endif
+
+bool cpuHasAvx2() {
+#if defined(SOFTWARE_RASTER_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesAvx && (info[1] & (1 << 5));
+#elif defined(SOFTWARE_RASTER_X86)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+// Signed distance to clip plane `plane` (>= 0 inside): near, far, then
+// the guard band's four sides.
+inline float planeDistance(const glm::vec4& v, int plane, float guardX, float guardY) {
+    switch (plane) {
+    case 0: return v.z + v.w;
+    case 1: return v.w - v.z;
+    case 2: return guardX * v.w - v.x;
+    case 3: return guardX * v.w + v.x;
+    case 4: return guardY * v.w - v.y;
+    default: return guardY * v.w + v.y;
+    }
+}
+
+inline unsigned int outcode(const glm::vec4& v, float guardX, float guardY) {
+    unsigned int code = 0;
+    for (int plane = 0; plane < 6; plane++) {
+        if (planeDistance(v, plane, guardX, guardY) < 0.0f)
+            code |= 1u << plane;
+    }
+    return code;
+}
+
+// One transform job's vertex streams in and out, all indexed from the
+// job's first vertex.
+struct VertexBatch {
+    const float* x;
+    const float* y;
+    const float* z;
+    float* clipX;
+    float* clipY;
+    float* clipZ;
+    float* clipW;
+    float* windowX;
+    float* windowY;
+    float* windowZ;
+    uint8_t* outcodes;
+    // Column-major, as glm stores it.
+    const float* mvp;
+    float width;
+    float height;
+    float guardX;
+    float guardY;
+};
+
+// Clip position, outcode and window position of vertices [begin, end).
+// The AVX2 kernel performs the same operations in the same order, so the
+// two agree bit for bit.
+void transformScalar(const VertexBatch& batch, size_t begin, size_t end) {
+    const float* m = batch.mvp;
+    for (size_t i = begin; i < end; i++) {
+        float x = batch.x[i], y = batch.y[i], z = batch.z[i];
+        glm::vec4 clip(m[0] * x + m[4] * y + m[8] * z + m[12], m[1] * x + m[5] * y + m[9] * z + m[13],
+                       m[2] * x + m[6] * y + m[10] * z + m[14], m[3] * x + m[7] * y + m[11] * z + m[15]);
+        batch.clipX[i] = clip.x;
+        batch.clipY[i] = clip.y;
+        batch.clipZ[i] = clip.z;
+        batch.clipW[i] = clip.w;
+        batch.outcodes[i] = static_cast<uint8_t>(outcode(clip, batch.guardX, batch.guardY));
+        float inverseW = 1.0f / clip.w;
+        batch.windowX[i] = (clip.x * inverseW + 1.0f) * 0.5f * batch.width;
+        batch.windowY[i] = (clip.y * inverseW + 1.0f) * 0.5f * batch.height;
+        batch.windowZ[i] = clip.z * inverseW * 0.5f + 0.5f;
+    }
+}
+
+#if defined(SOFTWARE_RASTER_X86)
+// The plane's outcode bit in lanes where distance is negative.
+SOFTWARE_RASTER_AVX2 inline __m256i planeBit(__m256 distance, int plane) {
+    return _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ)),
+                            _mm256_set1_epi32(1 << plane));
+}
+
+SOFTWARE_RASTER_AVX2 void transformAvx2(const VertexBatch& batch, size_t count) {
+    __m256 m[16];
+    for (int k = 0; k < 16; k++)
+        m[k] = _mm256_set1_ps(batch.mvp[k]);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 width = _mm256_set1_ps(batch.width);
+    const __m256 height = _mm256_set1_ps(batch.height);
+    const __m256 guardX = _mm256_set1_ps(batch.guardX);
+    const __m256 guardY = _mm256_set1_ps(batch.guardY);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(batch.x + i);
+        __m256 y = _mm256_loadu_ps(batch.y + i);
+        __m256 z = _mm256_loadu_ps(batch.z + i);
+        __m256 clip[4];
+        for (int row = 0; row < 4; row++) {
+            clip[row] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[row], x), _mm256_mul_ps(m[4 + row], y)),
+                                                    _mm256_mul_ps(m[8 + row], z)),
+                                      m[12 + row]);
+        }
+        _mm256_storeu_ps(batch.clipX + i, clip[0]);
+        _mm256_storeu_ps(batch.clipY + i, clip[1]);
+        _mm256_storeu_ps(batch.clipZ + i, clip[2]);
+        _mm256_storeu_ps(batch.clipW + i, clip[3]);
+
+        __m256 guardW = _mm256_mul_ps(guardX, clip[3]);
+        __m256 guardH = _mm256_mul_ps(guardY, clip[3]);
+        __m256i codes = planeBit(_mm256_add_ps(clip[2], clip[3]), 0);
+        codes = _mm256_or_si256(codes, planeBit(_mm256_sub_ps(clip[3], clip[2]), 1));
+        codes = _mm256_or_si256(codes, planeBit(_mm256_sub_ps(guardW, clip[0]), 2));
+        codes = _mm256_or_si256(codes, planeBit(_mm256_add_ps(guardW, clip[0]), 3));
+        codes = _mm256_or_si256(codes, planeBit(_mm256_sub_ps(guardH, clip[1]), 4));
+        codes = _mm256_or_si256(codes, planeBit(_mm256_add_ps(guardH, clip[1]), 5));
+        alignas(32) int32_t laneCodes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneCodes), codes);
+        for (int lane = 0; lane < 8; lane++)
+            batch.outcodes[i + lane] = static_cast<uint8_t>(laneCodes[lane]);
+
+        __m256 inverseW = _mm256_div_ps(one, clip[3]);
+        _mm256_storeu_ps(batch.windowX + i,
+                         _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(clip[0], inverseW), one), half), width));
+        _mm256_storeu_ps(batch.windowY + i,
+                         _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(clip[1], inverseW), one), half), height));
+        _mm256_storeu_ps(batch.windowZ + i, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(clip[2], inverseW), half), half));
+    }
+    transformScalar(batch, i, count);
+}
+#endif
+
+size_t transformHash(const VertexStreams& positions, const glm::mat4& mvp) {
+    uint32_t words[16];
+    std::memcpy(words, &mvp, sizeof(words));
+    uint64_t hash = 1469598103934665603ull ^ static_cast<uint64_t>(reinterpret_cast<uintptr_t>(positions.x));
+    for (uint32_t word : words)
+        hash = (hash ^ word) * 1099511628211ull;
+    return static_cast<size_t>(hash ^ (hash >> 29));
+}
+
+}
+
+PositionStreams splitPositions(const float* positions, size_t vertexCount) {
+    PositionStreams streams;
+    streams.x.resize(vertexCount);
+    streams.y.resize(vertexCount);
+    streams.z.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        streams.x[i] = positions[i * 3];
+        streams.y[i] = positions[i * 3 + 1];
+        streams.z[i] = positions[i * 3 + 2];
+    }
+    return streams;
+}
+
+uint32_t packColor(const glm::vec3& color) {
+    auto channel = [](float value) {
+        return static_cast<uint32_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+    };
+    return channel(color.x) | (channel(color.y) << 8) | (channel(color.z) << 16) | 0xff000000u;
+}
+
+SoftwareRasterizer::SoftwareRasterizer() : avx2_(cpuHasAvx2()) {}
+
+void SoftwareRasterizer::setSimd(bool enabled) {
+    avx2_ = enabled && cpuHasAvx2();
+}
+
+void SoftwareRasterizer::resize(int width, int height) {
+    finish();
+    width_ = width;
+    height_ = height;
+    stride_ = static_cast<size_t>((width + tileSize - 1) / tileSize * tileSize);
+    size_t rows = static_cast<size_t>((height + tileSize - 1) / tileSize * tileSize);
+    color_.assign(stride_ * rows, 0);
+    depth_.assign(stride_ * rows, 1.0f);
+    binsX_ = (width + binSize - 1) / binSize;
+    binsY_ = (height + binSize - 1) / binSize;
+    guardX_ = 1.0f + 2.0f * guardBandPixels / width;
+    guardY_ = 1.0f + 2.0f * guardBandPixels / height;
+}
+
+void SoftwareRasterizer::clear(const glm::vec3& color) {
+    // Everything queued would be cleared away anyway
+    draws_.clear();
+    std::fill(transformTable_.begin(), transformTable_.end(), 0u);
+    queuedVertices_ = 0;
+    queuedPrimitives_ = 0;
+    std::fill(color_.begin(), color_.end(), packColor(color));
+    std::fill(depth_.begin(), depth_.end(), 1.0f);
+}
+
+void SoftwareRasterizer::drawTriangles(const VertexStreams& positions, const unsigned int* indices, size_t indexCount,
+                                       const glm::mat4& mvp, const glm::vec3& color) {
+    Draw draw = { positions, indices, indexCount / 3, mvp, packColor(color), false, 0.0f, 0, 0 };
+    queue(draw);
+}
+
+void SoftwareRasterizer::drawLines(const VertexStreams& positions, const unsigned int* indices, size_t indexCount,
+                                   const glm::mat4& mvp, const glm::vec3& color, float width) {
+    Draw draw = { positions, indices, indexCount / 2, mvp, packColor(color), true, std::max(width, 1.0f) * 0.5f, 0, 0 };
+    queue(draw);
+}
+
+void SoftwareRasterizer::queue(Draw draw) {
+    if (draw.primitiveCount == 0)
+        return;
+    const Draw* cached = findTransform(draw);
+    size_t vertices = cached ? 0 : draw.positions.count;
+    if (!draws_.empty()
+        && (queuedVertices_ + vertices > maxQueuedVertices || queuedPrimitives_ + draw.primitiveCount > maxQueuedPrimitives)) {
+        finish();
+        cached = nullptr;
+        vertices = draw.positions.count;
+    }
+
+    if (cached) {
+        draw.firstVertex = cached->firstVertex;
+        draw.transformCount = 0;
+        stats_.reusedVertices += draw.positions.count;
+    }
+    else {
+        draw.firstVertex = queuedVertices_;
+        draw.transformCount = vertices;
+        stats_.vertices += vertices;
+    }
+    draws_.push_back(draw);
+    if (!cached)
+        insertTransform(draws_.size() - 1);
+    queuedVertices_ += vertices;
+    queuedPrimitives_ += draw.primitiveCount;
+}
+
+const SoftwareRasterizer::Draw* SoftwareRasterizer::findTransform(const Draw& draw) const {
+    if (transformTable_.empty())
+        return nullptr;
+    size_t mask = transformTable_.size() - 1;
+    for (size_t slot = transformHash(draw.positions, draw.mvp) & mask; transformTable_[slot]; slot = (slot + 1) & mask) {
+        const Draw& other = draws_[transformTable_[slot] - 1];
+        if (other.positions.x == draw.positions.x && other.positions.count == draw.positions.count
+            && std::memcmp(&other.mvp, &draw.mvp, sizeof(glm::mat4)) == 0)
+            return &other;
+    }
+    return nullptr;
+}
+
+void SoftwareRasterizer::insertTransform(size_t draw) {
+    // Open addressing kept at most half full; entries are draw index + 1
+    if (2 * (transformEntries_ + 1) > transformTable_.size()) {
+        transformTable_.assign(std::max<size_t>(64, transformTable_.size() * 2), 0u);
+        transformEntries_ = 0;
+        for (size_t d = 0; d < draw; d++) {
+            if (draws_[d].transformCount > 0)
+                insertTransform(d);
+        }
+    }
+    size_t mask = transformTable_.size() - 1;
+    size_t slot = transformHash(draws_[draw].positions, draws_[draw].mvp) & mask;
+    while (transformTable_[slot])
+        slot = (slot + 1) & mask;
+    transformTable_[slot] = static_cast<uint32_t>(draw + 1);
+    transformEntries_++;
+}
+
+void SoftwareRasterizer::parallel(size_t count, const std::function<void(size_t, unsigned int)>& body) {
+    if (pool_) {
+        pool_->parallelForStealing(count, body);
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+        body(i, 0);
+}
+
+void SoftwareRasterizer::finish() {
+    if (draws_.empty())
+        return;
+    workerStats_.assign(pool_ ? pool_->participantCount() : 1, SoftwareRasterStats());
+
+    // Transform every distinct (positions, mvp) pair once
+    transformed_.resize(queuedVertices_);
+    splitJobs(true, transformJobVertices);
+    parallel(jobs_.size(), [this](size_t j, unsigned int) {
+        forEachPiece(jobs_[j], true, [this](const Draw& draw, size_t first, size_t count) {
+            size_t out = draw.firstVertex + first;
+            VertexBatch batch = { draw.positions.x + first, draw.positions.y + first, draw.positions.z + first,
+                                  &transformed_.clipX[out], &transformed_.clipY[out], &transformed_.clipZ[out],
+                                  &transformed_.clipW[out], &transformed_.windowX[out], &transformed_.windowY[out],
+                                  &transformed_.windowZ[out], &transformed_.outcodes[out], &draw.mvp[0][0],
+                                  static_cast<float>(width_), static_cast<float>(height_), guardX_, guardY_ };
+#if defined(SOFTWARE_RASTER_X86)
+            if (avx2_) {
+                transformAvx2(batch, count);
+                return;
+            }
+#endif
+            transformScalar(batch, 0, count);
+        });
+    });
+
+    // Set up and bin triangles, each job into its own arena
+    splitJobs(false, setupJobPrimitives);
+    if (arenas_.size() < jobs_.size())
+        arenas_.resize(jobs_.size());
+    parallel(jobs_.size(), [this](size_t j, unsigned int worker) {
+        setupJob(jobs_[j], arenas_[j], workerStats_[worker]);
+    });
+
+    // Rasterize bins; each owns its pixels, so they need no locking
+    size_t bins = static_cast<size_t>(binsX_) * binsY_;
+    parallel(bins, [this](size_t bin, unsigned int worker) { rasterizeBin(bin, workerStats_[worker]); });
+
+    for (const SoftwareRasterStats& worker : workerStats_) {
+        stats_.triangles += worker.triangles;
+        stats_.clippedTriangles += worker.clippedTriangles;
+        stats_.discardedTriangles += worker.discardedTriangles;
+        stats_.lines += worker.lines;
+        stats_.binnedTriangles += worker.binnedTriangles;
+        stats_.busyBins += worker.busyBins;
+        stats_.tilesRejected += worker.tilesRejected;
+        stats_.tilesPartial += worker.tilesPartial;
+        stats_.tilesFull += worker.tilesFull;
+    }
+    draws_.clear();
+    jobs_.clear();
+    std::fill(transformTable_.begin(), transformTable_.end(), 0u);
+    transformEntries_ = 0;
+    queuedVertices_ = 0;
+    queuedPrimitives_ = 0;
+}
+
+void SoftwareRasterizer::splitJobs(bool vertices, size_t size) {
+    jobs_.clear();
+    size_t filled = size;
+    for (size_t d = 0; d < draws_.size(); d++) {
+        size_t total = vertices ? draws_[d].transformCount : draws_[d].primitiveCount;
+        for (size_t first = 0; first < total;) {
+            if (filled == size) {
+                jobs_.push_back({ d, first, 0 });
+                filled = 0;
+            }
+            size_t count = std::min(size - filled, total - first);
+            jobs_.back().count += count;
+            filled += count;
+            first += count;
+        }
+    }
+}
+
+void SoftwareRasterizer::forEachPiece(const Job& job, bool vertices,
+                                      const std::function<void(const Draw&, size_t, size_t)>& body) const {
+    size_t first = job.first;
+    for (size_t d = job.draw, remaining = job.count; remaining > 0; d++, first = 0) {
+        size_t total = vertices ? draws_[d].transformCount : draws_[d].primitiveCount;
+        size_t count = std::min(remaining, total - first);
+        if (count > 0)
+            body(draws_[d], first, count);
+        remaining -= count;
+    }
+}
+
+glm::vec4 SoftwareRasterizer::clipVertex(const Draw& draw, size_t vertex) const {
+    size_t i = draw.firstVertex + vertex;
+    return glm::vec4(transformed_.clipX[i], transformed_.clipY[i], transformed_.clipZ[i], transformed_.clipW[i]);
+}
+
+SoftwareRasterizer::WindowVertex SoftwareRasterizer::windowVertex(const Draw& draw, size_t vertex) const {
+    size_t i = draw.firstVertex + vertex;
+    return { transformed_.windowX[i], transformed_.windowY[i], transformed_.windowZ[i] };
+}
+
+SoftwareRasterizer::WindowVertex SoftwareRasterizer::toWindow(const glm::vec4& clip) const {
+    float inverseW = 1.0f / clip.w;
+    WindowVertex vertex;
+    vertex.x = (clip.x * inverseW + 1.0f) * 0.5f * width_;
+    vertex.y = (clip.y * inverseW + 1.0f) * 0.5f * height_;
+    vertex.z = clip.z * inverseW * 0.5f + 0.5f;
+    return vertex;
+}
+
+void SoftwareRasterizer::setupJob(const Job& job, SetupArena& arena, SoftwareRasterStats& stats) const {
+    arena.triangles.clear();
+    forEachPiece(job, false, [&](const Draw& draw, size_t first, size_t count) {
+        setupPrimitives(draw, first, count, arena, stats);
+    });
+    binJob(arena, stats);
+}
+
+void SoftwareRasterizer::setupPrimitives(const Draw& draw, size_t first, size_t count, SetupArena& arena,
+                                         SoftwareRasterStats& stats) const {
+    // Vertices were transformed, classified and projected once each; only
+    // primitives that cross a plane go back to clip space.
+    const uint8_t* outcodes = &transformed_.outcodes[draw.firstVertex];
+    if (draw.lines) {
+        const unsigned int* indices = draw.indices + first * 2;
+        for (size_t i = 0; i < count; i++) {
+            size_t a = indices[i * 2], b = indices[i * 2 + 1];
+            if (outcodes[a] & outcodes[b])
+                continue;
+            if (outcodes[a] | outcodes[b])
+                setupLine(clipVertex(draw, a), clipVertex(draw, b), draw.rgba, draw.halfWidth, arena);
+            else
+                widenLine(windowVertex(draw, a), windowVertex(draw, b), draw.rgba, draw.halfWidth, arena);
+        }
+        stats.lines += count;
+    }
+    else {
+        const unsigned int* indices = draw.indices + first * 3;
+        for (size_t i = 0; i < count; i++) {
+            size_t a = indices[i * 3], b = indices[i * 3 + 1], c = indices[i * 3 + 2];
+            unsigned int codeA = outcodes[a], codeB = outcodes[b], codeC = outcodes[c];
+            if (codeA & codeB & codeC) {
+                stats.discardedTriangles++;
+            }
+            else if (codeA | codeB | codeC) {
+                stats.clippedTriangles++;
+                clipTriangle(clipVertex(draw, a), clipVertex(draw, b), clipVertex(draw, c), draw.rgba, arena, stats);
+            }
+            else {
+                TriangleSetup setup;
+                if (setupTriangle(windowVertex(draw, a), windowVertex(draw, b), windowVertex(draw, c), draw.rgba, 0.0f,
+                                  setup))
+                    arena.triangles.push_back(setup);
+                else
+                    stats.discardedTriangles++;
+            }
+        }
+        stats.triangles += count;
+    }
+}
+
+void SoftwareRasterizer::binJob(SetupArena& arena, SoftwareRasterStats& stats) const {
+    // Reference each triangle from every bin its bounds touch, then
+    // counting-sort the references by bin, keeping submission order.
+    arena.refBins.clear();
+    arena.refTriangles.clear();
+    for (size_t t = 0; t < arena.triangles.size(); t++) {
+        const TriangleSetup& setup = arena.triangles[t];
+        for (int binY = setup.minY / binSize; binY <= setup.maxY / binSize; binY++) {
+            for (int binX = setup.minX / binSize; binX <= setup.maxX / binSize; binX++) {
+                arena.refBins.push_back(static_cast<uint32_t>(binY * binsX_ + binX));
+                arena.refTriangles.push_back(static_cast<uint32_t>(t));
+            }
+        }
+    }
+    size_t bins = static_cast<size_t>(binsX_) * binsY_;
+    arena.binStart.assign(bins + 1, 0);
+    for (uint32_t bin : arena.refBins)
+        arena.binStart[bin + 1]++;
+    for (size_t bin = 0; bin < bins; bin++)
+        arena.binStart[bin + 1] += arena.binStart[bin];
+    arena.binned.resize(arena.refTriangles.size());
+    for (size_t r = 0; r < arena.refBins.size(); r++)
+        arena.binned[arena.binStart[arena.refBins[r]]++] = arena.refTriangles[r];
+    // The fill pass left each start at the next bin's; shift them back
+    for (size_t bin = bins; bin > 0; bin--)
+        arena.binStart[bin] = arena.binStart[bin - 1];
+    arena.binStart[0] = 0;
+    stats.binnedTriangles += arena.refBins.size();
+}
+
+void SoftwareRasterizer::setupLine(const glm::vec4& p0, const glm::vec4& p1, uint32_t rgba, float halfWidth,
+                                   SetupArena& arena) const {
+    // Parametric clip of the segment against each plane
+    float t0 = 0.0f, t1 = 1.0f;
+    for (int plane = 0; plane < 6; plane++) {
+        float d0 = planeDistance(p0, plane, guardX_, guardY_);
+        float d1 = planeDistance(p1, plane, guardX_, guardY_);
+        if (d0 < 0.0f && d1 < 0.0f)
+            return;
+        else if (d0 < 0.0f)
+            t0 = std::max(t0, d0 / (d0 - d1));
+        else if (d1 < 0.0f)
+            t1 = std::min(t1, d0 / (d0 - d1));
+    }
+    if (t0 >= t1)
+        return;
+    widenLine(toWindow(p0 + (p1 - p0) * t0), toWindow(p0 + (p1 - p0) * t1), rgba, halfWidth, arena);
+}
+
+void SoftwareRasterizer::widenLine(const WindowVertex& a, const WindowVertex& b, uint32_t rgba, float halfWidth,
+                                   SetupArena& arena) const {
+    // Parallelogram offset along the minor axis, as GL widens lines
+    float offsetX = 0.0f, offsetY = 0.0f;
+    if (std::fabs(b.x - a.x) >= std::fabs(b.y - a.y))
+        offsetY = halfWidth;
+    else
+        offsetX = halfWidth;
+    WindowVertex a0 = { a.x - offsetX, a.y - offsetY, a.z };
+    WindowVertex a1 = { a.x + offsetX, a.y + offsetY, a.z };
+    WindowVertex b0 = { b.x - offsetX, b.y - offsetY, b.z };
+    WindowVertex b1 = { b.x + offsetX, b.y + offsetY, b.z };
+    TriangleSetup setup;
+    if (setupTriangle(a0, b0, b1, rgba, lineDepthBias, setup))
+        arena.triangles.push_back(setup);
+    if (setupTriangle(a0, b1, a1, rgba, lineDepthBias, setup))
+        arena.triangles.push_back(setup);
+}
+
+void SoftwareRasterizer::clipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, uint32_t rgba,
+                                      SetupArena& arena, SoftwareRasterStats& stats) const {
+    glm::vec4 buffers[2][maxClipVertices];
+    size_t counts[2] = { 3, 0 };
+    buffers[0][0] = a;
+    buffers[0][1] = b;
+    buffers[0][2] = c;
+    int current = 0;
+
+    unsigned int planes = outcode(a, guardX_, guardY_) | outcode(b, guardX_, guardY_) | outcode(c, guardX_, guardY_);
+    for (int plane = 0; plane < 6; plane++) {
+        if (!(planes & (1u << plane)))
+            continue;
+        const glm::vec4* in = buffers[current];
+        glm::vec4* out = buffers[1 - current];
+        size_t inCount = counts[current];
+        size_t outCount = 0;
+        for (size_t i = 0; i < inCount; i++) {
+            const glm::vec4& p = in[i];
+            const glm::vec4& q = in[(i + 1) % inCount];
+            float dp = planeDistance(p, plane, guardX_, guardY_);
+            float dq = planeDistance(q, plane, guardX_, guardY_);
+            if (dp >= 0.0f)
+                out[outCount++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f))
+                out[outCount++] = p + (q - p) * (dp / (dp - dq));
+        }
+        counts[1 - current] = outCount;
+        current = 1 - current;
+        if (outCount < 3) {
+            stats.discardedTriangles++;
+            return;
+        }
+    }
+
+    const glm::vec4* polygon = buffers[current];
+    WindowVertex first = toWindow(polygon[0]);
+    WindowVertex previous = toWindow(polygon[1]);
+    for (size_t i = 2; i < counts[current]; i++) {
+        WindowVertex next = toWindow(polygon[i]);
+        TriangleSetup setup;
+        if (setupTriangle(first, previous, next, rgba, 0.0f, setup))
+            arena.triangles.push_back(setup);
+        previous = next;
+    }
+}
+
+bool SoftwareRasterizer::setupTriangle(const WindowVertex& va, const WindowVertex& vb, const WindowVertex& vc,
+                                       uint32_t rgba, float depthBias, TriangleSetup& setup) const {
+    // Snap to the sub-pixel grid; all coverage decisions use these.
+    int64_t x[3] = { std::llround(va.x * subpixelScale), std::llround(vb.x * subpixelScale),
+                     std::llround(vc.x * subpixelScale) };
+    int64_t y[3] = { std::llround(va.y * subpixelScale), std::llround(vb.y * subpixelScale),
+                     std::llround(vc.y * subpixelScale) };
+    float z[3] = { va.z, vb.z, vc.z };
+
+    int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0)
+        return false;
+    // Both windings are drawn; make it counter-clockwise so the inside of
+    // every edge is positive.
+    if (area < 0) {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+    }
+
+    setup.minX = std::max(static_cast<int>((std::min({ x[0], x[1], x[2] }) - 128) >> subpixelBits), 0);
+    setup.maxX = std::min(static_cast<int>((std::max({ x[0], x[1], x[2] }) - 128) >> subpixelBits), width_ - 1);
+    setup.minY = std::max(static_cast<int>((std::min({ y[0], y[1], y[2] }) - 128) >> subpixelBits), 0);
+    setup.maxY = std::min(static_cast<int>((std::max({ y[0], y[1], y[2] }) - 128) >> subpixelBits), height_ - 1);
+    if (setup.minX > setup.maxX || setup.minY > setup.maxY)
+        return false;
+
+    // Edge i runs from vertex i to i + 1. At the centre of pixel (px, py),
+    // E = 256 * (a * px + b * py) + c in sub-pixel units squared; only the
+    // sign matters, so the low eight bits of c are floored away and the
+    // functions are stepped per pixel. Ties count as inside only for top
+    // and left edges.
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+        int64_t a = y[i] - y[j];
+        int64_t b = x[j] - x[i];
+        int64_t edge = a * (128 - x[i]) + b * (128 - y[i]);
+        bool topLeft = a > 0 || (a == 0 && b < 0);
+        if (!topLeft)
+            edge -= 1;
+        setup.a[i] = static_cast<int32_t>(a);
+        setup.b[i] = static_cast<int32_t>(b);
+        setup.c[i] = edge >> subpixelBits;
+    }
+
+    // Depth plane through the snapped vertices, evaluated at pixel centres.
+    double fx[3], fy[3];
+    for (int i = 0; i < 3; i++) {
+        fx[i] = x[i] / static_cast<double>(subpixelScale);
+        fy[i] = y[i] / static_cast<double>(subpixelScale);
+    }
+    double determinant = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fx[2] - fx[0]) * (fy[1] - fy[0]);
+    setup.dzdx = ((z[1] - z[0]) * (fy[2] - fy[0]) - (z[2] - z[0]) * (fy[1] - fy[0])) / determinant;
+    setup.dzdy = ((z[2] - z[0]) * (fx[1] - fx[0]) - (z[1] - z[0]) * (fx[2] - fx[0])) / determinant;
+    setup.zOrigin = z[0] + setup.dzdx * (0.5 - fx[0]) + setup.dzdy * (0.5 - fy[0]) + depthBias;
+    setup.rgba = rgba;
+    return true;
+}
+
+void SoftwareRasterizer::rasterizeBin(size_t bin, SoftwareRasterStats& stats) {
+    int binX = static_cast<int>(bin % binsX_) * binSize;
+    int binY = static_cast<int>(bin / binsX_) * binSize;
+    void (*shadeTile)(const TileJob&) = shadeTileScalar;
+#if defined(SOFTWARE_RASTER_X86)
+    if (avx2_)
+        shadeTile = shadeTileAvx2;
+#endif
+
+    bool busy = false;
+    for (size_t j = 0; j < jobs_.size(); j++) {
+        const SetupArena& arena = arenas_[j];
+        for (uint32_t r = arena.binStart[bin]; r < arena.binStart[bin + 1]; r++) {
+            const TriangleSetup& setup = arena.triangles[arena.binned[r]];
+            busy = true;
+            int minX = std::max(setup.minX, binX), maxX = std::min(setup.maxX, binX + binSize - 1);
+            int minY = std::max(setup.minY, binY), maxY = std::min(setup.maxY, binY + binSize - 1);
+
+            TileJob job;
+            job.stride = stride_;
+            job.dzdx = static_cast<float>(setup.dzdx);
+            job.dzdy = static_cast<float>(setup.dzdy);
+            job.rgba = setup.rgba;
+
+            // Range of an edge function over a square of `size` pixels from (px, py).
+            auto classify = [&](int px, int py, int size, int64_t edgeMin[3], int64_t edgeMax[3]) {
+                int64_t span = size - 1;
+                for (int i = 0; i < 3; i++) {
+                    int64_t a = setup.a[i], b = setup.b[i];
+                    int64_t origin = a * px + b * py + setup.c[i];
+                    edgeMin[i] = origin + std::min<int64_t>(0, a * span) + std::min<int64_t>(0, b * span);
+                    edgeMax[i] = origin + std::max<int64_t>(0, a * span) + std::max<int64_t>(0, b * span);
+                }
+            };
+            auto shade = [&](int px, int py, bool full) {
+                job.color = &color_[py * stride_ + px];
+                job.depth = &depth_[py * stride_ + px];
+                job.full = full;
+                job.z = static_cast<float>(setup.zOrigin + setup.dzdx * px + setup.dzdy * py);
+                if (!full) {
+                    // Edges the tile is wholly inside never fail; the rest
+                    // cross the tile, so their values here fit 32 bits.
+                    int64_t edgeMin[3], edgeMax[3];
+                    classify(px, py, tileSize, edgeMin, edgeMax);
+                    for (int i = 0; i < 3; i++) {
+                        bool inside = edgeMin[i] >= 0;
+                        job.e[i] = inside ? 0 : static_cast<int32_t>(int64_t(setup.a[i]) * px
+                                                                     + int64_t(setup.b[i]) * py + setup.c[i]);
+                        job.a[i] = inside ? 0 : setup.a[i];
+                        job.b[i] = inside ? 0 : setup.b[i];
+                    }
+                }
+                shadeTile(job);
+            };
+
+            // Blocks and tiles nest inside the bin, so none cross into another
+            int tileMinX = minX & ~(tileSize - 1), tileMinY = minY & ~(tileSize - 1);
+            for (int blockY = minY & ~(blockSize - 1); blockY <= maxY; blockY += blockSize) {
+                for (int blockX = minX & ~(blockSize - 1); blockX <= maxX; blockX += blockSize) {
+                    int64_t edgeMin[3], edgeMax[3];
+                    classify(blockX, blockY, blockSize, edgeMin, edgeMax);
+                    if (edgeMax[0] < 0 || edgeMax[1] < 0 || edgeMax[2] < 0)
+                        continue;
+                    bool blockFull = edgeMin[0] >= 0 && edgeMin[1] >= 0 && edgeMin[2] >= 0;
+
+                    int startY = std::max(blockY, tileMinY), endY = std::min(blockY + blockSize - 1, maxY);
+                    int startX = std::max(blockX, tileMinX), endX = std::min(blockX + blockSize - 1, maxX);
+                    for (int tileY = startY; tileY <= endY; tileY += tileSize) {
+                        for (int tileX = startX; tileX <= endX; tileX += tileSize) {
+                            if (blockFull) {
+                                stats.tilesFull++;
+                                shade(tileX, tileY, true);
+                                continue;
+                            }
+                            classify(tileX, tileY, tileSize, edgeMin, edgeMax);
+                            if (edgeMax[0] < 0 || edgeMax[1] < 0 || edgeMax[2] < 0) {
+                                stats.tilesRejected++;
+                            }
+                            else if (edgeMin[0] >= 0 && edgeMin[1] >= 0 && edgeMin[2] >= 0) {
+                                stats.tilesFull++;
+                                shade(tileX, tileY, true);
+                            }
+                            else {
+                                stats.tilesPartial++;
+                                shade(tileX, tileY, false);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (busy)
+        stats.busyBins++;
+}
@@ -0,0 +1,247 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class ThreadPool;
+
+// Positions as separate x, y and z arrays, the layout the transform stage
+// loads eight vertices at a time from.
+struct VertexStreams {
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* z = nullptr;
+    size_t count = 0;
+};
+
+struct PositionStreams {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    VertexStreams view() const {
+        VertexStreams streams;
+        streams.x = x.data();
+        streams.y = y.data();
+        streams.z = z.data();
+        streams.count = x.size();
+        return streams;
+    }
+};
+
+// Splits interleaved xyz positions (Mesh::vertices) into streams.
+PositionStreams splitPositions(const float* positions, size_t vertexCount);
+
+struct SoftwareRasterStats {
+    // Vertices transformed, and vertices of draws that reused the
+    // transform of an earlier draw with the same positions and matrix.
+    size_t vertices = 0;
+    size_t reusedVertices = 0;
+    size_t triangles = 0;
+    // Triangles that needed clipping, and the ones discarded as offscreen,
+    // behind the camera or degenerate.
+    size_t clippedTriangles = 0;
+    size_t discardedTriangles = 0;
+    size_t lines = 0;
+    // Triangle references sorted into bins, and bins with any to draw.
+    size_t binnedTriangles = 0;
+    size_t busyBins = 0;
+    size_t tilesRejected = 0;
+    size_t tilesPartial = 0;
+    size_t tilesFull = 0;
+};
+
+// CPU rasterizer following the GL conventions the viewer relies on:
+// clip-space input clipped to the view volume, pixel centres at
+// half-integers, window origin at the bottom left, depth as window z in
+// [0, 1] tested with GL_LESS, no face culling. Triangles are set up with
+// 8-bit sub-pixel fixed-point edge functions and a top-left fill rule, so
+// shared edges are drawn exactly once, and walked in 32x32 blocks of 8x8
+// tiles: blocks and tiles outside an edge are skipped and tiles inside all
+// three skip the edge tests. Tile rows are evaluated eight pixels at a
+// time with AVX2 when the CPU has it.
+//
+// Draws are queued and rasterized by finish() in three stages, each split
+// across the thread pool: vertex transform (clip position, outcode and
+// window position of every vertex, eight at a time with AVX2, shared by
+// all primitives using it and by later draws of the same positions under
+// the same matrix, such as an outline over its fill), triangle setup with binning
+// into binSize squares, and rasterization of the bins, each by one thread
+// so no two touch the same pixels. Bins replay their triangles in
+// submission order, so the image does not depend on the thread count.
+class SoftwareRasterizer {
+public:
+    static const int tileSize = 8;
+    static const int blockSize = 32;
+    static const int binSize = 64;
+
+    SoftwareRasterizer();
+
+    // Storage is padded to whole tiles; rows are stride() pixels apart.
+    void resize(int width, int height);
+    // Drops queued draws and fills both targets.
+    void clear(const glm::vec3& color);
+
+    // Null (the default) runs every stage on the calling thread.
+    void setThreadPool(ThreadPool* pool) { pool_ = pool; }
+
+    // Flat-coloured triangles over positions, transformed by mvp.
+    // positions and indices must stay valid until finish().
+    void drawTriangles(const VertexStreams& positions, const unsigned int* indices, size_t indexCount,
+                       const glm::mat4& mvp, const glm::vec3& color);
+    // GL_LINES over index pairs, widened like non-antialiased GL wide
+    // lines: width pixels across the line's minor axis. Lines pass the
+    // depth test where they lie on a surface, so outlines show on the
+    // faces they bound.
+    void drawLines(const VertexStreams& positions, const unsigned int* indices, size_t indexCount,
+                   const glm::mat4& mvp, const glm::vec3& color, float width);
+    // Rasterizes everything queued. Draws also flush on their own once
+    // enough work is queued.
+    void finish();
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t stride() const { return stride_; }
+    // RGBA8 with red in the low byte, bottom row first like glReadPixels.
+    // Complete after finish().
+    const uint32_t* pixels() const { return color_.data(); }
+    const float* depth() const { return depth_.data(); }
+
+    // Tiles are shaded with the AVX2 kernel when enabled and the CPU has
+    // it; the scalar kernel gives identical results.
+    void setSimd(bool enabled);
+    bool simd() const { return avx2_; }
+    const SoftwareRasterStats& stats() const { return stats_; }
+    void resetStats() { stats_ = SoftwareRasterStats(); }
+
+private:
+    struct WindowVertex {
+        float x, y, z;
+    };
+
+    struct Draw {
+        VertexStreams positions;
+        const unsigned int* indices;
+        // Triangles or lines.
+        size_t primitiveCount;
+        glm::mat4 mvp;
+        uint32_t rgba;
+        bool lines;
+        float halfWidth;
+        // Where the draw's transformed vertices start in transformed_, and
+        // how many it transforms there: 0 when it reuses an earlier draw's.
+        size_t firstVertex;
+        size_t transformCount;
+    };
+
+    // Transform stage output, one entry per queued vertex.
+    struct TransformedVertices {
+        std::vector<float> clipX, clipY, clipZ, clipW;
+        std::vector<float> windowX, windowY, windowZ;
+        // Bit i set when outside clip plane i (near, far, guard band).
+        std::vector<uint8_t> outcodes;
+
+        void resize(size_t count) {
+            for (std::vector<float>* stream : { &clipX, &clipY, &clipZ, &clipW, &windowX, &windowY, &windowZ })
+                stream->resize(count);
+            outcodes.resize(count);
+        }
+    };
+
+    // count vertices or primitives from first of draw on, running into
+    // the following draws; the unit of work of the transform and setup
+    // stages.
+    struct Job {
+        size_t draw;
+        size_t first;
+        size_t count;
+    };
+
+    // Edge functions (E = a * px + b * py + c at pixel (px, py)) and depth
+    // plane of one triangle, clamped to the viewport.
+    struct TriangleSetup {
+        int32_t a[3];
+        int32_t b[3];
+        int64_t c[3];
+        double zOrigin;
+        double dzdx;
+        double dzdy;
+        int minX, minY, maxX, maxY;
+        uint32_t rgba;
+    };
+
+    // Output of one setup job: its triangles and their bin references,
+    // sorted by bin. Kept across flushes, so once the arenas have grown to
+    // the scene the stages allocate nothing.
+    struct SetupArena {
+        std::vector<TriangleSetup> triangles;
+        std::vector<uint32_t> refBins;
+        std::vector<uint32_t> refTriangles;
+        // Triangles of bin i are binned[binStart[i]] to binned[binStart[i + 1]].
+        std::vector<uint32_t> binStart;
+        std::vector<uint32_t> binned;
+    };
+
+    void queue(Draw draw);
+    // Earlier queued draw with the same positions and matrix, or null.
+    const Draw* findTransform(const Draw& draw) const;
+    void insertTransform(size_t draw);
+    // Cuts the queued draws' vertices (or primitives) into jobs of size,
+    // packing small draws together so per-job costs stay amortized.
+    void splitJobs(bool vertices, size_t size);
+    // Calls body(draw, first, count) for each draw's part of job.
+    void forEachPiece(const Job& job, bool vertices,
+                      const std::function<void(const Draw&, size_t, size_t)>& body) const;
+    // Runs body over [0, count) on the pool, or inline without one.
+    void parallel(size_t count, const std::function<void(size_t, unsigned int)>& body);
+
+    glm::vec4 clipVertex(const Draw& draw, size_t vertex) const;
+    WindowVertex windowVertex(const Draw& draw, size_t vertex) const;
+    WindowVertex toWindow(const glm::vec4& clip) const;
+    void setupJob(const Job& job, SetupArena& arena, SoftwareRasterStats& stats) const;
+    void setupPrimitives(const Draw& draw, size_t first, size_t count, SetupArena& arena,
+                         SoftwareRasterStats& stats) const;
+    // References each of the arena's triangles from the bins it overlaps.
+    void binJob(SetupArena& arena, SoftwareRasterStats& stats) const;
+    // Clips against the near and far planes and the guard band, then sets
+    // up the resulting fan.
+    void clipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, uint32_t rgba, SetupArena& arena,
+                      SoftwareRasterStats& stats) const;
+    void setupLine(const glm::vec4& p0, const glm::vec4& p1, uint32_t rgba, float halfWidth, SetupArena& arena) const;
+    void widenLine(const WindowVertex& a, const WindowVertex& b, uint32_t rgba, float halfWidth,
+                   SetupArena& arena) const;
+    bool setupTriangle(const WindowVertex& a, const WindowVertex& b, const WindowVertex& c, uint32_t rgba,
+                       float depthBias, TriangleSetup& setup) const;
+    void rasterizeBin(size_t bin, SoftwareRasterStats& stats);
+
+    int width_ = 0;
+    int height_ = 0;
+    size_t stride_ = 0;
+    int binsX_ = 0;
+    int binsY_ = 0;
+    std::vector<uint32_t> color_;
+    std::vector<float> depth_;
+    // Clip-space x and y limits of the guard band, as multiples of w.
+    float guardX_ = 1.0f;
+    float guardY_ = 1.0f;
+    bool avx2_ = false;
+    ThreadPool* pool_ = nullptr;
+
+    std::vector<Draw> draws_;
+    size_t queuedVertices_ = 0;
+    size_t queuedPrimitives_ = 0;
+    TransformedVertices transformed_;
+    // Open-addressed (positions, mvp) -> draw index + 1 of the draw that
+    // transformed them this flush; 0 is empty.
+    std::vector<uint32_t> transformTable_;
+    size_t transformEntries_ = 0;
+    std::vector<Job> jobs_;
+    std::vector<SetupArena> arenas_;
+    std::vector<SoftwareRasterStats> workerStats_;
+    SoftwareRasterStats stats_;
+};
+
+// Rounds a colour to RGBA8 the way GL converts to a unorm target.
+uint32_t packColor(const glm::vec3& color);
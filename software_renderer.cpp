@@ -0,0 +1,305 @@
+#include "software_renderer.h"
+#include "batch_pipeline.h"
+#include "benchmark.h"
+#include "camera.h"
+#include "image_writer.h"
+#include "mesh_asset.h"
+#include "scene.h"
+#include "scratch_arena.h"
+#include "software_rasterizer.h"
+#include "thread_pool.h"
+#include "vertex_quantization.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+const glm::vec3 clearColor(0.2f, 0.2f, 0.2f);
+const glm::vec3 outlineColor(0.0f, 0.0f, 0.0f);
+// Matches the GL benchmark, so both time the same frames of the path.
+const size_t warmupFrames = 10;
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// What the culling and LOD code needs of a mesh, without a pool behind it.
+GpuMesh describeMesh(const MeshView& view) {
+    GpuMesh mesh;
+    mesh.vertexCount = view.vertexCount;
+    mesh.indexCount = view.indexCount;
+    mesh.edgeIndexCount = view.edgeIndexCount;
+    mesh.lodCount = std::min(lodCountOf(view), maxLodCount);
+    for (size_t lod = 0; lod < mesh.lodCount; lod++)
+        mesh.lods[lod] = lodOf(view, lod);
+    mesh.color = view.color;
+    mesh.boundsMin = view.boundsMin;
+    mesh.boundsMax = view.boundsMax;
+    return mesh;
+}
+
+// The transform stage reads positions as separate x, y and z streams;
+// quantized ones are expanded here, so it only ever sees floats.
+PositionStreams meshPositions(const MeshView& view) {
+    if (!view.quantizedVertices)
+        return splitPositions(view.vertices, view.vertexCount);
+    PositionStreams streams;
+    streams.x.resize(view.vertexCount);
+    streams.y.resize(view.vertexCount);
+    streams.z.resize(view.vertexCount);
+    for (size_t i = 0; i < view.vertexCount; i++) {
+        glm::vec3 position = dequantizePosition(view.quantizedVertices + i * 3, view.boundsMin, view.boundsMax);
+        streams.x[i] = position.x;
+        streams.y[i] = position.y;
+        streams.z[i] = position.z;
+    }
+    return streams;
+}
+
+// Draws one frame the way the GL path's two-pass mode does: every visible
+// instance filled at its LOD, then every outline over them. Returns the
+// triangles submitted.
+size_t renderFrame(SoftwareRasterizer& raster, const Scene& scene, const std::vector<MeshView>& meshes,
+                   const std::vector<PositionStreams>& positions,
+                   const glm::mat4& viewProjection, const glm::mat4& model, const DrawListView& view,
+                   const AppOptions& options) {
+    Frustum frustum = frustumFromMatrix(view.viewProjection);
+    struct Draw {
+        unsigned int mesh;
+        unsigned int lod;
+        glm::mat4 mvp;
+    };
+    std::vector<Draw> draws;
+    draws.reserve(scene.instances.size());
+    for (const SceneInstance& instance : scene.instances) {
+        const GpuMesh& mesh = scene.meshes[instance.mesh];
+        glm::vec3 boundsMin, boundsMax;
+        transformBounds(mesh, instance.transform, boundsMin, boundsMax);
+        if (view.frustumCull && !boxIntersectsFrustum(frustum, boundsMin, boundsMax))
+            continue;
+        unsigned int lod = selectLod(mesh, view, boundsMin, boundsMax, transformScale(instance.transform));
+        draws.push_back({ instance.mesh, lod, viewProjection * model * instance.transform });
+    }
+
+    raster.clear(clearColor);
+    size_t triangles = 0;
+    for (const Draw& draw : draws) {
+        const MeshView& mesh = meshes[draw.mesh];
+        const MeshLod& lod = scene.meshes[draw.mesh].lods[draw.lod];
+        raster.drawTriangles(positions[draw.mesh].view(), mesh.indices + lod.firstIndex, lod.indexCount, draw.mvp,
+                             mesh.color);
+        triangles += lod.indexCount / 3;
+    }
+    if (options.outlineMode != OutlineMode::Off) {
+        for (const Draw& draw : draws) {
+            const MeshView& mesh = meshes[draw.mesh];
+            const MeshLod& lod = scene.meshes[draw.mesh].lods[draw.lod];
+            raster.drawLines(positions[draw.mesh].view(), mesh.edgeIndices + lod.firstEdgeIndex, lod.edgeIndexCount,
+                             draw.mvp, outlineColor, options.lineWidth);
+        }
+    }
+    raster.finish();
+    return triangles;
+}
+
+// Renders the scene from pose, with the assembly rotated by its angles.
+size_t renderPose(SoftwareRasterizer& raster, Camera& camera, const Scene& scene, const std::vector<MeshView>& meshes,
+                  const std::vector<PositionStreams>& positions, const glm::vec3& target, const CameraPose& pose,
+                  const AppOptions& options) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::rotate(model, pose.angleY, glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::rotate(model, pose.angleZ, glm::vec3(0.0f, 0.0f, 1.0f));
+    camera.lookAt(pose.eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+    camera.update();
+
+    DrawListView view;
+    view.viewProjection = camera.viewProjection() * model;
+    view.frustumCull = options.cullMode != CullMode::Off;
+    view.eye = glm::vec3(glm::inverse(model) * glm::vec4(camera.eye(), 1.0f));
+    view.pixelsPerUnit = camera.projection()[1][1] * camera.viewportHeight() * 0.5f;
+    view.maxPixelError = options.lodError;
+    return renderFrame(raster, scene, meshes, positions, camera.viewProjection(), model, view, options);
+}
+
+// The caller rasterizes too, so a pool of n - 1 workers makes n threads.
+// Returns null to run single-threaded.
+ThreadPool* softwareThreadPool(const AppOptions& options, std::unique_ptr<ThreadPool>& ownPool) {
+    if (options.softwareThreads == 0)
+        return &ThreadPool::shared();
+    if (options.softwareThreads > 1)
+        ownPool.reset(new ThreadPool(static_cast<unsigned int>(options.softwareThreads - 1)));
+    return ownPool.get();
+}
+
+}
+
+int runSoftwareRenderer(const AppOptions& options) {
+    bool needEdges = options.outlineMode != OutlineMode::Off;
+    if (options.outlineMode == OutlineMode::SinglePass)
+        std::cerr << "The software rasterizer draws outlines as lines; single-pass drawn as two-pass" << std::endl;
+    if (options.occlusion || options.residencyBytes > 0)
+        std::cerr << "The software rasterizer keeps meshes in memory and frustum culls only; --occlusion and "
+                     "--residency ignored" << std::endl;
+
+    auto loadStart = Clock::now();
+    std::vector<MeshAsset> assets(options.meshPaths.size());
+    ScratchArena scratch;
+    for (size_t i = 0; i < assets.size(); i++) {
+        if (!loadMeshAsset(options.meshPaths[i], needEdges, options.quantizePositions, assets[i], &scratch)) {
+            std::cerr << "Failed to load mesh: " << options.meshPaths[i] << std::endl;
+            return -1;
+        }
+        scratch.reset();
+    }
+    // The transform stage reads positions as separate x, y and z streams
+    std::vector<MeshView> meshes;
+    std::vector<PositionStreams> positions;
+    for (const MeshAsset& asset : assets) {
+        meshes.push_back(asset.view);
+        positions.push_back(meshPositions(asset.view));
+    }
+    double loadMs = millisecondsSince(loadStart);
+
+    Scene scene;
+    for (const MeshView& mesh : meshes)
+        scene.meshes.push_back(describeMesh(mesh));
+    addInstanceGrid(scene, options.copies);
+
+    int width = options.benchmarkWidth, height = options.benchmarkHeight;
+    SceneFraming framing = frameScene(scene);
+    Camera camera;
+    camera.setViewport(width, height);
+    camera.setPerspective(framing.fovY, framing.nearPlane, framing.farPlane);
+
+    std::unique_ptr<ThreadPool> ownPool;
+    ThreadPool* pool = softwareThreadPool(options, ownPool);
+
+    SoftwareRasterizer raster;
+    raster.setSimd(options.simd);
+    raster.setThreadPool(pool);
+    raster.resize(width, height);
+    std::cout << "Software rasterizer: " << width << "x" << height << ", " << (pool ? pool->participantCount() : 1)
+              << " threads, " << (raster.simd() ? "AVX2" : "scalar") << " tiles, " << scene.instances.size()
+              << " instances" << std::endl;
+
+    size_t triangles = 0;
+    if (options.benchmarkFrames > 0) {
+        BenchmarkResults results;
+        results.width = width;
+        results.height = height;
+        results.path = options.cameraPath;
+        results.loadMs = loadMs;
+        for (size_t frame = 0; frame < warmupFrames + options.benchmarkFrames; frame++) {
+            size_t pathFrame = frame > warmupFrames ? frame - warmupFrames : 0;
+            auto frameStart = Clock::now();
+            CameraPose pose = cameraPathPose(options.cameraPath, pathFrame, options.benchmarkFrames, framing.eye,
+                                             framing.target);
+            triangles = renderPose(raster, camera, scene, meshes, positions, framing.target, pose, options);
+            if (frame >= warmupFrames) {
+                results.frameMs.push_back(millisecondsSince(frameStart));
+                results.triangles += static_cast<double>(triangles);
+            }
+        }
+        printBenchmarkReport(results, std::vector<FrameTimings>(), 0);
+    }
+
+    raster.resetStats();
+    auto frameStart = Clock::now();
+    // Pose 0 is the interactive starting view.
+    CameraPose pose;
+    pose.eye = framing.eye;
+    triangles = renderPose(raster, camera, scene, meshes, positions, framing.target, pose, options);
+    double frameMs = millisecondsSince(frameStart);
+
+    const SoftwareRasterStats& stats = raster.stats();
+    std::cout << "Rendered " << triangles << " triangles and " << stats.lines << " lines in " << frameMs
+              << " ms (" << stats.vertices << " vertices transformed, " << stats.reusedVertices << " reused; "
+              << stats.clippedTriangles << " clipped, " << stats.discardedTriangles << " discarded; "
+              << stats.binnedTriangles << " bin references over " << stats.busyBins << " bins; tiles "
+              << stats.tilesFull << " full, " << stats.tilesPartial << " partial, " << stats.tilesRejected
+              << " rejected)" << std::endl;
+
+    if (!writePng(options.softwareOutput, width, height, raster.pixels(), raster.stride())) {
+        std::cerr << "Failed to write " << options.softwareOutput << std::endl;
+        return -1;
+    }
+    std::cout << "Wrote " << options.softwareOutput << std::endl;
+    return 0;
+}
+
+int runSoftwareBatch(const AppOptions& options) {
+    std::vector<std::string> inputs;
+    if (!readBatchList(options.batchList, inputs))
+        return -1;
+    std::vector<std::string> outputs = batchOutputPaths(inputs, options.batchOutputDir);
+    bool needEdges = options.outlineMode != OutlineMode::Off;
+    int width = options.benchmarkWidth, height = options.benchmarkHeight;
+
+    std::unique_ptr<ThreadPool> ownPool;
+    ThreadPool* pool = softwareThreadPool(options, ownPool);
+    SoftwareRasterizer raster;
+    raster.setSimd(options.simd);
+    raster.setThreadPool(pool);
+    raster.resize(width, height);
+    std::cout << "Software batch: " << inputs.size() << " meshes at " << width << "x" << height << ", "
+              << (pool ? pool->participantCount() : 1) << " threads" << std::endl;
+
+    // Meshes load ahead and images are written behind on their own
+    // threads; this one only rasterizes.
+    auto batchStart = Clock::now();
+    BatchLoader loader;
+    loader.start(inputs, needEdges, options.quantizePositions, batchLoadAhead);
+    BatchWriter writer;
+    writer.start(outputs, width, height, batchImageBuffers);
+    BatchReport report;
+    report.inputs = inputs.size();
+
+    Camera camera;
+    camera.setViewport(width, height);
+    for (;;) {
+        BatchItem item;
+        auto waitStart = Clock::now();
+        bool more = loader.pop(item, true);
+        report.loadWaitMs += millisecondsSince(waitStart);
+        if (!more)
+            break;
+        if (!item.asset) {
+            report.loadFailures++;
+            continue;
+        }
+
+        std::vector<MeshView> meshes(1, item.asset->view);
+        std::vector<PositionStreams> positions(1, meshPositions(meshes[0]));
+        Scene scene;
+        scene.meshes.push_back(describeMesh(meshes[0]));
+        addInstanceGrid(scene, 1);
+        glm::vec3 boundsMin, boundsMax;
+        sceneBounds(scene, boundsMin, boundsMax);
+        SceneFraming framing = frameBounds(boundsMin, boundsMax);
+        camera.setPerspective(framing.fovY, framing.nearPlane, framing.farPlane);
+        CameraPose pose;
+        pose.eye = framing.eye;
+        renderPose(raster, camera, scene, meshes, positions, framing.target, pose, options);
+
+        waitStart = Clock::now();
+        std::vector<uint32_t> pixels = writer.acquire();
+        report.writeWaitMs += millisecondsSince(waitStart);
+        for (int y = 0; y < height; y++) {
+            const uint32_t* row = raster.pixels() + y * raster.stride();
+            std::copy(row, row + width, pixels.begin() + static_cast<size_t>(y) * width);
+        }
+        writer.submit(item.input, std::move(pixels));
+        report.rendered++;
+    }
+    writer.finish();
+    report.writeFailures = writer.failed();
+    report.totalMs = millisecondsSince(batchStart);
+    return printBatchReport(report);
+}
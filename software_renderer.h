@@ -0,0 +1,12 @@
+#pragma once
+#include "options.h"
+
+// Renders the scene on the CPU with SoftwareRasterizer, without creating a
+// window or GL context, and writes options.softwareOutput as a PNG. With
+// --benchmark the camera path is timed first and the frame after it is
+// written. Returns the process exit code.
+int runSoftwareRenderer(const AppOptions& options);
+
+// Renders every mesh of options.batchList on the CPU, framed alone from
+// a fixed direction, to its own PNG. Returns the process exit code.
+int runSoftwareBatch(const AppOptions& options);
@@ -0,0 +1,95 @@
+#include "staging_ring.h"
+#include <glad/glad.h>
+#include <iostream>
+
+// True once the fence has signalled (or there was none); deletes it then.
+static bool fenceSignalled(void*& fence) {
+    if (!fence)
+        return true;
+    GLsync sync = static_cast<GLsync>(fence);
+    GLenum status = glClientWaitSync(sync, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+        return false;
+    glDeleteSync(sync);
+    fence = nullptr;
+    return true;
+}
+
+bool StagingRing::create(size_t segmentSize) {
+    destroy();
+
+    segmentSize_ = segmentSize < 4096 ? 4096 : segmentSize;
+    size_t totalSize = segmentSize_ * segmentCount;
+
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+
+    persistent_ = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+    if (persistent_) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_READ_BUFFER, totalSize, nullptr, flags);
+        persistentData_ = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, totalSize, flags));
+        if (!persistentData_) {
+            std::cerr << "Failed to map staging buffer" << std::endl;
+            destroy();
+            return false;
+        }
+    }
+    else {
+        glBufferData(GL_COPY_READ_BUFFER, totalSize, nullptr, GL_STREAM_COPY);
+    }
+    return true;
+}
+
+void StagingRing::destroy() {
+    for (void*& fence : fences_) {
+        if (fence)
+            glDeleteSync(static_cast<GLsync>(fence));
+        fence = nullptr;
+    }
+    if (buffer_) {
+        if (persistentData_) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+        }
+        glDeleteBuffers(1, &buffer_);
+    }
+    buffer_ = 0;
+    persistentData_ = nullptr;
+    segment_ = 0;
+    copies_.clear();
+}
+
+unsigned char* StagingRing::beginSegment() {
+    int next = (segment_ + 1) % segmentCount;
+    if (!buffer_ || !fenceSignalled(fences_[next]))
+        return nullptr;
+    segment_ = next;
+    copies_.clear();
+
+    if (persistent_)
+        return persistentData_ + segment_ * segmentSize_;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    return static_cast<unsigned char*>(
+        glMapBufferRange(GL_COPY_READ_BUFFER, segment_ * segmentSize_, segmentSize_, access));
+}
+
+void StagingRing::copy(size_t offset, unsigned int buffer, size_t bufferOffset, size_t bytes) {
+    copies_.push_back({ offset, buffer, bufferOffset, bytes });
+}
+
+void StagingRing::endSegment() {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    if (!persistent_)
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    for (const Copy& copy : copies_) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, copy.buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, segment_ * segmentSize_ + copy.offset,
+                            copy.bufferOffset, copy.bytes);
+    }
+    copies_.clear();
+    fences_[segment_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
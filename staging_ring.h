@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Staging buffer for uploads that must not stall a frame, split into one
+// segment per frame in flight. Data is written into a segment and copied
+// into its destination buffers on the GPU with glCopyBufferSubData. As in
+// UniformRing, the buffer is mapped persistently on GL 4.4 (or
+// ARB_buffer_storage) and per segment otherwise, and each segment is
+// fenced; unlike UniformRing, a segment the GPU is still copying from is
+// skipped instead of waited for.
+class StagingRing {
+public:
+    static const int segmentCount = 3;
+
+    bool create(size_t segmentSize);
+    void destroy();
+
+    size_t segmentSize() const { return segmentSize_; }
+    bool persistent() const { return persistent_; }
+
+    // Returns the next segment for writing, or nullptr if the GPU has not
+    // finished the copies from it yet. Never blocks.
+    unsigned char* beginSegment();
+    // Queues a copy of bytes at offset in the current segment into buffer.
+    void copy(size_t offset, unsigned int buffer, size_t bufferOffset, size_t bytes);
+    // Issues the queued copies and fences the segment.
+    void endSegment();
+
+private:
+    struct Copy {
+        size_t offset;
+        unsigned int buffer;
+        size_t bufferOffset;
+        size_t bytes;
+    };
+
+    unsigned int buffer_ = 0;
+    size_t segmentSize_ = 0;
+    bool persistent_ = false;
+
+    unsigned char* persistentData_ = nullptr;
+    int segment_ = 0;
+    void* fences_[segmentCount] = {};
+    std::vector<Copy> copies_;
+};
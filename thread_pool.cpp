@@ -0,0 +1,172 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    workers_.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers_.emplace_back([this] { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    taskAvailable_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    taskAvailable_.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            taskAvailable_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (stopping_ && tasks_.empty())
+                return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0)
+        return;
+    if (count == 1) {
+        body(0);
+        return;
+    }
+
+    struct Batch {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> finished{ 0 };
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto batch = std::make_shared<Batch>();
+    const std::function<void(size_t)>* work = &body;
+
+    // Helpers and the caller pull indices until the range is exhausted;
+    // a helper that starts late simply finds nothing left to do.
+    auto drain = [batch, work, count] {
+        size_t ran = 0;
+        for (size_t i = batch->next++; i < count; i = batch->next++) {
+            (*work)(i);
+            ran++;
+        }
+        if (ran > 0 && batch->finished.fetch_add(ran) + ran == count) {
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            batch->done.notify_all();
+        }
+    };
+
+    size_t helpers = std::min(count - 1, workers_.size());
+    for (size_t i = 0; i < helpers; i++)
+        submit(drain);
+    drain();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->done.wait(lock, [&] { return batch->finished.load() == count; });
+}
+
+void ThreadPool::parallelForStealing(size_t count, const std::function<void(size_t, unsigned int)>& body) {
+    if (count == 0)
+        return;
+    size_t participants = std::min(count, workers_.size() + 1);
+    if (participants == 1) {
+        for (size_t i = 0; i < count; i++)
+            body(i, 0);
+        return;
+    }
+
+    // A share is [begin, end) packed into one word, begin in the low half:
+    // its owner takes from the front, thieves split off the back half.
+    struct alignas(64) Share {
+        std::atomic<uint64_t> range{ 0 };
+    };
+    struct Batch {
+        std::unique_ptr<Share[]> shares;
+        size_t participants = 0;
+        std::atomic<size_t> finished{ 0 };
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto pack = [](uint64_t begin, uint64_t end) { return begin | (end << 32); };
+    auto batch = std::make_shared<Batch>();
+    batch->shares.reset(new Share[participants]);
+    batch->participants = participants;
+    for (size_t i = 0; i < participants; i++)
+        batch->shares[i].range = pack(count * i / participants, count * (i + 1) / participants);
+    const std::function<void(size_t, unsigned int)>* work = &body;
+
+    auto drain = [batch, work, count, pack](unsigned int self) {
+        Share& own = batch->shares[self];
+        size_t ran = 0;
+        for (;;) {
+            uint64_t range = own.range.load();
+            uint64_t begin = range & 0xffffffffu, end = range >> 32;
+            if (begin < end) {
+                if (own.range.compare_exchange_weak(range, pack(begin + 1, end))) {
+                    (*work)(static_cast<size_t>(begin), self);
+                    ran++;
+                }
+                continue;
+            }
+
+            // Own share is empty, and only this participant refills it
+            bool stole = false;
+            for (size_t k = 1; k < batch->participants && !stole; k++) {
+                Share& victim = batch->shares[(self + k) % batch->participants];
+                uint64_t victimRange = victim.range.load();
+                for (;;) {
+                    uint64_t victimBegin = victimRange & 0xffffffffu, victimEnd = victimRange >> 32;
+                    if (victimBegin >= victimEnd)
+                        break;
+                    uint64_t middle = victimBegin + (victimEnd - victimBegin) / 2;
+                    if (victim.range.compare_exchange_weak(victimRange, pack(victimBegin, middle))) {
+                        own.range.store(pack(middle, victimEnd));
+                        stole = true;
+                        break;
+                    }
+                }
+            }
+            if (!stole)
+                break;
+        }
+        if (ran > 0 && batch->finished.fetch_add(ran) + ran == count) {
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            batch->done.notify_all();
+        }
+    };
+
+    for (size_t i = 1; i < participants; i++) {
+        unsigned int self = static_cast<unsigned int>(i);
+        submit([drain, self] { drain(self); });
+    }
+    drain(0);
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->done.wait(lock, [&] { return batch->finished.load() == count; });
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads fed from a shared task queue.
+class ThreadPool {
+public:
+    // A thread count of 0 uses one worker per hardware thread.
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int threadCount() const { return static_cast<unsigned int>(workers_.size()); }
+
+    void submit(std::function<void()> task);
+
+    // Runs body(i) for every i in [0, count) and returns once all calls have
+    // finished. The calling thread takes part in the work.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    // Worker indices parallelForStealing passes: every pool thread plus
+    // the caller.
+    unsigned int participantCount() const { return threadCount() + 1; }
+
+    // Like parallelFor, but each participant starts on its own contiguous
+    // share of the range and, once that runs out, steals half of what is
+    // left of another's, so neighbouring indices mostly run on the same
+    // thread. body also gets the index of the participant running it,
+    // below participantCount(), to pick per-thread scratch by. count must
+    // fit 32 bits.
+    void parallelForStealing(size_t count, const std::function<void(size_t, unsigned int)>& body);
+
+    // Process-wide pool sized to the machine.
+    static ThreadPool& shared();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable taskAvailable_;
+    bool stopping_ = false;
+};
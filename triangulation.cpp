@@ -0,0 +1,142 @@
+#include "triangulation.h"
+#include <cmath>
+
+namespace {
+
+void emitFan(const unsigned int* face, unsigned int size, unsigned int* out) {
+    for (unsigned int i = 1; i + 1 < size; i++) {
+        *out++ = face[0];
+        *out++ = face[i];
+        *out++ = face[i + 1];
+    }
+}
+
+inline float cross2(const float* a, const float* b, const float* c) {
+    return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+// Projects the polygon onto the coordinate plane that best preserves its
+// area, found from the Newell normal.
+void projectPolygon(const float* positions, const unsigned int* face, unsigned int size,
+                    ScratchVector<float>& projected) {
+    float nx = 0.0f, ny = 0.0f, nz = 0.0f;
+    for (unsigned int i = 0; i < size; i++) {
+        const float* a = positions + face[i] * 3;
+        const float* b = positions + face[(i + 1) % size] * 3;
+        nx += (a[1] - b[1]) * (a[2] + b[2]);
+        ny += (a[2] - b[2]) * (a[0] + b[0]);
+        nz += (a[0] - b[0]) * (a[1] + b[1]);
+    }
+
+    // Drop the dominant axis; pick the remaining pair so the projection
+    // keeps a counter-clockwise winding for front-facing polygons.
+    int u, v;
+    float ax = std::fabs(nx), ay = std::fabs(ny), az = std::fabs(nz);
+    if (az >= ax && az >= ay) {
+        u = nz >= 0.0f ? 0 : 1;
+        v = nz >= 0.0f ? 1 : 0;
+    }
+    else if (ax >= ay) {
+        u = nx >= 0.0f ? 1 : 2;
+        v = nx >= 0.0f ? 2 : 1;
+    }
+    else {
+        u = ny >= 0.0f ? 2 : 0;
+        v = ny >= 0.0f ? 0 : 2;
+    }
+
+    projected.resize(size * 2);
+    for (unsigned int i = 0; i < size; i++) {
+        const float* p = positions + face[i] * 3;
+        projected[2 * i] = p[u];
+        projected[2 * i + 1] = p[v];
+    }
+}
+
+bool isConvex(const ScratchVector<float>& projected, unsigned int size) {
+    for (unsigned int i = 0; i < size; i++) {
+        const float* a = &projected[2 * i];
+        const float* b = &projected[2 * ((i + 1) % size)];
+        const float* c = &projected[2 * ((i + 2) % size)];
+        if (cross2(a, b, c) < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+bool insideTriangle(const float* a, const float* b, const float* c, const float* p) {
+    return cross2(a, b, p) >= 0.0f && cross2(b, c, p) >= 0.0f && cross2(c, a, p) >= 0.0f;
+}
+
+}
+
+void triangulatePolygon(const float* positions, const unsigned int* face, unsigned int size,
+                        unsigned int* out, TriangulationScratch& scratch) {
+    if (size == 3) {
+        emitFan(face, size, out);
+        return;
+    }
+
+    projectPolygon(positions, face, size, scratch.projected);
+    if (isConvex(scratch.projected, size)) {
+        emitFan(face, size, out);
+        return;
+    }
+
+    // Ear clipping over the polygon's corner list. Positions are looked up
+    // through the corner number so duplicated indices are handled.
+    ScratchVector<unsigned int>& remaining = scratch.remaining;
+    remaining.resize(size);
+    for (unsigned int i = 0; i < size; i++)
+        remaining[i] = i;
+
+    const float* projected = scratch.projected.data();
+    unsigned int count = size;
+    unsigned int i = 0;
+    unsigned int attempts = 0;
+
+    while (count > 3) {
+        unsigned int prev = remaining[(i + count - 1) % count];
+        unsigned int cur = remaining[i];
+        unsigned int next = remaining[(i + 1) % count];
+        const float* a = projected + 2 * prev;
+        const float* b = projected + 2 * cur;
+        const float* c = projected + 2 * next;
+
+        bool ear = cross2(a, b, c) > 0.0f;
+        for (unsigned int k = 0; ear && k < count; k++) {
+            unsigned int other = remaining[k];
+            if (other == prev || other == cur || other == next)
+                continue;
+            ear = !insideTriangle(a, b, c, projected + 2 * other);
+        }
+
+        if (ear) {
+            *out++ = face[prev];
+            *out++ = face[cur];
+            *out++ = face[next];
+            remaining.erase(remaining.begin() + i);
+            count--;
+            if (i >= count)
+                i = 0;
+            attempts = 0;
+        }
+        else if (++attempts > count) {
+            // Self-intersecting or degenerate outline: no ear exists, so
+            // finish with a fan over what is left rather than drop faces.
+            for (unsigned int k = 1; k + 1 < count; k++) {
+                *out++ = face[remaining[0]];
+                *out++ = face[remaining[k]];
+                *out++ = face[remaining[k + 1]];
+            }
+            return;
+        }
+        else {
+            i = (i + 1) % count;
+        }
+    }
+
+    *out++ = face[remaining[0]];
+    *out++ = face[remaining[1]];
+    *out++ = face[remaining[2]];
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "scratch_arena.h"
+
+// Reusable buffers for triangulatePolygon, one per thread.
+struct TriangulationScratch {
+    explicit TriangulationScratch(ScratchArena* arena = nullptr) : projected(arena), remaining(arena) {}
+
+    ScratchVector<float> projected;
+    ScratchVector<unsigned int> remaining;
+};
+
+// Splits a polygon of `size` >= 3 position indices into size - 2 triangles
+// written to `out`, keeping the polygon's winding. Convex polygons use a
+// fan; concave ones are ear-clipped in the polygon's best-fit plane.
+void triangulatePolygon(const float* positions, const unsigned int* face, unsigned int size,
+                        unsigned int* out, TriangulationScratch& scratch);
@@ -0,0 +1,133 @@
+#include "uniform_ring.h"
+#include <glad/glad.h>
+#include <iostream>
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void waitForFence(void*& fence) {
+    if (!fence)
+        return;
+    GLsync sync = static_cast<GLsync>(fence);
+    GLenum status = glClientWaitSync(sync, 0, 0);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    glDeleteSync(sync);
+    fence = nullptr;
+}
+
+bool UniformRing::create(size_t objectCapacity) {
+    destroy();
+
+    int alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    objectCapacity_ = objectCapacity < 1 ? 1 : objectCapacity;
+    objectStride_ = alignUp(sizeof(ObjectUniforms), alignment);
+    objectsOffset_ = alignUp(sizeof(FrameUniforms), alignment);
+    segmentSize_ = alignUp(objectsOffset_ + objectStride_ * objectCapacity_, alignment);
+    size_t totalSize = segmentSize_ * segmentCount;
+
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+
+    persistent_ = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+    if (persistent_) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, totalSize, nullptr, flags);
+        persistentData_ = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, totalSize, flags));
+        if (!persistentData_) {
+            std::cerr << "Failed to map uniform ring buffer" << std::endl;
+            destroy();
+            return false;
+        }
+    }
+    else {
+        glBufferData(GL_UNIFORM_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+    }
+    return true;
+}
+
+void UniformRing::destroy() {
+    for (void*& fence : fences_) {
+        if (fence)
+            glDeleteSync(static_cast<GLsync>(fence));
+        fence = nullptr;
+    }
+    if (buffer_) {
+        if (persistentData_) {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glDeleteBuffers(1, &buffer_);
+    }
+    buffer_ = 0;
+    persistentData_ = nullptr;
+    writeData_ = nullptr;
+    segment_ = 0;
+}
+
+void UniformRing::reserve(size_t objectCount) {
+    if (objectCount <= objectCapacity_)
+        return;
+    // Deleting the buffer is safe while draws still read it; GL keeps the
+    // storage alive until they finish.
+    size_t capacity = objectCapacity_;
+    while (capacity < objectCount)
+        capacity *= 2;
+    create(capacity);
+}
+
+unsigned char* UniformRing::segmentData(int segment) const {
+    return persistentData_ + segment * segmentSize_;
+}
+
+bool UniformRing::beginFrame() {
+    segment_ = (segment_ + 1) % segmentCount;
+    waitForFence(fences_[segment_]);
+
+    if (persistent_) {
+        writeData_ = segmentData(segment_);
+    }
+    else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+        writeData_ = static_cast<unsigned char*>(
+            glMapBufferRange(GL_UNIFORM_BUFFER, segment_ * segmentSize_, segmentSize_, access));
+        if (!writeData_) {
+            if (!mapFailed_)
+                std::cerr << "Failed to map uniform ring segment; skipping uniform writes" << std::endl;
+            mapFailed_ = true;
+            return false;
+        }
+        mapFailed_ = false;
+    }
+    return true;
+}
+
+FrameUniforms& UniformRing::frame() {
+    return *reinterpret_cast<FrameUniforms*>(writeData_);
+}
+
+ObjectUniforms& UniformRing::object(size_t index) {
+    return *reinterpret_cast<ObjectUniforms*>(writeData_ + objectsOffset_ + index * objectStride_);
+}
+
+void UniformRing::finishWrites() {
+    if (!persistent_ && writeData_) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+    writeData_ = nullptr;
+    glBindBufferRange(GL_UNIFORM_BUFFER, frameBlockBinding, buffer_, segment_ * segmentSize_, sizeof(FrameUniforms));
+}
+
+void UniformRing::bindObject(size_t index) const {
+    size_t offset = segment_ * segmentSize_ + objectsOffset_ + index * objectStride_;
+    glBindBufferRange(GL_UNIFORM_BUFFER, objectBlockBinding, buffer_, offset, sizeof(ObjectUniforms));
+}
+
+void UniformRing::endFrame() {
+    fences_[segment_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
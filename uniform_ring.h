@@ -0,0 +1,71 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// std140 mirror of the shaders' Frame block (binding point 0).
+struct FrameUniforms {
+    glm::mat4 viewProjection;
+    // xy = framebuffer size in pixels, zw = half of it.
+    glm::vec4 viewport;
+};
+
+// std140 mirror of the shaders' Object block (binding point 1).
+struct ObjectUniforms {
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+const unsigned int frameBlockBinding = 0;
+const unsigned int objectBlockBinding = 1;
+
+// Uniform buffer split into one segment per frame in flight. Each segment
+// holds the frame block followed by an array of object blocks, so a frame
+// costs one buffer write no matter how many objects it draws. On GL 4.4
+// (or ARB_buffer_storage) the buffer is mapped once, persistently;
+// otherwise each segment is mapped unsynchronized for the frame. Fences
+// keep the CPU from overwriting a segment the GPU is still reading.
+class UniformRing {
+public:
+    static const int segmentCount = 3;
+
+    bool create(size_t objectCapacity);
+    void destroy();
+
+    size_t objectCapacity() const { return objectCapacity_; }
+    bool persistent() const { return persistent_; }
+
+    // Grows the per-frame object array. Only call between frames.
+    void reserve(size_t objectCount);
+
+    // Waits until the next segment is free and opens it for writing.
+    // Returns false if the segment could not be mapped; frame() and
+    // object() must then not be called, and the frame draws with the
+    // segment's previous contents.
+    bool beginFrame();
+    FrameUniforms& frame();
+    ObjectUniforms& object(size_t index);
+    // Makes the writes visible to GL and binds the frame block.
+    void finishWrites();
+
+    void bindObject(size_t index) const;
+
+    // Fences the segment used by this frame's draws.
+    void endFrame();
+
+private:
+    unsigned char* segmentData(int segment) const;
+
+    unsigned int buffer_ = 0;
+    size_t objectCapacity_ = 0;
+    size_t objectStride_ = 0;
+    size_t objectsOffset_ = 0;
+    size_t segmentSize_ = 0;
+    bool persistent_ = false;
+
+    unsigned char* persistentData_ = nullptr;
+    unsigned char* writeData_ = nullptr;
+    int segment_ = 0;
+    // Set while mapping fails, so the failure is logged once.
+    bool mapFailed_ = false;
+    void* fences_[segmentCount] = {};
+};
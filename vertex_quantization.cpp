@@ -0,0 +1,38 @@
+#include "vertex_quantization.h"
+#include <algorithm>
+#include <cmath>
+
+float quantizeMeshPositions(Mesh& mesh) {
+    size_t vertexCount = mesh.vertices.size() / 3;
+    glm::vec3 extent = mesh.boundsMax - mesh.boundsMin;
+    // A flat axis quantizes to 0 and dequantizes to its one value.
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++)
+        scale[axis] = extent[axis] > 0.0f ? quantizedPositionScale / extent[axis] : 0.0f;
+
+    mesh.quantizedVertices.resize(vertexCount * 3);
+    float maxError = 0.0f;
+    for (size_t v = 0; v < vertexCount; v++) {
+        const float* position = &mesh.vertices[v * 3];
+        uint16_t* quantized = &mesh.quantizedVertices[v * 3];
+        for (int axis = 0; axis < 3; axis++) {
+            float unit = (position[axis] - mesh.boundsMin[axis]) * scale[axis];
+            quantized[axis] = static_cast<uint16_t>(std::lround(std::min(std::max(unit, 0.0f), quantizedPositionScale)));
+        }
+        glm::vec3 original(position[0], position[1], position[2]);
+        maxError = std::max(maxError, glm::length(dequantizePosition(quantized, mesh.boundsMin, mesh.boundsMax)
+                                                  - original));
+    }
+    std::vector<float>().swap(mesh.vertices);
+    return maxError;
+}
+
+glm::mat4 dequantizeTransform(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 extent = boundsMax - boundsMin;
+    glm::mat4 transform(1.0f);
+    transform[0][0] = extent.x;
+    transform[1][1] = extent.y;
+    transform[2][2] = extent.z;
+    transform[3] = glm::vec4(boundsMin, 1.0f);
+    return transform;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "mesh.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// Largest value of a quantized position component.
+const float quantizedPositionScale = 65535.0f;
+
+// Stores mesh.vertices as 16-bit unsigned normalized components relative
+// to the mesh bounds, in mesh.quantizedVertices, and releases the floats.
+// Returns the largest distance any vertex moved. Run last, after
+// optimizeMesh and buildMeshLods, which work on the floats.
+float quantizeMeshPositions(Mesh& mesh);
+
+// Maps quantized positions, read by GL as normalized [0, 1] values, back
+// into the bounds: the box scale and offset as a matrix, applied before
+// the model transform.
+glm::mat4 dequantizeTransform(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+inline glm::vec3 dequantizePosition(const uint16_t* position, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 unit(position[0], position[1], position[2]);
+    return boundsMin + unit / quantizedPositionScale * (boundsMax - boundsMin);
+}